@@ -0,0 +1,930 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	vcdq.cpp
+// {{{
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	A VCD trace query tool.  Given a (potentially very large) VCD
+//		file, such as the trace.vcd written by main_tb, this tool
+//	streams through it once and builds an index, <trace>.idx, holding the
+//	value changes of every signal in per-signal chunks.  Queries then read
+//	only the chunks they need, rather than rescanning the trace.
+//
+//	Usage: vcdq [-m <MB>] [-f] <trace.vcd> <command> [args]
+//
+//	index			Build (or rebuild, with -f) the index
+//	list [pattern]		List signals, widths and number of changes
+//	value SIG T		The value of SIG at time T
+//	changes SIG [T0 [T1]]	All changes to SIG, optionally between T0
+//				and T1
+//	writes ADDR		All bus writes to ADDR.  By default this looks
+//				for the ZipCPU's zip_stb, zip_we, zip_addr and
+//				zip_data, with zip_addr being a word address.
+//				Use -stb, -we, -addr, -data to name other
+//				signals, -shift N to set the address shift, and
+//				-clk CLK to sample on every rising clock edge
+//				rather than on every change.
+//	dump SIG [SIG ...]	A merged table of the given signals, printed
+//				whenever any of them changes
+//
+//	Signals may be given by their full name (scope.scope.name), or by any
+//	unambiguous trailing part of it.  Times are in the units of the trace.
+//
+//	Only the first 64 bits of wider signals are kept, and X/Z bits read
+//	as zero.  FST traces are not supported; convert them first with
+//	fst2vcd.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2015-2022, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+
+static	const	char	IDX_MAGIC[8] = { 'V','C','D','Q','I','D','X','1' };
+
+// One value change
+typedef	struct	VCHANGE_S {
+	uint64_t	m_time, m_value;
+} VCHANGE;
+
+// A run of value changes for one signal, stored contiguously in the index
+typedef	struct	VCHUNK_S {
+	uint32_t	m_sig, m_count;
+	uint64_t	m_t0, m_t1, m_offset;
+} VCHUNK;
+
+// The index file header
+typedef	struct	IDXHDR_S {
+	char		m_magic[8];
+	uint64_t	m_vcd_size, m_vcd_mtime;
+	uint64_t	m_names_offset, m_dir_offset;
+	uint32_t	m_nsigs, m_nnames;
+	uint64_t	m_nchunks, m_tmax;
+} IDXHDR;
+
+typedef	struct	VSIGNAL_S {
+	uint32_t	m_width;
+	uint64_t	m_nchanges;
+} VSIGNAL;
+
+typedef	struct	VNAME_S {
+	std::string	m_name;
+	uint32_t	m_sig;
+} VNAME;
+
+//
+// VCDLEX
+// {{{
+// Splits a VCD file into white-space separated tokens, reading it in large
+// blocks.  VCD is token, not line, oriented--and lines may be long.
+//
+class	VCDLEX {
+	FILE		*m_fp;
+	char		*m_buf;
+	size_t		m_pos, m_len;
+	static	const	size_t	BUFLEN = (1<<20);
+
+	int	getch(void) {
+		if (m_pos >= m_len) {
+			m_len = fread(m_buf, 1, BUFLEN, m_fp);
+			m_pos = 0;
+			if (m_len == 0)
+				return EOF;
+		} return m_buf[m_pos++];
+	}
+public:
+	VCDLEX(FILE *fp) : m_fp(fp), m_pos(0), m_len(0) {
+		m_buf = new char[BUFLEN];
+	}
+	~VCDLEX(void) { delete[] m_buf; }
+
+	bool	token(std::string &tok) {
+		int	ch;
+
+		tok.clear();
+		while((EOF != (ch = getch()))&&(isspace(ch)))
+			;
+		if (EOF == ch)
+			return false;
+		do {
+			tok.push_back((char)ch);
+		} while((EOF != (ch = getch()))&&(!isspace(ch)));
+		return true;
+	}
+
+	// Skip tokens through the next $end
+	void	skip(void) {
+		std::string	tok;
+		while((token(tok))&&(tok != "$end"))
+			;
+	}
+};
+// }}}
+
+//
+// VCD identifier codes are strings of printable characters, '!' to '~'.
+// Treat them as base-94 numbers, so they can be looked up without building
+// a string for every value change.
+//
+static	bool	idcode(const char *str, size_t len, uint64_t &code) {
+	code = 0;
+	if ((len == 0)||(len > 9))
+		return false;
+	for(size_t k=0; k<len; k++) {
+		if ((str[k] < '!')||(str[k] > '~'))
+			return false;
+		code = code * 94 + (str[k] - '!' + 1);
+	} return true;
+}
+
+static	bool	parse_time(const char *str, uint64_t &t) {
+	char	*end;
+	t = strtoull(str, &end, 0);
+	return (end != str)&&(*end == '\0');
+}
+
+//
+// VCDINDEX
+// {{{
+// Building and reading the index
+//
+class	VCDINDEX {
+	std::vector<VSIGNAL>	m_sigs;
+	std::vector<VNAME>	m_names;
+	std::vector<VCHUNK>	m_dir;
+	// The first chunk of each signal within m_dir
+	std::vector<uint64_t>	m_first;
+	FILE			*m_fp;
+	uint64_t		m_tmax;
+
+	// Indexing state
+	std::vector<std::vector<VCHANGE> >	m_pending;
+	uint64_t		m_npending, m_budget, m_wrpos;
+
+	void	flush_chunk(uint32_t sig);
+	void	flush(bool all);
+	void	parse_header(VCDLEX &lex,
+			std::unordered_map<uint64_t, uint32_t> &ids);
+public:
+	// Number of changes per chunk, once a chunk is this long it gets
+	// written regardless of how much memory is in use
+	static	const	unsigned	MAXCHUNK = 65536;
+
+	VCDINDEX(void) : m_fp(NULL), m_tmax(0) {}
+	~VCDINDEX(void) { if (m_fp) fclose(m_fp); }
+
+	void	build(const char *vcdname, const char *idxname,
+			const uint64_t budget);
+	bool	open(const char *vcdname, const char *idxname);
+
+	int	lookup(const char *name) const;
+	unsigned	nsigs(void) const { return m_sigs.size(); }
+	const	VSIGNAL	&sig(unsigned k) const { return m_sigs[k]; }
+	unsigned	nnames(void) const { return m_names.size(); }
+	const	VNAME	&name(unsigned k) const { return m_names[k]; }
+	const	char	*signame(unsigned sig) const;
+	uint64_t	tmax(void) const { return m_tmax; }
+
+	// The chunks belonging to a signal are m_dir[first..last)
+	uint64_t	first_chunk(unsigned sig) const { return m_first[sig]; }
+	uint64_t	last_chunk(unsigned sig) const { return m_first[sig+1]; }
+	const	VCHUNK	&chunk(uint64_t k) const { return m_dir[k]; }
+	void	read_chunk(uint64_t k, std::vector<VCHANGE> &data);
+};
+
+void	VCDINDEX::flush_chunk(uint32_t sig) {
+	std::vector<VCHANGE>	&p = m_pending[sig];
+	VCHUNK	ck;
+
+	if (p.size() == 0)
+		return;
+
+	ck.m_sig    = sig;
+	ck.m_count  = p.size();
+	ck.m_t0     = p[0].m_time;
+	ck.m_t1     = p[p.size()-1].m_time;
+	ck.m_offset = m_wrpos;
+	if (fwrite(&p[0], sizeof(VCHANGE), p.size(), m_fp) != p.size()) {
+		fprintf(stderr, "ERR: Could not write index\n");
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	}
+	m_wrpos += p.size() * sizeof(VCHANGE);
+	m_dir.push_back(ck);
+	m_npending -= p.size();
+
+	// Release the memory, not just the contents
+	std::vector<VCHANGE>().swap(p);
+}
+
+//
+// flush()
+//
+// Called when the pending changes exceed the memory budget.  Write out the
+// larger buffers first, so that rarely changing signals don't end up split
+// into lots of tiny chunks.  Only if that's not enough, write everything.
+//
+void	VCDINDEX::flush(bool all) {
+	if (!all) {
+		uint64_t	avg = m_npending / m_pending.size() + 1;
+
+		for(uint32_t k=0; k<m_pending.size(); k++)
+			if (m_pending[k].size() >= avg)
+				flush_chunk(k);
+		if (m_npending * sizeof(VCHANGE) < m_budget / 2)
+			return;
+	}
+
+	for(uint32_t k=0; k<m_pending.size(); k++)
+		flush_chunk(k);
+}
+
+void	VCDINDEX::parse_header(VCDLEX &lex,
+		std::unordered_map<uint64_t, uint32_t> &ids) {
+	std::vector<std::string>	scope;
+	std::string	tok;
+
+	while(lex.token(tok)) {
+		if (tok == "$scope") {
+			std::string	kind, nm;
+			lex.token(kind);
+			lex.token(nm);
+			scope.push_back(nm);
+			lex.skip();
+		} else if (tok == "$upscope") {
+			if (scope.size() > 0)
+				scope.pop_back();
+			lex.skip();
+		} else if (tok == "$var") {
+			std::string	kind, width, id, ref, full;
+			uint64_t	code;
+			uint32_t	sig;
+			VNAME		vn;
+
+			lex.token(kind);
+			lex.token(width);
+			lex.token(id);
+			lex.token(ref);
+			lex.skip();	// Skip any bit range, through $end
+
+			if (!idcode(id.c_str(), id.size(), code)) {
+				fprintf(stderr, "WARNING: Unusable identifier, %s, for %s\n",
+					id.c_str(), ref.c_str());
+				continue;
+			}
+
+			// Several variables may share the one identifier
+			auto	kv = ids.find(code);
+			if (kv == ids.end()) {
+				VSIGNAL	vs;
+				vs.m_width = atoi(width.c_str());
+				vs.m_nchanges = 0;
+				sig = m_sigs.size();
+				m_sigs.push_back(vs);
+				ids[code] = sig;
+			} else
+				sig = kv->second;
+
+			for(unsigned k=0; k<scope.size(); k++)
+				full += scope[k] + ".";
+			full += ref;
+			vn.m_name = full;
+			vn.m_sig  = sig;
+			m_names.push_back(vn);
+		} else if (tok == "$enddefinitions") {
+			lex.skip();
+			return;
+		} else if (tok[0] == '$')
+			lex.skip();
+	}
+
+	fprintf(stderr, "ERR: Could not find the end of the definition section\n");
+	exit(EXIT_FAILURE);
+}
+
+void	VCDINDEX::build(const char *vcdname, const char *idxname,
+		const uint64_t budget) {
+	std::unordered_map<uint64_t, uint32_t>	ids;
+	std::string	tok;
+	struct	stat	sb;
+	uint64_t	now = 0, code, value;
+	IDXHDR		hdr;
+	FILE		*vcd;
+
+	if (NULL == (vcd = fopen(vcdname, "r"))) {
+		fprintf(stderr, "ERR: Cannot open %s\n", vcdname);
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	} fstat(fileno(vcd), &sb);
+
+	if (NULL == (m_fp = fopen(idxname, "w+"))) {
+		fprintf(stderr, "ERR: Cannot create %s\n", idxname);
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	}
+
+	m_sigs.clear(); m_names.clear(); m_dir.clear();
+	m_budget = budget;
+	m_npending = 0;
+
+	// The header gets rewritten once we know what goes into it
+	memset(&hdr, 0, sizeof(hdr));
+	fwrite(&hdr, sizeof(hdr), 1, m_fp);
+	m_wrpos = sizeof(hdr);
+
+	VCDLEX	lex(vcd);
+	parse_header(lex, ids);
+	m_pending.resize(m_sigs.size());
+
+	while(lex.token(tok)) {
+		const char	*str = tok.c_str();
+		size_t		len = tok.size(), idlen;
+		const char	*id;
+
+		switch(str[0]) {
+		case '#':
+			now = strtoull(&str[1], NULL, 10);
+			continue;
+		case '0': case '1':
+		case 'x': case 'X': case 'z': case 'Z':
+			value = (str[0] == '1') ? 1 : 0;
+			id = &str[1]; idlen = len-1;
+			break;
+		case 'b': case 'B': {
+			std::string	idtok;
+			value = 0;
+			for(size_t k=1; k<len; k++)
+				value = (value << 1) | ((str[k]=='1') ? 1:0);
+			lex.token(idtok);
+			if (!idcode(idtok.c_str(), idtok.size(), code))
+				continue;
+			goto have_code;
+			}
+		case 'r': case 'R': {
+			std::string	idtok;
+			double	dv = strtod(&str[1], NULL);
+			memcpy(&value, &dv, sizeof(value));
+			lex.token(idtok);
+			if (!idcode(idtok.c_str(), idtok.size(), code))
+				continue;
+			goto have_code;
+			}
+		case '$':
+			// $dumpvars, $dumpon, etc. just bracket value changes,
+			// but $comment needs to be skipped entirely
+			if (tok == "$comment")
+				lex.skip();
+			continue;
+		default:
+			continue;
+		}
+
+		if (!idcode(id, idlen, code))
+			continue;
+have_code:
+		{
+			auto	kv = ids.find(code);
+			if (kv == ids.end())
+				continue;
+
+			std::vector<VCHANGE>	&p = m_pending[kv->second];
+			VCHANGE	vc;
+			vc.m_time  = now;
+			vc.m_value = value;
+			// A later change at the same time replaces the earlier
+			if ((p.size() > 0)&&(p.back().m_time == now))
+				p.back().m_value = value;
+			else {
+				p.push_back(vc);
+				m_npending++;
+				m_sigs[kv->second].m_nchanges++;
+			}
+
+			if (p.size() >= MAXCHUNK)
+				flush_chunk(kv->second);
+			else if (m_npending * sizeof(VCHANGE) >= m_budget)
+				flush(false);
+		}
+	}
+
+	flush(true);
+	fclose(vcd);
+	m_tmax = now;
+
+	// Write the signal and name tables, then the chunk directory
+	hdr.m_names_offset = m_wrpos;
+	fwrite(&m_sigs[0], sizeof(VSIGNAL), m_sigs.size(), m_fp);
+	for(unsigned k=0; k<m_names.size(); k++) {
+		uint32_t	ln = m_names[k].m_name.size();
+		fwrite(&m_names[k].m_sig, sizeof(uint32_t), 1, m_fp);
+		fwrite(&ln, sizeof(uint32_t), 1, m_fp);
+		fwrite(m_names[k].m_name.c_str(), 1, ln, m_fp);
+	}
+	hdr.m_dir_offset = ftell(m_fp);
+
+	// Sort by signal, then by time.  Chunks of any one signal were
+	// written in time order, so a stable sort by signal is enough.
+	std::stable_sort(m_dir.begin(), m_dir.end(),
+		[](const VCHUNK &a, const VCHUNK &b) {
+			return a.m_sig < b.m_sig; });
+	if (m_dir.size() > 0)
+		fwrite(&m_dir[0], sizeof(VCHUNK), m_dir.size(), m_fp);
+
+	memcpy(hdr.m_magic, IDX_MAGIC, sizeof(IDX_MAGIC));
+	hdr.m_vcd_size  = sb.st_size;
+	hdr.m_vcd_mtime = sb.st_mtime;
+	hdr.m_nsigs  = m_sigs.size();
+	hdr.m_nnames = m_names.size();
+	hdr.m_nchunks= m_dir.size();
+	hdr.m_tmax   = m_tmax;
+	fseek(m_fp, 0, SEEK_SET);
+	if (fwrite(&hdr, sizeof(hdr), 1, m_fp) != 1) {
+		fprintf(stderr, "ERR: Could not write index\n");
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	}
+	fclose(m_fp);
+	m_fp = NULL;
+	std::vector<std::vector<VCHANGE> >().swap(m_pending);
+
+	fprintf(stderr, "Indexed %u signals, %lu chunks, through time %lu\n",
+		(unsigned)m_sigs.size(), (unsigned long)m_dir.size(),
+		(unsigned long)m_tmax);
+}
+
+//
+// open()
+//
+// Load the signal tables and chunk directory from the index.  Returns false
+// if the index doesn't exist, or doesn't match the trace.
+//
+bool	VCDINDEX::open(const char *vcdname, const char *idxname) {
+	struct	stat	sb;
+	IDXHDR		hdr;
+
+	if (0 != stat(vcdname, &sb))
+		return false;
+	if (m_fp)
+		fclose(m_fp);
+	if (NULL == (m_fp = fopen(idxname, "r")))
+		return false;
+	if ((fread(&hdr, sizeof(hdr), 1, m_fp) != 1)
+			||(memcmp(hdr.m_magic, IDX_MAGIC, sizeof(IDX_MAGIC))!=0)
+			||(hdr.m_vcd_size  != (uint64_t)sb.st_size)
+			||(hdr.m_vcd_mtime != (uint64_t)sb.st_mtime)) {
+		fclose(m_fp);
+		m_fp = NULL;
+		return false;
+	}
+
+	m_tmax = hdr.m_tmax;
+	m_sigs.resize(hdr.m_nsigs);
+	m_names.resize(hdr.m_nnames);
+	m_dir.resize(hdr.m_nchunks);
+
+	fseek(m_fp, hdr.m_names_offset, SEEK_SET);
+	if (hdr.m_nsigs > 0)
+		fread(&m_sigs[0], sizeof(VSIGNAL), hdr.m_nsigs, m_fp);
+	for(unsigned k=0; k<hdr.m_nnames; k++) {
+		uint32_t	ln = 0;
+		fread(&m_names[k].m_sig, sizeof(uint32_t), 1, m_fp);
+		fread(&ln, sizeof(uint32_t), 1, m_fp);
+		m_names[k].m_name.resize(ln);
+		if (ln > 0)
+			fread(&m_names[k].m_name[0], 1, ln, m_fp);
+	}
+
+	fseek(m_fp, hdr.m_dir_offset, SEEK_SET);
+	if ((hdr.m_nchunks > 0)&&(fread(&m_dir[0], sizeof(VCHUNK),
+			hdr.m_nchunks, m_fp) != hdr.m_nchunks)) {
+		fprintf(stderr, "ERR: Index %s is truncated\n", idxname);
+		exit(EXIT_FAILURE);
+	}
+
+	m_first.assign(m_sigs.size()+1, m_dir.size());
+	for(uint64_t k=m_dir.size(); k>0; k--)
+		m_first[m_dir[k-1].m_sig] = k-1;
+	for(unsigned k=m_sigs.size(); k>0; k--)
+		if (m_first[k-1] > m_first[k])
+			m_first[k-1] = m_first[k];
+
+	return true;
+}
+
+void	VCDINDEX::read_chunk(uint64_t k, std::vector<VCHANGE> &data) {
+	const	VCHUNK	&ck = m_dir[k];
+
+	data.resize(ck.m_count);
+	fseek(m_fp, ck.m_offset, SEEK_SET);
+	if (fread(&data[0], sizeof(VCHANGE), ck.m_count, m_fp) != ck.m_count) {
+		fprintf(stderr, "ERR: Index is truncated\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+//
+// lookup()
+//
+// Find a signal by its full name, or else by a unique trailing part of its
+// name (following a '.')
+//
+int	VCDINDEX::lookup(const char *name) const {
+	size_t	nln = strlen(name);
+	int	found = -1;
+
+	for(unsigned k=0; k<m_names.size(); k++)
+		if (m_names[k].m_name == name)
+			return m_names[k].m_sig;
+
+	for(unsigned k=0; k<m_names.size(); k++) {
+		const std::string &s = m_names[k].m_name;
+
+		if ((s.size() > nln)&&(s[s.size()-nln-1] == '.')
+				&&(0 == strcmp(&s.c_str()[s.size()-nln], name))) {
+			if ((found >= 0)&&(found != (int)m_names[k].m_sig)) {
+				fprintf(stderr, "ERR: %s is ambiguous, it could be %s or %s\n",
+					name, signame(found), s.c_str());
+				exit(EXIT_FAILURE);
+			} found = m_names[k].m_sig;
+		}
+	}
+
+	if (found < 0) {
+		fprintf(stderr, "ERR: No such signal, %s\n", name);
+		exit(EXIT_FAILURE);
+	} return found;
+}
+
+const	char	*VCDINDEX::signame(unsigned sig) const {
+	for(unsigned k=0; k<m_names.size(); k++)
+		if (m_names[k].m_sig == sig)
+			return m_names[k].m_name.c_str();
+	return "(unknown)";
+}
+// }}}
+
+//
+// SIGCURSOR
+// {{{
+// Walks through the changes of one signal in time order, holding no more
+// than one chunk in memory at a time.
+//
+class	SIGCURSOR {
+	VCDINDEX		*m_idx;
+	unsigned		m_sig;
+	uint64_t		m_chunk;
+	std::vector<VCHANGE>	m_data;
+	size_t			m_pos;
+	uint64_t		m_value;
+
+	bool	load(uint64_t ck) {
+		if (ck >= m_idx->last_chunk(m_sig))
+			return false;
+		m_chunk = ck;
+		m_idx->read_chunk(ck, m_data);
+		m_pos = 0;
+		return true;
+	}
+public:
+	SIGCURSOR(VCDINDEX *idx, unsigned sig) : m_idx(idx), m_sig(sig),
+			m_pos(0), m_value(0) {
+		m_chunk = idx->first_chunk(sig);
+		if (!load(m_chunk))
+			m_data.clear();
+	}
+
+	unsigned	sig(void) const { return m_sig; }
+	// The value as of the last change consumed
+	uint64_t	value(void) const { return m_value; }
+
+	// Time of the next change, or UINT64_MAX if there are no more
+	uint64_t	next_time(void) {
+		if ((m_pos >= m_data.size())&&(!load(m_chunk+1)))
+			return UINT64_MAX;
+		return m_data[m_pos].m_time;
+	}
+
+	// Consume the next change
+	void	step(void) {
+		if (next_time() != UINT64_MAX)
+			m_value = m_data[m_pos++].m_value;
+	}
+
+	// Consume all changes at or before t
+	void	seek(uint64_t t) {
+		uint64_t	first = m_idx->first_chunk(m_sig),
+				last  = m_idx->last_chunk(m_sig), ck;
+
+		// Binary search for the last chunk starting at or before t
+		if ((first < last)&&(m_idx->chunk(first).m_t0 <= t)) {
+			uint64_t	lo = first, hi = last;
+			while(hi - lo > 1) {
+				uint64_t mid = (lo + hi)/2;
+				if (m_idx->chunk(mid).m_t0 <= t)
+					lo = mid;
+				else
+					hi = mid;
+			} ck = lo;
+			if ((ck != m_chunk)||(m_data.size() == 0))
+				load(ck);
+
+			// ... and then for the change within it
+			auto	it = std::upper_bound(m_data.begin(),
+					m_data.end(), t,
+					[](uint64_t v, const VCHANGE &c) {
+						return v < c.m_time; });
+			m_pos = it - m_data.begin();
+			m_value = m_data[m_pos-1].m_value;
+		} else {
+			// Nothing has happened yet
+			m_value = 0;
+			if (first < last)
+				load(first);
+		}
+	}
+};
+// }}}
+
+static	void	print_value(FILE *fp, const VSIGNAL &vs, uint64_t v) {
+	if (vs.m_width <= 1)
+		fprintf(fp, "%d", (int)(v&1));
+	else if (vs.m_width <= 32)
+		fprintf(fp, "0x%08x", (unsigned)v);
+	else
+		fprintf(fp, "0x%016lx", (unsigned long)v);
+}
+
+static	uint64_t	time_arg(const char *str) {
+	uint64_t	t;
+
+	if (!parse_time(str, t)) {
+		fprintf(stderr, "ERR: Bad time, %s\n", str);
+		exit(EXIT_FAILURE);
+	} return t;
+}
+
+static	void	cmd_list(VCDINDEX &idx, const char *pattern) {
+	for(unsigned k=0; k<idx.nnames(); k++) {
+		const	VNAME	&vn = idx.name(k);
+		if ((pattern)&&(NULL == strstr(vn.m_name.c_str(), pattern)))
+			continue;
+		printf("%-60s %3u %10lu\n", vn.m_name.c_str(),
+			idx.sig(vn.m_sig).m_width,
+			(unsigned long)idx.sig(vn.m_sig).m_nchanges);
+	}
+}
+
+static	void	cmd_value(VCDINDEX &idx, const char *name, uint64_t t) {
+	unsigned	sig = idx.lookup(name);
+	SIGCURSOR	c(&idx, sig);
+
+	c.seek(t);
+	printf("%s @%lu = ", idx.signame(sig), (unsigned long)t);
+	print_value(stdout, idx.sig(sig), c.value());
+	printf("\n");
+}
+
+static	void	cmd_changes(VCDINDEX &idx, const char *name, uint64_t t0,
+		uint64_t t1) {
+	unsigned	sig = idx.lookup(name);
+	SIGCURSOR	c(&idx, sig);
+	uint64_t	t;
+
+	if (t0 > 0) {
+		c.seek(t0-1);
+	}
+	while((t = c.next_time()) <= t1) {
+		c.step();
+		printf("@%-12lu ", (unsigned long)t);
+		print_value(stdout, idx.sig(sig), c.value());
+		printf("\n");
+	}
+}
+
+//
+// Walk a set of cursors forward together, calling fn(t) after every time
+// step at which any of them changed
+//
+template<class FN>	static	void	merge(std::vector<SIGCURSOR *> &cv,
+		FN fn) {
+	while(true) {
+		uint64_t	t = UINT64_MAX;
+
+		for(unsigned k=0; k<cv.size(); k++)
+			t = std::min(t, cv[k]->next_time());
+		if (t == UINT64_MAX)
+			break;
+		for(unsigned k=0; k<cv.size(); k++)
+			if (cv[k]->next_time() == t)
+				cv[k]->step();
+		fn(t);
+	}
+}
+
+static	void	cmd_writes(VCDINDEX &idx, uint64_t addr, const char *stbn,
+		const char *wen, const char *addrn, const char *datan,
+		const char *clkn, int shift) {
+	SIGCURSOR	stb(&idx, idx.lookup(stbn)), we(&idx, idx.lookup(wen)),
+			adr(&idx, idx.lookup(addrn)), dat(&idx, idx.lookup(datan));
+	SIGCURSOR	*clk = NULL;
+	std::vector<SIGCURSOR *>	cv = { &stb, &we, &adr, &dat };
+	uint64_t	last_clk = 0;
+
+	if (clkn) {
+		clk = new SIGCURSOR(&idx, idx.lookup(clkn));
+		cv.push_back(clk);
+	}
+
+	merge(cv, [&](uint64_t t) {
+		if (clk) {
+			// Only sample on the rising edge
+			bool	posedge = (clk->value() & 1)&&(!(last_clk & 1));
+			last_clk = clk->value();
+			if (!posedge)
+				return;
+		}
+		if ((stb.value() & 1)&&(we.value() & 1)
+				&&((adr.value() << shift) == addr)) {
+			printf("@%-12lu [0x%08lx] <- ", (unsigned long)t,
+				(unsigned long)addr);
+			print_value(stdout, idx.sig(dat.sig()), dat.value());
+			printf("\n");
+		}
+	});
+
+	delete	clk;
+}
+
+static	void	cmd_dump(VCDINDEX &idx, int nsigs, char **names) {
+	std::vector<SIGCURSOR *>	cv;
+
+	for(int k=0; k<nsigs; k++) {
+		cv.push_back(new SIGCURSOR(&idx, idx.lookup(names[k])));
+		printf("%s%s", (k>0) ? ", ":"# Time, ",
+			idx.signame(cv.back()->sig()));
+	} printf("\n");
+
+	merge(cv, [&](uint64_t t) {
+		printf("@%-12lu", (unsigned long)t);
+		for(unsigned k=0; k<cv.size(); k++) {
+			printf(" ");
+			print_value(stdout, idx.sig(cv[k]->sig()),
+				cv[k]->value());
+		} printf("\n");
+	});
+
+	for(unsigned k=0; k<cv.size(); k++)
+		delete cv[k];
+}
+
+void	usage(void) {
+	fprintf(stderr,
+"USAGE: vcdq [-m <MB>] [-f] <trace.vcd> <command> [args]\n"
+"\n"
+"\t-f\tForce the index to be rebuilt\n"
+"\t-m <MB>\tMemory budget while indexing, in megabytes (default 64)\n"
+"\n"
+"Commands:\n"
+"\tindex\t\t\tBuild the index, <trace.vcd>.idx\n"
+"\tlist [pattern]\t\tList signals, their widths, and change counts\n"
+"\tvalue SIG T\t\tThe value of SIG at time T\n"
+"\tchanges SIG [T0 [T1]]\tAll changes of SIG, from T0 through T1\n"
+"\twrites ADDR [opts]\tAll bus writes to byte address ADDR\n"
+"\t\t-stb/-we/-addr/-data SIG\tBus signals (zip_stb, zip_we, ...)\n"
+"\t\t-shift N\tLeft shift applied to the address signal (2)\n"
+"\t\t-clk CLK\tSample on the rising edges of CLK\n"
+"\tdump SIG [SIG ...]\tA table of the given signals, one line per change\n");
+}
+
+int main(int argc, char **argv) {
+	const	char	*vcdname = NULL, *cmd = NULL;
+	uint64_t	budget = 64ul << 20;
+	bool		force = false;
+	int		argn;
+	VCDINDEX	idx;
+
+	for(argn=1; argn<argc; argn++) {
+		if (0 == strcmp(argv[argn], "-f"))
+			force = true;
+		else if ((0 == strcmp(argv[argn], "-m"))&&(argn+1 < argc))
+			budget = strtoul(argv[++argn], NULL, 0) << 20;
+		else if (0 == strcmp(argv[argn], "-h")) {
+			usage();
+			exit(EXIT_SUCCESS);
+		} else
+			break;
+	}
+
+	if (argn + 2 > argc) {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	vcdname = argv[argn++];
+	cmd = argv[argn++];
+
+	{
+		size_t	ln = strlen(vcdname);
+		if ((ln > 4)&&(0 == strcmp(&vcdname[ln-4], ".fst"))) {
+			fprintf(stderr, "ERR: FST traces are not supported.  Convert %s with fst2vcd first\n", vcdname);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	std::string	idxname = std::string(vcdname) + ".idx";
+
+	if ((force)||(0 == strcmp(cmd, "index"))
+			||(!idx.open(vcdname, idxname.c_str()))) {
+		idx.build(vcdname, idxname.c_str(), budget);
+		if (!idx.open(vcdname, idxname.c_str())) {
+			fprintf(stderr, "ERR: Could not open the new index, %s\n",
+				idxname.c_str());
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (0 == strcmp(cmd, "index")) {
+		// All done
+	} else if (0 == strcmp(cmd, "list")) {
+		cmd_list(idx, (argn < argc) ? argv[argn] : NULL);
+	} else if ((0 == strcmp(cmd, "value"))&&(argn+2 == argc)) {
+		cmd_value(idx, argv[argn], time_arg(argv[argn+1]));
+	} else if ((0 == strcmp(cmd, "changes"))&&(argn < argc)) {
+		uint64_t	t0 = 0, t1 = UINT64_MAX - 1;
+		if (argn+1 < argc)
+			t0 = time_arg(argv[argn+1]);
+		if (argn+2 < argc)
+			t1 = time_arg(argv[argn+2]);
+		cmd_changes(idx, argv[argn], t0, t1);
+	} else if ((0 == strcmp(cmd, "writes"))&&(argn < argc)) {
+		const char	*stbn = "zip_stb", *wen = "zip_we",
+				*addrn = "zip_addr", *datan = "zip_data",
+				*clkn = NULL;
+		uint64_t	addr = strtoull(argv[argn++], NULL, 0);
+		int		shift = 2;
+
+		for(; argn+1<argc; argn+=2) {
+			if (0 == strcmp(argv[argn], "-stb"))
+				stbn = argv[argn+1];
+			else if (0 == strcmp(argv[argn], "-we"))
+				wen = argv[argn+1];
+			else if (0 == strcmp(argv[argn], "-addr"))
+				addrn = argv[argn+1];
+			else if (0 == strcmp(argv[argn], "-data"))
+				datan = argv[argn+1];
+			else if (0 == strcmp(argv[argn], "-clk"))
+				clkn = argv[argn+1];
+			else if (0 == strcmp(argv[argn], "-shift"))
+				shift = atoi(argv[argn+1]);
+			else
+				break;
+		} if (argn < argc) {
+			usage();
+			exit(EXIT_FAILURE);
+		}
+
+		cmd_writes(idx, addr, stbn, wen, addrn, datan, clkn, shift);
+	} else if ((0 == strcmp(cmd, "dump"))&&(argn < argc)) {
+		cmd_dump(idx, argc-argn, &argv[argn]);
+	} else {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	return EXIT_SUCCESS;
+}
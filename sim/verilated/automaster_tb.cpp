@@ -55,6 +55,46 @@
 
 #include "main_tb.cpp"
 
+//
+// Simulation throughput reporting (-b).  The simulation usually ends by
+// way of an exit() call from within the CPU's simulation hooks, so the
+// report is made from an atexit() handler.
+//
+static	MAINTB		*gbl_bench_tb = NULL;
+static	struct timespec	gbl_bench_start;
+
+static	void	bench_report(void) {
+	struct timespec	now;
+	double		secs;
+	unsigned long	clocks;
+
+	if (!gbl_bench_tb)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	secs = (now.tv_sec - gbl_bench_start.tv_sec)
+		+ (now.tv_nsec - gbl_bench_start.tv_nsec) * 1e-9;
+	// TESTB advances m_time_ps by 10ns per clock
+	clocks = gbl_bench_tb->m_time_ps / 10000ul;
+	fprintf(stderr, "BENCH: %lu clocks in %.3f s, %.0f clocks/s\n",
+		clocks, secs, (secs > 0.0) ? clocks / secs : 0.0);
+}
+
+#ifdef	FLASH_ACCESS
+//
+// Saving the flash contents on exit (-w).  As above, this needs to happen
+// from an atexit() handler.
+//
+static	FLASHSIM	*gbl_flash_snap = NULL;
+static	const char	*gbl_flash_snapfile = NULL;
+
+static	void	flash_snapshot(void) {
+	if ((gbl_flash_snap)&&(gbl_flash_snapfile)) {
+		gbl_flash_snap->snapshot(gbl_flash_snapfile);
+		gbl_flash_snap = NULL;
+	}
+}
+#endif
+
 void	usage(void) {
 	fprintf(stderr, "USAGE: main_tb <options> [zipcpu-elf-file]\n");
 	fprintf(stderr,
@@ -64,10 +104,31 @@ void	usage(void) {
 "\t\tmore realistic.  Reads from the SD-card will be directed to\n"
 "\t\t\"sectors\" within this image.\n\n"
 #endif
+"\t-b\tReports the simulation rate, in clocks per second, on exit\n"
 "\t-d\tSets the debugging flag\n"
+"\t-l <filename>\n"
+"\t\tSends the CPU's simulation console output (SOUT instructions,\n"
+"\t\tregister dumps, etc.) to <filename> rather than stdout\n"
+#ifdef	FLASH_ACCESS
+"\t-p <img-file>\n"
+"\t\tUses <img-file> as a persistent flash image.  The file is\n"
+"\t\tmapped into memory, so anything programmed or erased during\n"
+"\t\tthe simulation will still be there on the next run.  The file\n"
+"\t\tis created if it doesn't exist.\n"
+"\t-s <img-file>\n"
+"\t\tStarts from a copy-on-write snapshot of <img-file>.  The\n"
+"\t\tsimulation may program or erase the flash, but the file itself\n"
+"\t\tis never changed.\n"
+"\t-w <img-file>\n"
+"\t\tWrites the final flash contents to <img-file> on exit\n"
+#endif
 "\t-t <filename>\n"
 "\t\tTurns on tracing, sends the trace to <filename>--assumed to\n"
 "\t\tbe a vcd file\n"
+#ifdef	FLASH_ACCESS
+"\t-x\tDisables the flash simulator's XIP fast path, so that every\n"
+"\t\tflash clock goes through the full state machine\n"
+#endif
 );
 }
 
@@ -82,8 +143,13 @@ int	main(int argc, char **argv) {
 			*sdimage_file = NULL,
 #endif
 			*profile_file = NULL,
+#ifdef	FLASH_ACCESS
+			*flash_image = NULL,
+#endif
+			*console_log = NULL,
 			*trace_file = NULL; // "trace.vcd";
-	bool	debug_flag = false, willexit = false;
+	bool	debug_flag = false, willexit = false, bench_flag = false,
+		xip_fastpath = true, persistent_flash = false;
 	FILE	*profile_fp;
 
 	MAINTB	*tb = new MAINTB;
@@ -95,13 +161,24 @@ int	main(int argc, char **argv) {
 #ifdef	SDSPI_ACCESS
 			case 'c': sdimage_file = argv[++argn]; j = 1000; break;
 #endif
+			case 'b': bench_flag = true; break;
 			case 'd': debug_flag = true;
 				if (trace_file == NULL)
 					trace_file = "trace.vcd";
 				break;
 			case 'f': profile_file = "pfile.bin"; break;
+			case 'l': console_log = argv[++argn]; j = 1000; break;
 			case 't': trace_file = argv[++argn]; j=1000; break;
 			case 'h': usage(); exit(0); break;
+#ifdef	FLASH_ACCESS
+			case 'p': flash_image = argv[++argn];
+				persistent_flash = true; j = 1000; break;
+			case 's': flash_image = argv[++argn];
+				persistent_flash = false; j = 1000; break;
+			case 'w': gbl_flash_snapfile = argv[++argn];
+				j = 1000; break;
+#endif
+			case 'x': xip_fastpath = false; break;
 			default:
 				fprintf(stderr, "ERR: Unexpected flag, -%c\n\n",
 					argv[argn][j]);
@@ -148,6 +225,19 @@ int	main(int argc, char **argv) {
 		profile_fp = NULL;
 
 
+	if ((console_log)&&(!tb->m_simcon.log(console_log)))
+		exit(EXIT_FAILURE);
+
+#ifdef	FLASH_ACCESS
+	tb->m_flash->xip_fastpath(xip_fastpath);
+	if ((flash_image)&&(!tb->m_flash->image(flash_image, persistent_flash)))
+		exit(EXIT_FAILURE);
+	if (gbl_flash_snapfile) {
+		gbl_flash_snap = tb->m_flash;
+		atexit(flash_snapshot);
+	}
+#endif
+
 	tb->reset();
 #ifdef	SDSPI_ACCESS
 	tb->setsdcard(sdimage_file);
@@ -190,6 +280,12 @@ int	main(int argc, char **argv) {
 		tb->m_core->VVAR(_swic__DOT__cmd_reset) = 0;
 	}
 
+	if (bench_flag) {
+		gbl_bench_tb = tb;
+		clock_gettime(CLOCK_MONOTONIC, &gbl_bench_start);
+		atexit(bench_report);
+	}
+
 #ifdef	OLED_ACCESS
 	Gtk::Main::run(tb->m_oled);
 #else
@@ -223,6 +319,11 @@ int	main(int argc, char **argv) {
 #endif
 
 	tb->close();
+	bench_report();
+	gbl_bench_tb = NULL;
+#ifdef	FLASH_ACCESS
+	flash_snapshot();
+#endif
 	delete tb;
 
 	return	EXIT_SUCCESS;
@@ -48,6 +48,10 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "flashsim.h"
 
@@ -92,10 +96,141 @@ FLASHSIM::FLASHSIM(const int lglen, bool debug,
 	m_mode = FM_SPI;
 	m_mode_byte = 0;
 	m_idle_throttle = false;
+	m_ckdelay = m_rddelay = NULL;
+	m_xip_ptr = NULL;
+	m_xip_enabled = true;
+	m_mapped = false;
 
 	memset(m_mem, 0x0ff, m_membytes);
 }
 
+FLASHSIM::~FLASHSIM(void) {
+	if (m_mapped) {
+		msync(m_mem, m_membytes, MS_SYNC);
+		munmap(m_mem, m_membytes);
+	} else
+		delete[] m_mem;
+	delete[] m_pmem;
+	delete[] m_ckdelay;
+	delete[] m_rddelay;
+}
+
+bool	FLASHSIM::image(const char *fname, const bool persistent) {
+	struct	stat	sb;
+	char		*mem;
+	size_t		flen;
+	int		fd;
+
+	fd = open(fname, (persistent) ? (O_RDWR|O_CREAT) : O_RDONLY, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "SPI-FLASH: Could not open %s\n", fname);
+		perror("O/S Err:");
+		return false;
+	} if (fstat(fd, &sb) != 0) {
+		fprintf(stderr, "SPI-FLASH: Could not stat %s\n", fname);
+		perror("O/S Err:");
+		::close(fd);
+		return false;
+	}
+
+	flen = sb.st_size;
+	if (flen > m_membytes)
+		flen = m_membytes;
+
+	if (persistent) {
+		// Grow the file to the size of the device.  The new space
+		// must read as erased (0xff), not as the zeros ftruncate
+		// fills it with.
+		if ((flen < m_membytes)&&(ftruncate(fd, m_membytes) != 0)) {
+			fprintf(stderr, "SPI-FLASH: Could not extend %s\n", fname);
+			perror("O/S Err:");
+			::close(fd);
+			return false;
+		}
+
+		mem = (char *)mmap(NULL, m_membytes, PROT_READ|PROT_WRITE,
+				MAP_SHARED, fd, 0);
+		if (MAP_FAILED == mem) {
+			fprintf(stderr, "SPI-FLASH: Could not map %s\n", fname);
+			perror("O/S Err:");
+			::close(fd);
+			return false;
+		}
+
+		if (flen < m_membytes)
+			memset(&mem[flen], 0x0ff, m_membytes - flen);
+	} else {
+		// Start from an anonymous, fully erased device, and then map
+		// the file's pages privately over the front of it.  Pages are
+		// only copied if and when the simulation writes to them.
+		mem = (char *)mmap(NULL, m_membytes, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (MAP_FAILED == mem) {
+			perror("O/S Err:");
+			::close(fd);
+			return false;
+		}
+		memset(mem, 0x0ff, m_membytes);
+
+		if ((flen > 0)&&(MAP_FAILED == mmap(mem, flen,
+				PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_FIXED,
+				fd, 0))) {
+			fprintf(stderr, "SPI-FLASH: Could not map %s\n", fname);
+			perror("O/S Err:");
+			munmap(mem, m_membytes);
+			::close(fd);
+			return false;
+		}
+
+		// The kernel zero fills the remainder of the last page past
+		// the end of the file.  Erase it.
+		size_t	pgsz = sysconf(_SC_PAGESIZE),
+			pgend = (flen + pgsz - 1) & ~(pgsz - 1);
+		if (pgend > m_membytes)
+			pgend = m_membytes;
+		if (flen < pgend)
+			memset(&mem[flen], 0x0ff, pgend - flen);
+	}
+
+	// The mapping holds its own reference to the file
+	::close(fd);
+
+	// Any burst in progress points into the memory about to be replaced
+	xip_stop();
+	if (m_mapped)
+		munmap(m_mem, m_membytes);
+	else
+		delete[] m_mem;
+	m_mem = mem;
+	m_mapped = true;
+
+	if (m_debug)
+		fprintf(stderr, "SPI-FLASH: Using %s image, %s\n",
+			(persistent) ? "persistent" : "copy-on-write", fname);
+	return true;
+}
+
+bool	FLASHSIM::snapshot(const char *fname) const {
+	FILE	*fp;
+	size_t	nw;
+
+	if (NULL == (fp = fopen(fname, "w"))) {
+		fprintf(stderr, "SPI-FLASH: Could not create %s\n", fname);
+		perror("O/S Err:");
+		return false;
+	}
+
+	nw = fwrite(m_mem, sizeof(char), m_membytes, fp);
+	fclose(fp);
+	if (nw != m_membytes) {
+		fprintf(stderr, "SPI-FLASH: Could not write %s\n", fname);
+		perror("O/S Err:");
+		return false;
+	}
+
+	return true;
+}
+
 void	FLASHSIM::load(const unsigned addr, const char *fname) {
 	FILE	*fp;
 	size_t	len;
@@ -151,6 +286,20 @@ bool	FLASHSIM::deep_sleep(void) const {
 
 #define	QOREG(A)	m_oreg = ((m_oreg & (~0x0ff))|((A)&0x0ff))
 
+//
+// xip_start
+//
+// Called once a quad read has produced its first data byte.  From here on,
+// until CS# rises, every byte is just the next byte in memory, so there's
+// no need to walk through the command decoder on every clock.
+//
+void	FLASHSIM::xip_start(void) {
+	if ((m_xip_enabled)&&(!m_debug)) {
+		m_addr &= m_memmask;
+		m_xip_ptr = &m_mem[m_addr];
+	}
+}
+
 int	FLASHSIM::operator()(const int csn, const int sck, const int dat) {
 	// Keep track of a timer to determine when page program and erase
 	// cycles complete.
@@ -163,6 +312,27 @@ int	FLASHSIM::operator()(const int csn, const int sck, const int dat) {
 			printf("%6x cycles remaining \'til write/erase completion\n", m_write_count);
 	}
 
+	if (m_xip_ptr) {
+		if (!csn) {
+			// XIP fast path: quad read burst in progress
+			if ((m_last_sck)&&(!sck)) {
+				m_ireg = (m_ireg << 4) | (dat & 0x0f);
+				m_oreg <<= 4;
+				if (m_count & 4) {
+					QOREG(*m_xip_ptr++);
+					if (m_xip_ptr >= &m_mem[m_membytes])
+						m_xip_ptr = m_mem;
+				} m_count += 4;
+			}
+
+			m_last_sck = sck;
+			return (m_oreg>>8)&0x0f;
+		}
+
+		// End of burst.  Fall through to the full state machine.
+		xip_stop();
+	}
+
 	if (csn) {
 		m_last_sck = 1;
 		m_ireg = 0; m_oreg = 0;
@@ -562,6 +732,7 @@ int	FLASHSIM::operator()(const int csn, const int sck, const int dat) {
 				QOREG(m_mem[m_addr++]);
 				// printf("QSPIF[%08x]/QR = %02x\n",
 					// m_addr-1, m_oreg);
+				xip_start();
 			} else m_oreg = 0;
 			break;
 		case QSPIF_DUAL_READ:
@@ -583,6 +754,7 @@ int	FLASHSIM::operator()(const int csn, const int sck, const int dat) {
 			} else if ((m_count >= 24+4*NDUMMY)&&(0 == (m_sreg&0x01))) {
 				QOREG(m_mem[m_addr++]);
 				if (m_debug) printf("QSPIF[%08x]/QR = %02x\n", m_addr-1, m_oreg & 0x0ff);
+				xip_start();
 			} else m_oreg = 0;
 			break;
 		case QSPIF_PP:
@@ -99,14 +99,41 @@ class	FLASHSIM {
 	bool		m_debug, m_idle_throttle;
 	FLASH_MODE	m_mode;
 
+	// XIP fast path.  Once a quad read burst has its address and dummy
+	// cycles behind it, m_xip_ptr points at the next byte to be sent and
+	// operator() just shifts nibbles out until CS# is released.  NULL
+	// when no burst is in progress.
+	char		*m_xip_ptr;
+	bool		m_xip_enabled;
+
+	// Set if m_mem is an mmap()'d flash image rather than a heap buffer
+	bool		m_mapped;
+
 	const	unsigned	CKDELAY, RDDELAY, NDUMMY;
 
 	int		*m_ckdelay, *m_rddelay;
 
+	void	xip_start(void);
+	// Ends any fast path burst, leaving m_addr where the full state
+	// machine would have left it
+	void	xip_stop(void) {
+		if (m_xip_ptr)
+			m_addr = (unsigned)(m_xip_ptr - m_mem);
+		m_xip_ptr = NULL;
+	}
 public:
 	FLASHSIM(const int lglen = 24, bool debug = false,
 		const int rddelay = FLASH_RDDELAY,
 		const int ndummy = FLASH_NDUMMY);
+	~FLASHSIM(void);
+	// Back the flash memory with a file via mmap().  If persistent, the
+	// file is mapped shared, so that any page program or erase operations
+	// end up in the file for the next run.  Otherwise the file is mapped
+	// copy-on-write: the simulation sees (and may change) its contents,
+	// but the file itself is never modified.
+	bool	image(const char *fname, const bool persistent);
+	// Write the current flash contents to a file
+	bool	snapshot(const char *fname) const;
 	void	load(const char *fname) { load(0, fname); }
 	void	load(const unsigned addr, const char *fname);
 	void	load(const uint32_t offset, const char *data, const uint32_t len);
@@ -117,8 +144,13 @@ public:
 	bool	deep_sleep(void) const;
 	bool	dual_mode(void) { return (m_mode == FM_DSPI); }
 	bool	quad_mode(void) { return (m_mode == FM_QSPI); }
-	void	debug(const bool dbg) { m_debug = dbg; }
+	void	debug(const bool dbg) { m_debug = dbg; xip_stop(); }
 	bool	debug(void) const { return m_debug; }
+	// Enable (default) or disable the XIP read fast path.  Disabling it
+	// forces every clock of a read burst through the full state machine,
+	// which is useful for checking the fast path against the original.
+	void	xip_fastpath(const bool en) { m_xip_enabled = en; xip_stop(); }
+	bool	xip_fastpath(void) const { return m_xip_enabled; }
 	unsigned operator[](const int index) {
 		unsigned char	*cptr = (unsigned char *)&m_mem[index<<2];
 		unsigned	v;
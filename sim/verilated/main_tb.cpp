@@ -54,6 +54,7 @@
 #include "regdefs.h"
 #include "testb.h"
 #include "zipelf.h"
+#include "simconsole.h"
 
 #include "byteswap.h"
 #include "dbluartsim.h"
@@ -173,6 +174,7 @@ public:
 		// SIM.DEFNS tag to have those components defined here
 		// as part of the main_tb.cpp function.
 	int	m_cpu_bombed;
+	SIMCONSOLE	m_simcon;
 	DBLUARTSIM	*m_wbu;
 #ifdef	SDSPI_ACCESS
 	SDSPISIM	m_sdcard;
@@ -253,12 +255,13 @@ public:
 			//
 			execsim(m_core->cpu_sim_immv);
 		}
+		m_simcon.tick();
 
 		if (m_cpu_bombed) {
 			if (m_cpu_bombed++ > 12)
 				m_done = true;
 		} else if (m_core->cpu_break) {
-			printf("\n\nBOMB : CPU BREAK RECEIVED\n");
+			m_simcon.printf("\n\nBOMB : CPU BREAK RECEIVED\n");
 			m_cpu_bombed++;
 			dump(m_core->cpu_regs);
 		}
@@ -469,57 +472,55 @@ public:
 	void dump(const uint32_t *regp) {
 		uint32_t	uccv, iccv, ipc, upc;
 		fflush(stderr);
-		fflush(stdout);
-		printf("ZIPM--DUMP: ");
+		m_simcon.printf("ZIPM--DUMP: ");
 		if (gie())
-			printf("Interrupts-enabled\n");
+			m_simcon.printf("Interrupts-enabled\n");
 		else
-			printf("Supervisor mode\n");
-		printf("\n");
+			m_simcon.printf("Supervisor mode\n");
+		m_simcon.printf("\n");
 
 		iccv = m_core->cpu_iflags;
 		uccv = m_core->cpu_uflags;
 		ipc = m_core->cpu_ipc;
 		upc = m_core->cpu_upc;
 
-		printf("sR0 : %08x ", regp[0]);
-		printf("sR1 : %08x ", regp[1]);
-		printf("sR2 : %08x ", regp[2]);
-		printf("sR3 : %08x\n",regp[3]);
-		printf("sR4 : %08x ", regp[4]);
-		printf("sR5 : %08x ", regp[5]);
-		printf("sR6 : %08x ", regp[6]);
-		printf("sR7 : %08x\n",regp[7]);
-		printf("sR8 : %08x ", regp[8]);
-		printf("sR9 : %08x ", regp[9]);
-		printf("sR10: %08x ", regp[10]);
-		printf("sR11: %08x\n",regp[11]);
-		printf("sR12: %08x ", regp[12]);
-		printf("sSP : %08x ", regp[13]);
-		printf("sCC : %08x ", iccv);
-		printf("sPC : %08x\n",ipc);
-
-		printf("\n");
-
-		printf("uR0 : %08x ", regp[16]);
-		printf("uR1 : %08x ", regp[17]);
-		printf("uR2 : %08x ", regp[18]);
-		printf("uR3 : %08x\n",regp[19]);
-		printf("uR4 : %08x ", regp[20]);
-		printf("uR5 : %08x ", regp[21]);
-		printf("uR6 : %08x ", regp[22]);
-		printf("uR7 : %08x\n",regp[23]);
-		printf("uR8 : %08x ", regp[24]);
-		printf("uR9 : %08x ", regp[25]);
-		printf("uR10: %08x ", regp[26]);
-		printf("uR11: %08x\n",regp[27]);
-		printf("uR12: %08x ", regp[28]);
-		printf("uSP : %08x ", regp[29]);
-		printf("uCC : %08x ", uccv);
-		printf("uPC : %08x\n",upc);
-		printf("\n");
-		fflush(stderr);
-		fflush(stdout);
+		m_simcon.printf("sR0 : %08x ", regp[0]);
+		m_simcon.printf("sR1 : %08x ", regp[1]);
+		m_simcon.printf("sR2 : %08x ", regp[2]);
+		m_simcon.printf("sR3 : %08x\n",regp[3]);
+		m_simcon.printf("sR4 : %08x ", regp[4]);
+		m_simcon.printf("sR5 : %08x ", regp[5]);
+		m_simcon.printf("sR6 : %08x ", regp[6]);
+		m_simcon.printf("sR7 : %08x\n",regp[7]);
+		m_simcon.printf("sR8 : %08x ", regp[8]);
+		m_simcon.printf("sR9 : %08x ", regp[9]);
+		m_simcon.printf("sR10: %08x ", regp[10]);
+		m_simcon.printf("sR11: %08x\n",regp[11]);
+		m_simcon.printf("sR12: %08x ", regp[12]);
+		m_simcon.printf("sSP : %08x ", regp[13]);
+		m_simcon.printf("sCC : %08x ", iccv);
+		m_simcon.printf("sPC : %08x\n",ipc);
+
+		m_simcon.printf("\n");
+
+		m_simcon.printf("uR0 : %08x ", regp[16]);
+		m_simcon.printf("uR1 : %08x ", regp[17]);
+		m_simcon.printf("uR2 : %08x ", regp[18]);
+		m_simcon.printf("uR3 : %08x\n",regp[19]);
+		m_simcon.printf("uR4 : %08x ", regp[20]);
+		m_simcon.printf("uR5 : %08x ", regp[21]);
+		m_simcon.printf("uR6 : %08x ", regp[22]);
+		m_simcon.printf("uR7 : %08x\n",regp[23]);
+		m_simcon.printf("uR8 : %08x ", regp[24]);
+		m_simcon.printf("uR9 : %08x ", regp[25]);
+		m_simcon.printf("uR10: %08x ", regp[26]);
+		m_simcon.printf("uR11: %08x\n",regp[27]);
+		m_simcon.printf("uR12: %08x ", regp[28]);
+		m_simcon.printf("uSP : %08x ", regp[29]);
+		m_simcon.printf("uCC : %08x ", uccv);
+		m_simcon.printf("uPC : %08x\n",upc);
+		m_simcon.printf("\n");
+		m_simcon.flush();
 	}
 
 
@@ -528,12 +529,12 @@ public:
 		int		rbase;
 		rbase = (gie())?16:0;
 
-		fflush(stdout);
 		if ((imm & 0x03fffff)==0)
 			return;
 		// fprintf(stderr, "SIM-INSN(0x%08x)\n", imm);
 		if ((imm & 0x0fffff)==0x00100) {
 			// SIM Exit(0)
+			m_simcon.flush();
 			close();
 			exit(0);
 		} else if ((imm & 0x0ffff0)==0x00310) {
@@ -543,6 +544,7 @@ public:
 			rcode = regp[rnum] & 0x0ff;
 			if ((m_core->cpu_wr_ce)&&(m_core->cpu_wr_reg_id==rnum))
 				rcode = m_core->cpu_wr_gpreg;
+			m_simcon.flush();
 			close();
 			exit(rcode);
 		} else if ((imm & 0x0ffff0)==0x00300) {
@@ -552,17 +554,19 @@ public:
 			rcode = regp[rnum] & 0x0ff;
 			if ((m_core->cpu_wr_ce)&&(m_core->cpu_wr_reg_id==rnum))
 				rcode = m_core->cpu_wr_gpreg;
+			m_simcon.flush();
 			close();
 			exit(rcode);
 		} else if ((imm & 0x0fff00)==0x00100) {
 			// SIM Exit(Imm)
 			int	rcode;
 			rcode = imm & 0x0ff;
+			m_simcon.flush();
 			close();
 			exit(rcode);
 		} else if ((imm & 0x0fffff)==0x002ff) {
 			// Full/unconditional dump
-			printf("SIM-DUMP\n");
+			m_simcon.printf("SIM-DUMP\n");
 			dump(regp);
 		} else if ((imm & 0x0ffff0)==0x00200) {
 			// Dump a register
@@ -571,7 +575,7 @@ public:
 			rcode = regp[rnum];
 			if ((m_core->cpu_wr_ce)&&(m_core->cpu_wr_reg_id==rnum))
 				rcode = m_core->cpu_wr_gpreg;
-			printf("%8lu @%08x R[%2d] = 0x%08x\n", m_time_ps/1000,
+			m_simcon.printf("%8lu @%08x R[%2d] = 0x%08x\n", m_time_ps/1000,
 				m_core->cpu_ipc, rnum, rcode);
 		} else if ((imm & 0x0ffff0)==0x00210) {
 			// Dump a user register
@@ -580,7 +584,7 @@ public:
 			rcode = regp[rnum] & 0x0ff;
 			if ((m_core->cpu_wr_ce)&&(m_core->cpu_wr_reg_id==rnum))
 				rcode = m_core->cpu_wr_gpreg;
-			printf("%8lu @%08x uR[%2d] = 0x%08x\n", m_time_ps/1000,
+			m_simcon.printf("%8lu @%08x uR[%2d] = 0x%08x\n", m_time_ps/1000,
 				m_core->cpu_ipc, rnum, rcode);
 		} else if ((imm & 0x0ffff0)==0x00230) {
 			// SOUT[User Reg]
@@ -589,7 +593,7 @@ public:
 			rcode = regp[rnum];
 			if ((m_core->cpu_wr_ce)&&(m_core->cpu_wr_reg_id==rnum))
 				rcode = m_core->cpu_wr_gpreg;
-			printf("%c", rcode&0x0ff);
+			m_simcon.putch(rcode&0x0ff);
 		} else if ((imm & 0x0fffe0)==0x00220) {
 			// SOUT[User Reg]
 			int	rcode, rnum;
@@ -597,19 +601,19 @@ public:
 			rcode = regp[rnum];
 			if ((m_core->cpu_wr_ce)&&(m_core->cpu_wr_reg_id==rnum))
 				rcode = m_core->cpu_wr_gpreg;
-			printf("%c", rcode&0x0ff);
+			m_simcon.putch(rcode&0x0ff);
 		} else if ((imm & 0x0fff00)==0x00400) {
 			// SOUT[Imm]
-			printf("%c", imm&0x0ff);
+			m_simcon.putch(imm&0x0ff);
 		} else { // if ((insn & 0x0f7c00000)==0x77800000)
 			uint32_t	immv = imm & 0x03fffff;
 			// Simm instruction that we dont recognize
 			// if (imm)
 			// printf("SIM 0x%08x\n", immv);
-			printf("SIM 0x%08x (ipc = %08x, upc = %08x)\n", immv,
+			m_simcon.printf("SIM 0x%08x (ipc = %08x, upc = %08x)\n", immv,
 				m_core->cpu_ipc,
 				m_core->cpu_upc);
-		} fflush(stdout);
+		}
 	}
 #endif // INCLUDE_ZIPCPU
 #ifdef	SDSPI_ACCESS
@@ -11,7 +11,8 @@
 //
 //	This particular version differs from the memsim version within the
 //	ZipCPU project in that there is a variable delay from request to
-//	completion.
+//	completion, a sparse backing store, and configurable stall models.
+//	See memsim.h for details.
 //
 //
 // Creator:	Dan Gisselquist, Ph.D.
@@ -49,31 +50,52 @@
 #include <assert.h>
 #include "memsim.h"
 
+static	const	unsigned	PGWORDS = (1u << MEMSIM::LGPAGE);
+
 MEMSIM::MEMSIM(const unsigned int nwords, const unsigned int delay) {
 	unsigned int	nxt;
 	for(nxt=1; nxt < nwords; nxt<<=1)
 		;
 	m_len = nxt; m_mask = nxt-1;
-	m_mem = new BUSW[m_len];
 
-	m_delay = delay;
-	for(m_delay_mask=1; m_delay_mask < delay; m_delay_mask<<=1)
-		;
-	m_fifo_ack  = new int[m_delay_mask];
-	m_fifo_data = new BUSW[m_delay_mask];
-	for(unsigned i=0; i<m_delay_mask; i++)
-		m_fifo_ack[i] = 0;
-	m_delay_mask-=1;
-	m_head = 0; m_tail = (m_head - delay)&m_delay_mask;
+	m_npages = (m_len + PGWORDS - 1) >> LGPAGE;
+	m_pages = new BUSW *[m_npages];
+	for(unsigned i=0; i<m_npages; i++)
+		m_pages[i] = NULL;
+
+	m_qhead = m_qtail = 0;
+	m_now = m_last_ready = 0;
+	m_lfsr = 1;
+
+	latency(delay, 0);
+	stall_none();
+	clear_stats();
 }
 
 MEMSIM::~MEMSIM(void) {
-	delete[]	m_mem;
+	for(unsigned i=0; i<m_npages; i++)
+		delete[] m_pages[i];
+	delete[]	m_pages;
+}
+
+MEMSIM::BUSW	*MEMSIM::page(const BUSW addr) {
+	unsigned	pg = (addr & m_mask) >> LGPAGE;
+
+	if (NULL == m_pages[pg]) {
+		m_pages[pg] = new BUSW[PGWORDS];
+		memset(m_pages[pg], 0, PGWORDS * sizeof(BUSW));
+	} return m_pages[pg];
 }
 
 void	MEMSIM::load(const char *fname) {
 	FILE	*fp;
-	unsigned int	nr;
+	unsigned int	nr = 0, total = 0;
+	BUSW	*buf;
+
+	for(unsigned i=0; i<m_npages; i++) {
+		delete[] m_pages[i];
+		m_pages[i] = NULL;
+	}
 
 	fp = fopen(fname, "r");
 	if (!fp) {
@@ -81,30 +103,166 @@ void	MEMSIM::load(const char *fname) {
 			fname);
 		perror("O/S Err:");
 		fprintf(stderr, "\tInitializing memory with zero instead.\n");
-		nr = 0;
-	} else {
-		nr = fread(m_mem, sizeof(BUSW), m_len, fp);
-		fclose(fp);
+		return;
+	}
 
-		if (nr != m_len) {
-			fprintf(stderr, "Only read %d of %d words\n",
-				nr, m_len);
-			fprintf(stderr, "\tFilling the rest with zero.\n");
-		}
+	// Only pages with something other than zero in them need to be
+	// allocated
+	buf = new BUSW[PGWORDS];
+	for(unsigned addr=0; addr < m_len; addr += PGWORDS) {
+		unsigned ln = (m_len - addr < PGWORDS) ? m_len - addr : PGWORDS;
+		bool	zero = true;
+
+		nr = fread(buf, sizeof(BUSW), ln, fp);
+		total += nr;
+		for(unsigned k=0; (k<nr)&&(zero); k++)
+			if (buf[k])
+				zero = false;
+		if (!zero)
+			memcpy(page(addr), buf, nr * sizeof(BUSW));
+		if (nr < ln)
+			break;
 	}
 
-	for(; nr<m_len; nr++)
-		m_mem[nr] = 0l;
+	delete[] buf;
+	fclose(fp);
+
+	if (total != m_len) {
+		fprintf(stderr, "Only read %d of %d words\n",
+			total, m_len);
+		fprintf(stderr, "\tFilling the rest with zero.\n");
+	}
 }
 
 void	MEMSIM::load(const unsigned int addr, const char *buf, const size_t len) {
-	memcpy(&m_mem[addr], buf, len);
+	unsigned	waddr = addr;
+	size_t		left = len;
+
+	while(left > 0) {
+		unsigned	off = waddr & (PGWORDS-1);
+		size_t		ln = (PGWORDS - off) * sizeof(BUSW);
+
+		if (ln > left)
+			ln = left;
+		memcpy(&page(waddr)[off], buf, ln);
+		buf  += ln;
+		left -= ln;
+		waddr += ln / sizeof(BUSW);
+	}
+}
+
+void	MEMSIM::latency(const unsigned delay, const unsigned jitter) {
+	// An acknowledgment can come no sooner than the clock after the
+	// request
+	m_delay  = (delay > 0) ? delay : 1;
+	m_jitter = jitter;
+}
+
+void	MEMSIM::stall_none(void) {
+	m_stall_model = STALL_NONE;
+	m_stall_a = m_stall_b = m_stall_count = m_stall_left = 0;
+}
+
+void	MEMSIM::stall_bursty(const unsigned burst, const unsigned gap) {
+	stall_none();
+	if ((burst > 0)&&(gap > 0)) {
+		m_stall_model = STALL_BURSTY;
+		m_stall_a = burst;
+		m_stall_b = gap;
+	}
+}
+
+void	MEMSIM::stall_refresh(const unsigned period, const unsigned duration) {
+	stall_none();
+	if ((duration > 0)&&(period > duration)) {
+		m_stall_model = STALL_REFRESH;
+		m_stall_a = period;
+		m_stall_b = duration;
+	}
+}
+
+void	MEMSIM::stall_random(const unsigned percent, const uint32_t seed) {
+	stall_none();
+	if (percent > 0) {
+		m_stall_model = STALL_RANDOM;
+		m_stall_a = (percent < 100) ? percent : 100;
+		m_lfsr = (seed) ? seed : 1;
+	}
+}
+
+//
+// A simple (xorshift) pseudorandom number generator.  It only needs to be
+// repeatable from one run to the next, not good.
+//
+unsigned	MEMSIM::prng(void) {
+	m_lfsr ^= m_lfsr << 13;
+	m_lfsr ^= m_lfsr >> 17;
+	m_lfsr ^= m_lfsr << 5;
+	return m_lfsr;
+}
+
+//
+// stalled()
+//
+// Called once per clock, to step the stall model and return whether or not
+// the bus should be stalled on this clock.
+//
+bool	MEMSIM::stalled(void) {
+	switch(m_stall_model) {
+	case STALL_BURSTY:
+		// m_stall_count (the number of requests accepted in this
+		// burst) is advanced in apply()
+		if (m_stall_left > 0) {
+			m_stall_left--;
+			return true;
+		} return false;
+	case STALL_REFRESH:
+		if (++m_stall_count >= m_stall_a)
+			m_stall_count = 0;
+		return (m_stall_count < m_stall_b);
+	case STALL_RANDOM:
+		return ((prng() % 100) < m_stall_a);
+	default:
+		return false;
+	}
+}
+
+void	MEMSIM::clear_stats(void) {
+	m_clocks = m_busy = m_requests = m_reads = m_writes = 0;
+	m_stalls = m_acks = m_latency = m_max_latency = 0;
+	m_occupancy = m_aborts = 0;
+}
+
+void	MEMSIM::stats(FILE *fp) const {
+	double	clocks = (m_clocks > 0) ? (double)m_clocks : 1.0,
+		busy   = (m_busy > 0)   ? (double)m_busy   : 1.0,
+		acks   = (m_acks > 0)   ? (double)m_acks   : 1.0;
+	unsigned	npg = 0;
+
+	for(unsigned i=0; i<m_npages; i++)
+		if (m_pages[i])
+			npg++;
+
+	fprintf(fp, "MEMSIM: %lu clocks, bus busy for %lu (%.1f%%)\n",
+		m_clocks, m_busy, 100.0 * m_busy / clocks);
+	fprintf(fp, "\t%lu requests (%lu reads, %lu writes), %lu acks, %lu aborted\n",
+		m_requests, m_reads, m_writes, m_acks, m_aborts);
+	fprintf(fp, "\tRequests stalled for %lu clocks (%.1f%% of busy)\n",
+		m_stalls, 100.0 * m_stalls / busy);
+	fprintf(fp, "\tLatency: %.2f clocks average, %lu maximum\n",
+		m_latency / acks, m_max_latency);
+	fprintf(fp, "\tAverage requests outstanding: %.2f\n",
+		m_occupancy / clocks);
+	fprintf(fp, "\t%u of %u pages allocated (%lu kB)\n",
+		npg, m_npages,
+		(unsigned long)npg * PGWORDS * sizeof(BUSW) / 1024);
 }
 
 void	MEMSIM::apply(const uchar wb_cyc, const uchar wb_stb, const uchar wb_we,
 			const BUSW wb_addr, const BUSW wb_data, const uchar wb_sel,
 			unsigned char &o_ack, unsigned char &o_stall, BUSW &o_data) {
 	unsigned	sel = 0;
+	bool		stall;
 
 	if (wb_sel&0x8)
 		sel |= 0x0ff000000;
@@ -114,44 +272,96 @@ void	MEMSIM::apply(const uchar wb_cyc, const uchar wb_stb, const uchar wb_we,
 		sel |= 0x00000ff00;
 	if (wb_sel&0x1)
 		sel |= 0x0000000ff;
-	m_head++; m_tail = (m_head - m_delay)&m_delay_mask;
-	m_head&=m_delay_mask;
-	o_ack = m_fifo_ack[m_tail];
-	o_data= m_fifo_data[m_tail];
 
-	m_fifo_ack[ m_head] = 0;
-	m_fifo_data[m_head] = 0;
+	o_ack  = 0;
+	o_data = 0;
+
+	if (!wb_cyc) {
+		// Dropping CYC aborts any outstanding requests
+		m_aborts += (m_qhead - m_qtail) & (MAXQ-1);
+		m_qtail = m_qhead;
+		m_last_ready = m_now;
+	} else {
+		m_busy++;
+
+		// Return the oldest response, if it is ready
+		if ((m_qhead != m_qtail)&&(m_qready[m_qtail] <= m_now)) {
+			unsigned long	lat = m_now - m_qstart[m_qtail];
+
+			o_ack  = 1;
+			o_data = m_qdata[m_qtail];
+			m_acks++;
+			m_latency += lat;
+			if (lat > m_max_latency)
+				m_max_latency = lat;
+			m_qtail = (m_qtail + 1) & (MAXQ-1);
+		}
+	}
+
+	m_occupancy += (m_qhead - m_qtail) & (MAXQ-1);
+
+	// Step the stall model on every clock, whether or not there's a
+	// request to stall
+	stall = stalled();
+	if (((m_qhead + 1) & (MAXQ-1)) == m_qtail)
+		stall = true;
+	o_stall = (stall) ? 1 : 0;
 
-	o_stall= 0;
 	if ((wb_cyc)&&(wb_stb)) {
-		if (wb_we) {
-			if (sel == 0xffffffffu)
-				m_mem[wb_addr & m_mask] = wb_data;
-			else {
-				uint32_t memv = m_mem[wb_addr & m_mask];
-				memv &= ~sel;
-				memv |= (wb_data & sel);
-				m_mem[wb_addr & m_mask] = memv;
+		if (stall)
+			m_stalls++;
+		else {
+			BUSW		v;
+			unsigned long	ready;
+
+			// Only writes allocate pages.  Reads of memory that's
+			// never been written return zero, without allocating.
+			if (wb_we) {
+				BUSW	*ptr = &(*this)[wb_addr];
+
+				if (sel == 0xffffffffu)
+					*ptr = wb_data;
+				else
+					*ptr = (*ptr & ~sel) | (wb_data & sel);
+				v = *ptr;
+				m_writes++;
+			} else {
+				v = read(wb_addr);
+				m_reads++;
+			}
+			m_requests++;
+
+			ready = m_now + m_delay;
+			if (m_jitter > 0)
+				ready += prng() % (m_jitter + 1);
+			// Responses are returned in order, one per clock
+			if (ready <= m_last_ready)
+				ready = m_last_ready + 1;
+			m_last_ready = ready;
+
+			m_qready[m_qhead] = ready;
+			m_qstart[m_qhead] = m_now;
+			m_qdata[ m_qhead] = v;
+			m_qhead = (m_qhead + 1) & (MAXQ-1);
+
+			if ((m_stall_model == STALL_BURSTY)
+					&&(++m_stall_count >= m_stall_a)) {
+				m_stall_count = 0;
+				m_stall_left  = m_stall_b;
 			}
-		}
-		m_fifo_ack[m_head] = 1;
-		m_fifo_data[m_head] = m_mem[wb_addr & m_mask];
 #ifdef	DEBUG
-		printf("MEMBUS %s[%08x] = %08x\n",
-			(wb_we)?"W":"R",
-			wb_addr&m_mask,
-			m_mem[wb_addr&m_mask]);
+			printf("MEMBUS %s[%08x] = %08x\n",
+				(wb_we)?"W":"R",
+				wb_addr&m_mask, v);
 #endif
-		// o_ack  = 1;
+		}
 	}
 
 #ifdef	DEBUG
 	if (o_ack) {
-		printf("MEMBUS -- ACK %s 0x%08x - 0x%08x\n",
-			(wb_we)?"WRITE":"READ ",
-			wb_addr, o_data);
+		printf("MEMBUS -- ACK 0x%08x\n", o_data);
 	}
 #endif
+	m_clocks++;
+	m_now++;
 }
-
-
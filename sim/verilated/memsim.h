@@ -13,6 +13,26 @@
 //	ZipCPU project in that there is a variable delay from request to
 //	completion.
 //
+//	Memory is kept in a sparse page table, so that large address spaces
+//	(SDRAM, DDR) can be simulated without allocating host memory for
+//	them.  Pages are only allocated once written to, and unwritten memory
+//	reads as zero.
+//
+//	Timing is controlled by two models:
+//
+//	- A latency model.  Each request is acknowledged m_delay clocks after
+//	  it is accepted, plus a random 0..m_jitter clocks.  Acknowledgments
+//	  are always returned in order, and at most one per clock.
+//
+//	- A stall model.  The default never stalls.  A bursty model accepts
+//	  a burst of requests and then stalls for a gap, a refresh model
+//	  stalls for a fixed time once every refresh period, and a random
+//	  model stalls on a given fraction of clocks.  The bus also stalls
+//	  if there are too many requests outstanding.
+//
+//	Bus statistics are kept from construction, or from the last call to
+//	clear_stats(), and can be printed with stats().
+//
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -46,20 +66,61 @@
 #ifndef	MEMSIM_H
 #define	MEMSIM_H
 
+#include <stdio.h>
+#include <stdint.h>
+
 class	MEMSIM {
 public:	
 	typedef	unsigned int	BUSW;
 	typedef	unsigned char	uchar;
 
-	BUSW	*m_mem, m_len, m_mask, m_head, m_tail, m_delay_mask, m_delay;
-	int	*m_fifo_ack;
-	BUSW	*m_fifo_data;
-	
+	typedef	enum {
+		STALL_NONE, STALL_BURSTY, STALL_REFRESH, STALL_RANDOM
+	} STALL_MODEL;
+
+	// Each page is (1<<LGPAGE) words
+	static	const	unsigned	LGPAGE = 12;
+	// Maximum number of outstanding requests, must be a power of two
+	static	const	unsigned	MAXQ = 64;
+
+	BUSW	**m_pages, m_len, m_mask, m_npages;
+	unsigned	m_delay, m_jitter;
+
+	// Stall model parameters
+	STALL_MODEL	m_stall_model;
+	unsigned	m_stall_a, m_stall_b, m_stall_count, m_stall_left;
+	uint32_t	m_lfsr;
+
+	// In-order response queue
+	unsigned	m_qhead, m_qtail;
+	unsigned long	m_qready[MAXQ], m_qstart[MAXQ];
+	BUSW		m_qdata[MAXQ];
+	unsigned long	m_now, m_last_ready;
+
+	// Statistics
+	unsigned long	m_clocks, m_busy, m_requests, m_reads, m_writes,
+			m_stalls, m_acks, m_latency, m_max_latency,
+			m_occupancy, m_aborts;
 
 	MEMSIM(const unsigned int nwords, const unsigned int delay=27);
 	~MEMSIM(void);
 	void	load(const char *fname);
 	void	load(const unsigned int addr, const char *buf,const size_t len);
+
+	// Latency: every request takes delay clocks, plus a random 0..jitter
+	void	latency(const unsigned delay, const unsigned jitter = 0);
+	// Stall models
+	void	stall_none(void);
+	// Accept burst requests, then stall for gap clocks
+	void	stall_bursty(const unsigned burst, const unsigned gap);
+	// Stall for duration clocks out of every period clocks
+	void	stall_refresh(const unsigned period, const unsigned duration);
+	// Stall on (roughly) percent of all clocks
+	void	stall_random(const unsigned percent, const uint32_t seed = 1);
+
+	void	clear_stats(void);
+	void	stats(FILE *fp) const;
+
 	void	apply(const uchar wb_cyc, const uchar wb_stb,
 				const uchar wb_we,
 			const BUSW wb_addr, const BUSW wb_data,
@@ -72,7 +133,19 @@ public:
 			uchar &o_ack, uchar &o_stall, BUSW &o_data) {
 		apply(wb_cyc, wb_stb, wb_we, wb_addr, wb_data, wb_sel, o_ack, o_stall, o_data);
 	}
-	BUSW &operator[](const BUSW addr) { return m_mem[addr&m_mask]; }
+
+	// Read a word without allocating anything
+	BUSW	read(const BUSW addr) const {
+		const BUSW *pg = m_pages[(addr & m_mask) >> LGPAGE];
+		return (pg) ? pg[addr & ((1u<<LGPAGE)-1)] : 0;
+	}
+
+	BUSW &operator[](const BUSW addr) {
+		return page(addr)[addr & ((1u<<LGPAGE)-1)]; }
+private:
+	BUSW	*page(const BUSW addr);
+	bool	stalled(void);
+	unsigned	prng(void);
 };
 
 #endif
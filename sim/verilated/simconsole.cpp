@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	simconsole.cpp
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Buffers the console output the simulated ZipCPU produces via its
+//		SIM instructions.  See simconsole.h for details.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "simconsole.h"
+
+SIMCONSOLE::SIMCONSOLE(void) {
+	m_len = 0;
+	m_ticks = 0;
+	m_fp = stdout;
+	m_last_ns = now_ns();
+}
+
+SIMCONSOLE::~SIMCONSOLE(void) {
+	flush();
+	if (m_fp != stdout)
+		fclose(m_fp);
+}
+
+uint64_t	SIMCONSOLE::now_ns(void) const {
+	struct	timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+bool	SIMCONSOLE::log(const char *fname) {
+	FILE	*fp;
+
+	if (NULL == (fp = fopen(fname, "w"))) {
+		fprintf(stderr, "ERR: Cannot open console log file, %s\n",
+			fname);
+		perror("O/S Err:");
+		return false;
+	}
+
+	flush();
+	if (m_fp != stdout)
+		fclose(m_fp);
+	m_fp = fp;
+	return true;
+}
+
+void	SIMCONSOLE::printf(const char *fmt, ...) {
+	va_list	args;
+	int	ln;
+
+	va_start(args, fmt);
+	ln = vsnprintf(&m_buf[m_len], BUFLEN - m_len, fmt, args);
+	va_end(args);
+
+	if ((ln >= 0)&&(m_len + ln >= BUFLEN)) {
+		// Didn't fit.  Flush what we had, and try again--writing
+		// directly if it still won't fit.
+		flush();
+		va_start(args, fmt);
+		if (vsnprintf(m_buf, BUFLEN, fmt, args) >= (int)BUFLEN) {
+			va_end(args);
+			va_start(args, fmt);
+			vfprintf(m_fp, fmt, args);
+			fflush(m_fp);
+			ln = 0;
+		}
+		va_end(args);
+	}
+
+	if (ln > 0) {
+		m_len += ln;
+		if (memchr(&m_buf[m_len-ln], '\n', ln))
+			flush();
+	}
+}
+
+void	SIMCONSOLE::flush(void) {
+	m_last_ns = now_ns();
+	m_ticks = 0;
+	if (m_len == 0)
+		return;
+
+	fwrite(m_buf, 1, m_len, m_fp);
+	fflush(m_fp);
+	m_len = 0;
+}
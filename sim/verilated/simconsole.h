@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	simconsole.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Buffers the console output the simulated ZipCPU produces via its
+//		SIM instructions (SOUT, NSTR, register dumps, etc).  Writing
+//	one character at a time, and flushing after each, turns chatty test
+//	programs into a stream of system calls.  Instead, characters are
+//	collected here and written out at the end of every line, whenever
+//	the buffer fills, or--so that prompts and partial lines still show
+//	up--once a partial line has been waiting a while.  Output may also
+//	be sent to a log file rather than to stdout.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	SIMCONSOLE_H
+#define	SIMCONSOLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+class	SIMCONSOLE {
+	static	const	unsigned	BUFLEN = 4096;
+	// How often tick() looks at the clock, in ticks, and how long a
+	// partial line may wait before being flushed, in nanoseconds
+	static	const	unsigned	TICK_CHECK = 4096;
+	static	const	uint64_t	MAXWAIT_NS = 50000000ul;
+
+	char		m_buf[BUFLEN];
+	unsigned	m_len, m_ticks;
+	uint64_t	m_last_ns;
+	FILE		*m_fp;
+
+	uint64_t	now_ns(void) const;
+public:
+	SIMCONSOLE(void);
+	~SIMCONSOLE(void);
+
+	// Send all output to the given file, rather than stdout
+	bool	log(const char *fname);
+
+	void	putch(const int ch) {
+		m_buf[m_len++] = (char)ch;
+		if ((ch == '\n')||(m_len >= BUFLEN))
+			flush();
+	}
+
+	void	printf(const char *fmt, ...)
+			__attribute__((format(printf, 2, 3)));
+
+	void	flush(void);
+
+	// Called once per simulation clock, to flush any partial line that
+	// has been waiting too long
+	void	tick(void) {
+		if ((m_len > 0)&&(++m_ticks >= TICK_CHECK)) {
+			m_ticks = 0;
+			if (now_ns() - m_last_ns >= MAXWAIT_NS)
+				flush();
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	divbench.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Compares the 64-bit divide in zlib's udiv.c against the
+//		bit-serial divide it replaced, counting clocks and instructions
+//	with the ZipSystem's accounting counters.  Each operand class is run
+//	through both, and the results are checked against each other.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdint.h>
+#include "board.h"
+#include "zipsys.h"
+
+#ifndef	_HAVE_ZIPSYS_PERFORMANCE_COUNTERS
+#error "divbench requires the ZipSystem accounting counters"
+#endif
+
+#define	NOPS	256
+
+extern	int	cltz(unsigned long);
+extern	unsigned long	__udivdi3(unsigned long, unsigned long);
+
+//
+// The original bit-serial divide, kept here for comparison
+//
+__attribute__((noinline))
+static unsigned long
+serial_udivdi3(unsigned long a, unsigned long b) {
+	unsigned long	r, m;
+
+	if (a < b)
+		return 0;
+	if (((b>>32)==0)&&((a>>32)==0))
+		return (uint32_t)a / (uint32_t)b;
+
+	int	la = cltz(a), lb = cltz(b);
+	a <<= la;
+	if ((lb - la < 32)&&(((b<<la)&0x0ffffffff)==0)) {
+		b <<= la;
+		return (uint32_t)(a>>32) / (uint32_t)(b>>32);
+	}
+
+	r = 0;
+	b <<= lb;
+	m = (1ul<<(lb-la));
+	while(m > 0) {
+		if (a >= b) {
+			r |= m;
+			a -= b;
+		}
+		m>>= 1;
+		b >>= 1;
+	} return r;
+}
+
+typedef	unsigned long (*DIVFN)(unsigned long, unsigned long);
+
+static	unsigned long	num[NOPS], den[NOPS], quo[NOPS];
+
+static	uint32_t	seed = 0x2468ace1;
+
+static uint32_t
+prng(void) {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed <<  5;
+	return seed;
+}
+
+// A random value of exactly nbits bits
+static unsigned long
+randbits(int nbits) {
+	unsigned long	v = ((unsigned long)prng() << 32) | prng();
+
+	if (nbits < 64)
+		v &= (1ul << nbits) - 1;
+	return v | (1ul << (nbits-1));
+}
+
+static void
+run(DIVFN fn, unsigned *clocks, unsigned *insns) {
+	unsigned	ck, ic;
+
+	ck = _zip->z_m.ac_ck;
+	ic = _zip->z_m.ac_icnt;
+	for(int k=0; k<NOPS; k++)
+		quo[k] = fn(num[k], den[k]);
+	*clocks = _zip->z_m.ac_ck   - ck;
+	*insns  = _zip->z_m.ac_icnt - ic;
+}
+
+static int
+bench(const char *name, int nbits, int dbits) {
+	unsigned	nck, nic, sck, sic;
+	unsigned long	expected[NOPS];
+	int		fail = 0;
+
+	for(int k=0; k<NOPS; k++) {
+		num[k] = randbits(nbits);
+		den[k] = randbits(dbits);
+	}
+
+	run(serial_udivdi3, &sck, &sic);
+	for(int k=0; k<NOPS; k++)
+		expected[k] = quo[k];
+	run(__udivdi3, &nck, &nic);
+	for(int k=0; k<NOPS; k++)
+		if (quo[k] != expected[k])
+			fail = 1;
+
+	printf("%-12s %8d %8d %8d %8d%s\n", name,
+		sck / NOPS, sic / NOPS, nck / NOPS, nic / NOPS,
+		(fail) ? "  MISMATCH" : "");
+	return fail;
+}
+
+int main(int argc, char **argv) {
+	int	fail = 0;
+
+	printf("Clocks and instructions per 64-bit divide, averaged over %d\n\n",
+		NOPS);
+	printf("%-12s %8s %8s %8s %8s\n", "", "Serial", "", "New", "");
+	printf("%-12s %8s %8s %8s %8s\n", "Operands", "Clocks", "Insns",
+		"Clocks", "Insns");
+
+	fail |= bench("32 / 16",  32, 16);
+	fail |= bench("32 / 32",  32, 32);
+	fail |= bench("48 / 20",  48, 20);
+	fail |= bench("64 / 16",  64, 16);
+	fail |= bench("64 / 32",  64, 32);
+	fail |= bench("64 / 40",  64, 40);
+	fail |= bench("64 / 63",  64, 63);
+
+	if (fail)
+		printf("\nERR: Quotients differ\n");
+	return fail;
+}
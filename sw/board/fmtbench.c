@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	fmtbench.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Compares zlib's zsnprintf() and zprintf() against newlib's
+//		snprintf() and printf(), counting clocks and instructions
+//	with the ZipSystem's accounting counters.  The buffered results of the
+//	two are checked against each other.  The console comparison is bounded
+//	by the UART, so only a few short lines are sent each time--few enough
+//	to fit in the console's transmit ring.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "board.h"
+#include "zipsys.h"
+#include "console.h"
+#include "zfmt.h"
+
+#ifndef	_HAVE_ZIPSYS_PERFORMANCE_COUNTERS
+#error "fmtbench requires the ZipSystem accounting counters"
+#endif
+
+#define	NOPS		64
+#define	NLINES		8
+#define	FMTBUFSZ	48
+
+static	int	vals[NOPS];
+static	const char	*names[8] = { "zero", "one", "two", "three", "four",
+				"five", "six", "seven" };
+static	char	expected[NOPS][FMTBUFSZ], actual[NOPS][FMTBUFSZ];
+
+typedef	int	(*FMTFN)(char *, unsigned);
+
+// Each test, once for newlib and once for zfmt
+#define	FMTTEST(NAME, FMT, ...)						\
+static int NAME##_newlib(char *b, unsigned k) {				\
+	return snprintf(b, FMTBUFSZ, FMT, __VA_ARGS__); }		\
+static int NAME##_zfmt(char *b, unsigned k) {				\
+	return zsnprintf(b, FMTBUFSZ, FMT, __VA_ARGS__); }
+
+FMTTEST(dec,	"%d",			vals[k])
+FMTTEST(neg,	"%d",			-vals[k])
+FMTTEST(wide,	"%10u|%-10d|",		vals[k], vals[k])
+FMTTEST(hex,	"0x%08x",		vals[k])
+FMTTEST(str,	"%-8s%c",		names[k&7], 'a' + (k&15))
+FMTTEST(mixed,	"%5d: %08X %s",		k, vals[k], names[k&7])
+
+static	uint32_t	seed = 0x13572468;
+
+static uint32_t
+prng(void) {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed <<  5;
+	return seed;
+}
+
+static void
+run(FMTFN fn, char out[][FMTBUFSZ], unsigned *clocks, unsigned *insns) {
+	unsigned	ck, ic;
+
+	ck = _zip->z_m.ac_ck;
+	ic = _zip->z_m.ac_icnt;
+	for(int k=0; k<NOPS; k++)
+		fn(out[k], k);
+	*clocks = _zip->z_m.ac_ck   - ck;
+	*insns  = _zip->z_m.ac_icnt - ic;
+}
+
+static int
+bench(const char *name, FMTFN newlib, FMTFN zfmt) {
+	unsigned	nck, nic, zck, zic;
+	int		fail = 0;
+
+	run(newlib, expected, &nck, &nic);
+	run(zfmt,   actual,   &zck, &zic);
+	for(int k=0; k<NOPS; k++)
+		if (strcmp(expected[k], actual[k]) != 0)
+			fail = 1;
+
+	printf("%-12s %8d %8d %8d %8d%s\n", name,
+		nck / NOPS, nic / NOPS, zck / NOPS, zic / NOPS,
+		(fail) ? "  MISMATCH" : "");
+	return fail;
+}
+
+//
+// The console: the same few lines, each way.  The ring is emptied first, so
+// neither has to wait on the UART for room.
+//
+static void
+console(void) {
+	unsigned	ck, ic, nck, nic, zck, zic;
+
+	fflush(stdout);
+	_console_flush();
+	ck = _zip->z_m.ac_ck;
+	ic = _zip->z_m.ac_icnt;
+	for(int k=0; k<NLINES; k++)
+		printf("%5d: %08x\n", k, vals[k]);
+	fflush(stdout);
+	nck = _zip->z_m.ac_ck   - ck;
+	nic = _zip->z_m.ac_icnt - ic;
+
+	_console_flush();
+	ck = _zip->z_m.ac_ck;
+	ic = _zip->z_m.ac_icnt;
+	for(int k=0; k<NLINES; k++)
+		zprintf("%5d: %08x\n", k, vals[k]);
+	zck = _zip->z_m.ac_ck   - ck;
+	zic = _zip->z_m.ac_icnt - ic;
+	_console_flush();
+
+	printf("%-12s %8d %8d %8d %8d\n", "console",
+		nck / NLINES, nic / NLINES, zck / NLINES, zic / NLINES);
+}
+
+int main(int argc, char **argv) {
+	int	fail = 0;
+
+	// A spread of magnitudes, from one digit to ten
+	for(int k=0; k<NOPS; k++)
+		vals[k] = prng() >> (k & 31);
+
+	printf("Clocks and instructions per call, averaged over %d\n\n",
+		NOPS);
+	printf("%-12s %8s %8s %8s %8s\n", "", "Newlib", "", "zfmt", "");
+	printf("%-12s %8s %8s %8s %8s\n", "Format", "Clocks", "Insns",
+		"Clocks", "Insns");
+
+	fail |= bench("%d",	dec_newlib,	dec_zfmt);
+	fail |= bench("%d (neg)",	neg_newlib,	neg_zfmt);
+	fail |= bench("%10u|%-10d",	wide_newlib,	wide_zfmt);
+	fail |= bench("0x%08x",	hex_newlib,	hex_zfmt);
+	fail |= bench("%-8s%c",	str_newlib,	str_zfmt);
+	fail |= bench("%5d: %08X",	mixed_newlib,	mixed_zfmt);
+
+	printf("\n");
+	console();
+
+	if (fail)
+		printf("\nERR: Formatted results differ\n");
+	return fail;
+}
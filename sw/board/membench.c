@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	membench.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Measures the time memcpy() and memset() take, using first the
+//		CPU and then the DMA, across a range of transfer sizes, in
+//	order to find the point above which handing the transfer to the DMA
+//	pays off.  Copies are measured from both block RAM and flash sources,
+//	since the two differ greatly in their access times.
+//
+//	The results may be used to set ZIPMEM_DMA_THRESHOLD when building
+//	the library, or zipmem_dma_threshold at run time.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "board.h"
+#include "zipsys.h"
+#include "zipmem.h"
+
+#ifdef	_HAVE_ZIPSYS_PERFORMANCE_COUNTERS
+#define	COUNTER		_zip->z_m.ac_ck
+#elif	defined(PWRCOUNT_ACCESS)
+#define	COUNTER		*_pwrcount
+#else
+#error "membench needs a clock counter"
+#endif
+
+#define	MINSZ	16
+#define	MAXSZ	8192
+#define	NSIZES	10	// 16 ... 8192
+#define	NREPS	4
+
+static	uint32_t	srcbuf[MAXSZ/4], dstbuf[MAXSZ/4];
+
+typedef	struct	{
+	unsigned	b_cpu[NSIZES], b_dma[NSIZES];
+} BENCH;
+
+//
+// Time a single transfer of n bytes, taking the best of NREPS tries.  A NULL
+// source times memset() instead of memcpy().
+//
+static unsigned
+timeit(const char *src, unsigned n, unsigned threshold) {
+	unsigned	best = -1;
+
+	zipmem_dma_threshold = threshold;
+	for(int k=0; k<NREPS; k++) {
+		unsigned	start, stop;
+
+		start = COUNTER;
+		if (src)
+			memcpy(dstbuf, src, n);
+		else
+			memset(dstbuf, 0x5a, n);
+		stop = COUNTER;
+
+		if (stop - start < best)
+			best = stop - start;
+	}
+
+	return best;
+}
+
+static int
+measure(const char *name, const char *src, BENCH *b) {
+	unsigned	n, k, dma_count;
+	int		fail = 0;
+
+	printf("\n%s\n%6s %8s %8s\n", name, "Bytes", "CPU", "DMA");
+	for(n=MINSZ, k=0; n<=MAXSZ; n<<=1, k++) {
+		b->b_cpu[k] = timeit(src, n, -1);
+		if (src && memcmp(dstbuf, src, n) != 0)
+			fail = 1;
+
+		dma_count = zipmem_dma_count;
+		b->b_dma[k] = timeit(src, n, 0);
+		if (src && memcmp(dstbuf, src, n) != 0)
+			fail = 1;
+		if (dma_count == zipmem_dma_count) {
+			printf("No DMA available\n");
+			return 1;
+		}
+
+		printf("%6d %8d %8d\n", n, b->b_cpu[k], b->b_dma[k]);
+	}
+
+	if (fail)
+		printf("ERR: %s copy mismatch\n", name);
+	return fail;
+}
+
+//
+// Returns the smallest size from which the DMA is faster for every size
+// measured, or zero if the CPU was never beaten
+//
+static unsigned
+crossover(const BENCH *b) {
+	int	k = NSIZES-1;
+
+	if (b->b_dma[k] >= b->b_cpu[k])
+		return 0;
+	while((k > 0)&&(b->b_dma[k-1] < b->b_cpu[k-1]))
+		k--;
+	return MINSZ << k;
+}
+
+static void
+report(const char *name, const BENCH *b) {
+	unsigned	x = crossover(b);
+
+	if (x)
+		printf("%-14s: use the DMA from %d bytes\n", name, x);
+	else
+		printf("%-14s: the CPU is always faster\n", name);
+}
+
+int main(int argc, char **argv) {
+	BENCH		bkram, flash, fill;
+	unsigned	saved = zipmem_dma_threshold;
+	int		fail = 0;
+
+	for(unsigned k=0; k<MAXSZ/4; k++)
+		srcbuf[k] = k * 0x01010101u + 0x12345678u;
+
+	fail |= measure("memcpy, BKRAM source", (const char *)srcbuf, &bkram);
+#ifdef	_BOARD_HAS_FLASH
+	fail |= measure("memcpy, flash source", (const char *)_flash, &flash);
+#endif
+	fail |= measure("memset", NULL, &fill);
+	zipmem_dma_threshold = saved;
+
+	printf("\nCrossover points (clocks, best of %d)\n", NREPS);
+	report("BKRAM memcpy", &bkram);
+#ifdef	_BOARD_HAS_FLASH
+	report("Flash memcpy", &flash);
+#endif
+	report("memset", &fill);
+	printf("Current threshold: %d bytes\n", saved);
+
+	return (fail) ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	sdbench.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Measures the sustained read and write bandwidth of the SD card,
+//		through zlib's sdcard driver, across a range of transfer
+//	sizes.  Each size moves the same total amount of data.
+//
+//	The write test is not destructive.  The scratch area is read and
+//	saved first, then written and verified, and finally restored.  Don't
+//	pull the power in the middle of it.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "board.h"
+#include "zipsys.h"
+#include "sdcard.h"
+
+#ifdef	_HAVE_ZIPSYS_PERFORMANCE_COUNTERS
+#define	COUNTER		_zip->z_m.ac_ck
+#elif	defined(PWRCOUNT_ACCESS)
+#define	COUNTER		*_pwrcount
+#else
+#error "sdbench needs a clock counter"
+#endif
+
+// The blocks used for testing, and how many of them.  Every transfer size
+// moves all SDBENCH_NBLKS of them.
+#ifndef	SDBENCH_FIRST
+#define	SDBENCH_FIRST	0x08000		// 16MB into the card
+#endif
+#define	SDBENCH_NBLKS	64
+#define	SDBENCH_WORDS	(SDBENCH_NBLKS * SDCARD_BLKSZ / 4)
+
+static	uint32_t	saved[SDBENCH_WORDS], buf[SDBENCH_WORDS];
+
+// kB/s, given bytes moved in ck clocks
+static unsigned
+kbps(unsigned bytes, unsigned ck) {
+	if (ck == 0)
+		return 0;
+	return (unsigned)((unsigned long)bytes * CLKFREQHZ / 1024 / ck);
+}
+
+static void
+fill(uint32_t *b, unsigned seed) {
+	for(unsigned k=0; k<SDBENCH_WORDS; k++)
+		b[k] = seed + k * 0x01010101u;
+}
+
+static int
+check(const uint32_t *b, unsigned seed) {
+	for(unsigned k=0; k<SDBENCH_WORDS; k++)
+		if (b[k] != seed + k * 0x01010101u)
+			return 1;
+	return 0;
+}
+
+int main(int argc, char **argv) {
+#ifdef	_BOARD_HAS_SDSPI
+	unsigned	start, rd, wr;
+	int		err, fail = 0;
+
+	printf("SD card bandwidth\n");
+	if ((err = sdcard_init()) != 0) {
+		printf("ERR: sdcard_init() failed, %d (ctrl = %08x)\n", err,
+			sdcard_info.s_lastrsp);
+		return 1;
+	}
+	printf("OCR = 0x%08x, %s capacity\n\n", sdcard_info.s_ocr,
+		(sdcard_info.s_hc) ? "high" : "standard");
+
+	// Save what's there, so we may put it back
+	if (sdcard_read(SDBENCH_FIRST, SDBENCH_NBLKS, saved) != 0) {
+		printf("ERR: Could not read the scratch area\n");
+		return 1;
+	}
+
+	printf("%6s %10s %10s\n", "Blocks", "Read kB/s", "Write kB/s");
+	for(unsigned n=1; n<=SDBENCH_NBLKS; n<<=1) {
+		fill(buf, n);
+
+		start = COUNTER;
+		for(unsigned k=0; (k<SDBENCH_NBLKS)&&(!fail); k+=n)
+			if (sdcard_write(SDBENCH_FIRST+k, n,
+					&buf[k*SDCARD_BLKSZ/4]) != 0)
+				fail = 1;
+		wr = COUNTER - start;
+
+		memset(buf, 0, sizeof(buf));
+		start = COUNTER;
+		for(unsigned k=0; (k<SDBENCH_NBLKS)&&(!fail); k+=n)
+			if (sdcard_read(SDBENCH_FIRST+k, n,
+					&buf[k*SDCARD_BLKSZ/4]) != 0)
+				fail = 1;
+		rd = COUNTER - start;
+
+		if (fail) {
+			printf("ERR: Transfer failed, ctrl = %08x\n",
+				sdcard_info.s_lastrsp);
+			break;
+		}
+
+		if (check(buf, n)) {
+			printf("ERR: Read back mismatch, %d block transfers\n", n);
+			fail = 1;
+			break;
+		}
+
+		printf("%6d %10d %10d\n", n, kbps(sizeof(buf), rd),
+			kbps(sizeof(buf), wr));
+	}
+
+	if (sdcard_write(SDBENCH_FIRST, SDBENCH_NBLKS, saved) != 0) {
+		printf("ERR: Could not restore the scratch area\n");
+		fail = 1;
+	}
+
+	printf("\n%d commands, %d errors\n", sdcard_info.s_cmds,
+		sdcard_info.s_errs);
+	return fail;
+#else
+	printf("This design has no SD card\n");
+	return 1;
+#endif
+}
@@ -0,0 +1,403 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zbdhry.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Dhrystone 2.2, from dhrystone/dry.c, reworked into a zbench
+//		kernel.  zb_dhrystone(n) makes n passes through the Dhrystone
+//	loop and then checks the final values of the benchmark's variables,
+//	returning zero if they are as they should be.  Timing and reporting
+//	are left to zbench.
+//
+//	As with dry.c, this file is compiled twice--once as is, and once with
+//	-DPASS2--so that the compiler can't inline the procedures in the
+//	second half into the first.  The two records are statically allocated
+//	rather than malloc()'d, so that the kernel may be run more than once.
+//
+//	Dhrystone itself was written by Reinhold P. Weicker, and merged into
+//	a single file by Steven Pemberton.  See dhrystone/dry.c for the
+//	original, and its full history.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <string.h>
+#include "zbench.h"
+
+typedef	enum	{Ident_1, Ident_2, Ident_3, Ident_4, Ident_5} Enumeration;
+
+#define Null	0
+#define true	1
+#define false	0
+
+typedef int	One_Thirty;
+typedef int	One_Fifty;
+typedef char	Capital_Letter;
+typedef int	Boolean;
+typedef char	Str_30 [31];
+typedef int	Arr_1_Dim [50];
+typedef int	Arr_2_Dim [50] [50];
+
+typedef struct record {
+	struct record	*Ptr_Comp;
+	Enumeration	Discr;
+	union {
+		struct {
+			Enumeration	Enum_Comp;
+			int		Int_Comp;
+			char		Str_Comp [31];
+		} var_1;
+		struct {
+			Enumeration	E_Comp_2;
+			char		Str_2_Comp [31];
+		} var_2;
+		struct {
+			char		Ch_1_Comp;
+			char		Ch_2_Comp;
+		} var_3;
+	} variant;
+} Rec_Type, *Rec_Pointer;
+
+Enumeration	Func_1(Capital_Letter, Capital_Letter);
+Boolean		Func_2(Str_30, Str_30);
+Boolean		Func_3(Enumeration);
+void	Proc_1(Rec_Pointer);
+void	Proc_2(One_Fifty *);
+void	Proc_3(Rec_Pointer *);
+void	Proc_4(void);
+void	Proc_5(void);
+void	Proc_6(Enumeration, Enumeration *);
+void	Proc_7(One_Fifty, One_Fifty, One_Fifty *);
+void	Proc_8(Arr_1_Dim, Arr_2_Dim, int, int);
+
+#ifndef	PASS2
+
+Rec_Pointer	Ptr_Glob, Next_Ptr_Glob;
+int		Int_Glob;
+Boolean		Bool_Glob;
+char		Ch_1_Glob, Ch_2_Glob;
+int		Arr_1_Glob [50];
+int		Arr_2_Glob [50] [50];
+
+static	Rec_Type	Glob_Rec, Next_Glob_Rec;
+
+int
+zb_dhrystone(int Number_Of_Runs) {
+	One_Fifty	Int_1_Loc = 0, Int_2_Loc = 0, Int_3_Loc = 0;
+	char		Ch_Index;
+	Enumeration	Enum_Loc = Ident_1;
+	Str_30		Str_1_Loc, Str_2_Loc;
+	int		Run_Index, fail = 0;
+
+	// Initializations
+	Next_Ptr_Glob = &Next_Glob_Rec;
+	Ptr_Glob = &Glob_Rec;
+
+	Ptr_Glob->Ptr_Comp                = Next_Ptr_Glob;
+	Ptr_Glob->Discr                   = Ident_1;
+	Ptr_Glob->variant.var_1.Enum_Comp = Ident_3;
+	Ptr_Glob->variant.var_1.Int_Comp  = 40;
+	strcpy(Ptr_Glob->variant.var_1.Str_Comp,
+		"DHRYSTONE PROGRAM, SOME STRING");
+	strcpy(Str_1_Loc, "DHRYSTONE PROGRAM, 1'ST STRING");
+
+	Arr_2_Glob [8][7] = 10;
+
+	for (Run_Index = 1; Run_Index <= Number_Of_Runs; ++Run_Index) {
+		Proc_5();
+		Proc_4();
+		// Ch_1_Glob == 'A', Ch_2_Glob == 'B', Bool_Glob == true
+		Int_1_Loc = 2;
+		Int_2_Loc = 3;
+		strcpy(Str_2_Loc, "DHRYSTONE PROGRAM, 2'ND STRING");
+		Enum_Loc = Ident_2;
+		Bool_Glob = ! Func_2(Str_1_Loc, Str_2_Loc);
+		// Bool_Glob == 1
+		while (Int_1_Loc < Int_2_Loc) { // loop body executed once
+			Int_3_Loc = 5 * Int_1_Loc - Int_2_Loc;
+			// Int_3_Loc == 7
+			Proc_7(Int_1_Loc, Int_2_Loc, &Int_3_Loc);
+			// Int_3_Loc == 7
+			Int_1_Loc += 1;
+		}
+		// Int_1_Loc == 3, Int_2_Loc == 3, Int_3_Loc == 7
+		Proc_8(Arr_1_Glob, Arr_2_Glob, Int_1_Loc, Int_3_Loc);
+		// Int_Glob == 5
+		Proc_1(Ptr_Glob);
+		for (Ch_Index = 'A'; Ch_Index <= Ch_2_Glob; ++Ch_Index) {
+			// loop body executed twice
+			if (Enum_Loc == Func_1(Ch_Index, 'C')) {
+				// then, not executed
+				Proc_6(Ident_1, &Enum_Loc);
+				strcpy(Str_2_Loc, "DHRYSTONE PROGRAM, 3'RD STRING");
+				Int_2_Loc = Run_Index;
+				Int_Glob = Run_Index;
+			}
+		}
+		// Int_1_Loc == 3, Int_2_Loc == 3, Int_3_Loc == 7
+		Int_2_Loc = Int_2_Loc * Int_1_Loc;
+		Int_1_Loc = Int_2_Loc / Int_3_Loc;
+		Int_2_Loc = 7 * (Int_2_Loc - Int_3_Loc) - Int_1_Loc;
+		// Int_1_Loc == 1, Int_2_Loc == 13, Int_3_Loc == 7
+		Proc_2(&Int_1_Loc);
+		// Int_1_Loc == 5
+	}
+
+	// Check the final values, as dry.c prints them
+	if (Int_Glob != 5)		fail |= 0x0001;
+	if (Bool_Glob != 1)		fail |= 0x0002;
+	if (Ch_1_Glob != 'A')		fail |= 0x0004;
+	if (Ch_2_Glob != 'B')		fail |= 0x0008;
+	if (Arr_1_Glob[8] != 7)		fail |= 0x0010;
+	if (Arr_2_Glob[8][7] != Number_Of_Runs + 10)
+		fail |= 0x0020;
+	if ((Ptr_Glob->Discr != 0)
+		||(Ptr_Glob->variant.var_1.Enum_Comp != 2)
+		||(Ptr_Glob->variant.var_1.Int_Comp != 17)
+		||(strcmp(Ptr_Glob->variant.var_1.Str_Comp,
+			"DHRYSTONE PROGRAM, SOME STRING") != 0))
+		fail |= 0x0040;
+	if ((Next_Ptr_Glob->Ptr_Comp != Ptr_Glob->Ptr_Comp)
+		||(Next_Ptr_Glob->Discr != 0)
+		||(Next_Ptr_Glob->variant.var_1.Enum_Comp != 1)
+		||(Next_Ptr_Glob->variant.var_1.Int_Comp != 18)
+		||(strcmp(Next_Ptr_Glob->variant.var_1.Str_Comp,
+			"DHRYSTONE PROGRAM, SOME STRING") != 0))
+		fail |= 0x0080;
+	if (Int_1_Loc != 5)		fail |= 0x0100;
+	if (Int_2_Loc != 13)		fail |= 0x0200;
+	if (Int_3_Loc != 7)		fail |= 0x0400;
+	if (Enum_Loc != 1)		fail |= 0x0800;
+	if (strcmp(Str_1_Loc, "DHRYSTONE PROGRAM, 1'ST STRING") != 0)
+		fail |= 0x1000;
+	if (strcmp(Str_2_Loc, "DHRYSTONE PROGRAM, 2'ND STRING") != 0)
+		fail |= 0x2000;
+
+	return fail;
+}
+
+void
+Proc_1(Rec_Pointer Ptr_Val_Par) {	// executed once
+	Rec_Pointer	Next_Record = Ptr_Val_Par->Ptr_Comp;
+						// == Ptr_Glob_Next
+
+	*Ptr_Val_Par->Ptr_Comp = *Ptr_Glob;
+	Ptr_Val_Par->variant.var_1.Int_Comp = 5;
+	Next_Record->variant.var_1.Int_Comp
+		= Ptr_Val_Par->variant.var_1.Int_Comp;
+	Next_Record->Ptr_Comp = Ptr_Val_Par->Ptr_Comp;
+	Proc_3(&Next_Record->Ptr_Comp);
+	// Ptr_Val_Par->Ptr_Comp->Ptr_Comp == Ptr_Glob->Ptr_Comp
+	if (Next_Record->Discr == Ident_1) {
+		// then, executed
+		Next_Record->variant.var_1.Int_Comp = 6;
+		Proc_6(Ptr_Val_Par->variant.var_1.Enum_Comp,
+			&Next_Record->variant.var_1.Enum_Comp);
+		Next_Record->Ptr_Comp = Ptr_Glob->Ptr_Comp;
+		Proc_7(Next_Record->variant.var_1.Int_Comp, 10,
+			&Next_Record->variant.var_1.Int_Comp);
+	} else // not executed
+		*Ptr_Val_Par = *Ptr_Val_Par->Ptr_Comp;
+}
+
+void
+Proc_2(One_Fifty *Int_Par_Ref) {
+	// executed once, *Int_Par_Ref == 1, becomes 4
+	One_Fifty	Int_Loc;
+	Enumeration	Enum_Loc;
+
+	Int_Loc = *Int_Par_Ref + 10;
+	do // executed once
+		if (Ch_1_Glob == 'A') {
+			// then, executed
+			Int_Loc -= 1;
+			*Int_Par_Ref = Int_Loc - Int_Glob;
+			Enum_Loc = Ident_1;
+		}
+	while (Enum_Loc != Ident_1); // true
+}
+
+void
+Proc_3(Rec_Pointer *Ptr_Ref_Par) {
+	// executed once, Ptr_Ref_Par becomes Ptr_Glob
+	if (Ptr_Glob != Null)
+		// then, executed
+		*Ptr_Ref_Par = Ptr_Glob->Ptr_Comp;
+	Proc_7(10, Int_Glob, &Ptr_Glob->variant.var_1.Int_Comp);
+}
+
+void
+Proc_4(void) {	// executed once
+	Boolean	Bool_Loc;
+
+	Bool_Loc = Ch_1_Glob == 'A';
+	Bool_Glob = Bool_Loc | Bool_Glob;
+	Ch_2_Glob = 'B';
+}
+
+void
+Proc_5(void) {	// executed once
+	Ch_1_Glob = 'A';
+	Bool_Glob = false;
+}
+
+#else	// PASS2
+
+extern	int	Int_Glob;
+extern	char	Ch_1_Glob;
+
+void
+Proc_6(Enumeration Enum_Val_Par, Enumeration *Enum_Ref_Par) {
+	// executed once
+	// Enum_Val_Par == Ident_3, Enum_Ref_Par becomes Ident_2
+	*Enum_Ref_Par = Enum_Val_Par;
+	if (! Func_3(Enum_Val_Par))
+		// then, not executed
+		*Enum_Ref_Par = Ident_4;
+	switch (Enum_Val_Par) {
+	case Ident_1:
+		*Enum_Ref_Par = Ident_1;
+		break;
+	case Ident_2:
+		if (Int_Glob > 100)
+			*Enum_Ref_Par = Ident_1;
+		else
+			*Enum_Ref_Par = Ident_4;
+		break;
+	case Ident_3: // executed
+		*Enum_Ref_Par = Ident_2;
+		break;
+	case Ident_4: break;
+	case Ident_5:
+		*Enum_Ref_Par = Ident_3;
+		break;
+	}
+}
+
+void
+Proc_7(One_Fifty Int_1_Par_Val, One_Fifty Int_2_Par_Val,
+		One_Fifty *Int_Par_Ref) {
+	// executed three times
+	// first call:  Int_1_Par_Val == 2, Int_2_Par_Val == 3,
+	//		Int_Par_Ref becomes 7
+	// second call: Int_1_Par_Val == 10, Int_2_Par_Val == 5,
+	//		Int_Par_Ref becomes 17
+	// third call:  Int_1_Par_Val == 6, Int_2_Par_Val == 10,
+	//		Int_Par_Ref becomes 18
+	One_Fifty	Int_Loc;
+
+	Int_Loc = Int_1_Par_Val + 2;
+	*Int_Par_Ref = Int_2_Par_Val + Int_Loc;
+}
+
+void
+Proc_8(Arr_1_Dim Arr_1_Par_Ref, Arr_2_Dim Arr_2_Par_Ref,
+		int Int_1_Par_Val, int Int_2_Par_Val) {
+	// executed once, Int_Par_Val_1 == 3, Int_Par_Val_2 == 7
+	One_Fifty	Int_Index, Int_Loc;
+
+	Int_Loc = Int_1_Par_Val + 5;
+	Arr_1_Par_Ref [Int_Loc] = Int_2_Par_Val;
+	Arr_1_Par_Ref [Int_Loc+1] = Arr_1_Par_Ref [Int_Loc];
+	Arr_1_Par_Ref [Int_Loc+30] = Int_Loc;
+	for (Int_Index = Int_Loc; Int_Index <= Int_Loc+1; ++Int_Index)
+		Arr_2_Par_Ref [Int_Loc] [Int_Index] = Int_Loc;
+	Arr_2_Par_Ref [Int_Loc] [Int_Loc-1] += 1;
+	Arr_2_Par_Ref [Int_Loc+20] [Int_Loc] = Arr_1_Par_Ref [Int_Loc];
+	Int_Glob = 5;
+}
+
+Enumeration
+Func_1(Capital_Letter Ch_1_Par_Val, Capital_Letter Ch_2_Par_Val) {
+	// executed three times
+	// first call:  Ch_1_Par_Val == 'H', Ch_2_Par_Val == 'R'
+	// second call: Ch_1_Par_Val == 'A', Ch_2_Par_Val == 'C'
+	// third call:  Ch_1_Par_Val == 'B', Ch_2_Par_Val == 'C'
+	Capital_Letter	Ch_1_Loc, Ch_2_Loc;
+
+	Ch_1_Loc = Ch_1_Par_Val;
+	Ch_2_Loc = Ch_1_Loc;
+	if (Ch_2_Loc != Ch_2_Par_Val)
+		// then, executed
+		return (Ident_1);
+	else { // not executed
+		Ch_1_Glob = Ch_1_Loc;
+		return (Ident_2);
+	}
+}
+
+Boolean
+Func_2(Str_30 Str_1_Par_Ref, Str_30 Str_2_Par_Ref) {
+	// executed once
+	// Str_1_Par_Ref == "DHRYSTONE PROGRAM, 1'ST STRING"
+	// Str_2_Par_Ref == "DHRYSTONE PROGRAM, 2'ND STRING"
+	One_Thirty	Int_Loc;
+	Capital_Letter	Ch_Loc;
+
+	Int_Loc = 2;
+	while (Int_Loc <= 2) // loop body executed once
+		if (Func_1(Str_1_Par_Ref[Int_Loc],
+				Str_2_Par_Ref[Int_Loc+1]) == Ident_1) {
+			// then, executed
+			Ch_Loc = 'A';
+			Int_Loc += 1;
+		}
+	if (Ch_Loc >= 'W' && Ch_Loc < 'Z')
+		// then, not executed
+		Int_Loc = 7;
+	if (Ch_Loc == 'R')
+		// then, not executed
+		return (true);
+	else { // executed
+		if (strcmp(Str_1_Par_Ref, Str_2_Par_Ref) > 0) {
+			// then, not executed
+			Int_Loc += 7;
+			Int_Glob = Int_Loc;
+			return (true);
+		} else // executed
+			return (false);
+	}
+}
+
+Boolean
+Func_3(Enumeration Enum_Par_Val) {
+	// executed once, Enum_Par_Val == Ident_3
+	Enumeration	Enum_Loc;
+
+	Enum_Loc = Enum_Par_Val;
+	if (Enum_Loc == Ident_3)
+		// then, executed
+		return (true);
+	else // not executed
+		return (false);
+}
+
+#endif	// PASS2
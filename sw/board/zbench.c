@@ -0,0 +1,172 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zbench.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	A small benchmark harness.  Each kernel listed in zbkernels[]
+//		below is run in user mode, via zip_rtu(), on a stack of its
+//	own.  The user mode accounting counters are read before and after,
+//	giving the clocks, instructions, memory stall and prefetch stall cycles
+//	spent within the kernel--and nothing else, since the supervisor's
+//	time is counted separately.  A CPI figure is then derived from these.
+//
+//	The only interrupts enabled while the kernels run are the console's.
+//	Its output is sent from a ring buffer by interrupt, so that the report
+//	lines drain while the next kernel runs.  Each time a kernel is
+//	interrupted, the supervisor services the console and resumes it.  Its
+//	time doing so isn't counted against the kernel.  The console kernel
+//	writes more than the ring holds, and so depends upon this.  A kernel
+//	that faults is reported as such, along with its uCC register, and the
+//	rest are run.
+//
+//	The iteration counts are chosen so that the whole run completes in a
+//	reasonable time under main_tb, as well as on hardware.  To add a
+//	kernel, write a function taking an iteration count and returning zero
+//	on success, and list it below.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdint.h>
+#include "board.h"
+#include "zipcpu.h"
+#include "zipsys.h"
+#include "console.h"
+#include "zbench.h"
+
+#ifndef	_HAVE_ZIPSYS_PERFORMANCE_COUNTERS
+#error "zbench requires the ZipSystem accounting counters"
+#endif
+
+static	const ZBKERNEL	zbkernels[] = {
+	{ "dhrystone",	zb_dhrystone,	100 },
+	{ "memcpy",	zb_memcpy,	16 },
+	{ "crc32",	zb_crc32,	4 },
+	{ "divide",	zb_divide,	1000 },
+	{ "branch",	zb_branch,	4 },
+#ifdef	_BOARD_HAS_BUSCONSOLE
+	{ "console",	zb_console,	24 },
+#endif
+	{ NULL, NULL, 0 }
+};
+
+#define	ZB_STACK_WORDS	2048
+static	uint32_t	zb_stack[ZB_STACK_WORDS];
+
+static void
+zb_run(const ZBKERNEL *k, ZBRESULT *r) {
+	unsigned	ck, mem, pf, icnt, upc, ucc;
+	int		zero = 0;
+
+	SETUREG(zero, "uR2");  SETUREG(zero, "uR3");  SETUREG(zero, "uR4");
+	SETUREG(zero, "uR5");  SETUREG(zero, "uR6");  SETUREG(zero, "uR7");
+	SETUREG(zero, "uR8");  SETUREG(zero, "uR9");  SETUREG(zero, "uR10");
+	SETUREG(zero, "uR11"); SETUREG(zero, "uR12");
+	// Kernels "return" into zip_syscall(), which drops us back into the
+	// supervisor right after the zip_rtu() that started them
+	SETUREG(zip_syscall, "uR0");
+	SETUREG(k->k_arg, "uR1");
+	SETUREG(&zb_stack[ZB_STACK_WORDS], "uSP");
+	SETUREG(CC_GIE, "uCC");
+	SETUREG(k->k_fn, "uPC");
+
+	ck   = _zip->z_u.ac_ck;
+	mem  = _zip->z_u.ac_mem;
+	pf   = _zip->z_u.ac_pf;
+	icnt = _zip->z_u.ac_icnt;
+
+	while(1) {
+		zip_rtu();
+
+		GETUREG(ucc, "uCC");
+		GETUREG(upc, "uPC");
+		if (ucc & CC_EXCEPTION)
+			break;
+		// Returning leaves uPC just past zip_syscall()'s AND
+		if ((upc > (unsigned)zip_syscall)
+				&&(upc <= (unsigned)zip_syscall + 4))
+			break;
+		// Otherwise we were interrupted.  Service the console, and
+		// pick up where we left off.
+#ifdef	_BOARD_HAS_BUSCONSOLE
+		_console_isr();
+#endif
+	}
+
+	r->r_ck   = _zip->z_u.ac_ck   - ck;
+	r->r_mem  = _zip->z_u.ac_mem  - mem;
+	r->r_pf   = _zip->z_u.ac_pf   - pf;
+	r->r_icnt = _zip->z_u.ac_icnt - icnt;
+	r->r_ucc  = (ucc & CC_EXCEPTION) ? ucc : 0;
+	GETUREG(r->r_result, "uR1");
+}
+
+static void
+zb_report(const ZBKERNEL *k, const ZBRESULT *r) {
+	unsigned	cpi;
+
+	// CPI, times 100 and rounded
+	cpi = (r->r_icnt) ? (unsigned)(((unsigned long)r->r_ck * 100
+				+ r->r_icnt/2) / r->r_icnt) : 0;
+
+	printf("%-10s %10u %10u %10u %10u %4u.%02u  ", k->k_name,
+		r->r_ck, r->r_icnt, r->r_mem, r->r_pf, cpi / 100, cpi % 100);
+	if (r->r_ucc)
+		printf("FAULT, uCC = 0x%08x\n", r->r_ucc);
+	else if (r->r_result)
+		printf("FAIL (%d)\n", r->r_result);
+	else
+		printf("Pass\n");
+}
+
+int main(int argc, char **argv) {
+	ZBRESULT	r;
+	int		fail = 0;
+
+	// Disable and clear all interrupts
+	_zip->z_pic  = CLEARPIC;
+	_zip->z_apic = CLEARPIC;
+#ifdef	_BOARD_HAS_BUSCONSOLE
+	_console_enable_ints();
+#endif
+
+	printf("%-10s %10s %10s %10s %10s %7s  %s\n", "Kernel", "Clocks",
+		"Insns", "MemStall", "PfStall", "CPI", "Result");
+	for(const ZBKERNEL *k = zbkernels; k->k_name; k++) {
+		zb_run(k, &r);
+		zb_report(k, &r);
+		if ((r.r_ucc)||(r.r_result))
+			fail = 1;
+	}
+
+	return fail;
+}
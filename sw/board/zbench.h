@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zbench.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Shared definitions for the zbench benchmark harness.  Each
+//		kernel takes an iteration count and returns zero if its
+//	results checked out, non-zero otherwise.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	ZBENCH_H
+#define	ZBENCH_H
+
+typedef	int	(*ZBKERNELFN)(int);
+
+typedef	struct	{
+	const char	*k_name;
+	ZBKERNELFN	k_fn;
+	int		k_arg;	// Iterations, passed to k_fn
+} ZBKERNEL;
+
+typedef	struct	{
+	// User mode clocks, memory stalls, prefetch stalls, and instructions
+	unsigned	r_ck, r_mem, r_pf, r_icnt;
+	int		r_result;	// What the kernel returned
+	unsigned	r_ucc;		// uCC on exception, else zero
+} ZBRESULT;
+
+// Kernels, zbkernels.c
+extern	int	zb_memcpy(int n);
+extern	int	zb_crc32(int n);
+extern	int	zb_divide(int n);
+extern	int	zb_branch(int n);
+extern	int	zb_console(int n);
+
+// Dhrystone, zbdhry.c
+extern	int	zb_dhrystone(int n);
+
+#endif
@@ -0,0 +1,232 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zbkernels.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	The (non-Dhrystone) kernels run by zbench.  Each exercises a
+//		different part of the CPU:
+//
+//	zb_memcpy	Memory bandwidth, via the library memcpy()
+//	zb_crc32	Table driven CRC-32: loads, shifts, and XORs
+//	zb_divide	32 and 64-bit divides, hardware and library
+//	zb_branch	An insertion sort, whose branches depend upon the data
+//	zb_console	Console output, more than the transmit ring holds, sent
+//			by the console's interrupt
+//
+//	Each checks its own results, returning zero if they are correct.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdint.h>
+#include <string.h>
+#include "board.h"
+#include "console.h"
+#include "zbench.h"
+
+#define	BUFWORDS	1024	// 4kB buffers
+static	uint32_t	bufa[BUFWORDS], bufb[BUFWORDS];
+
+static uint32_t
+zb_prng(uint32_t *seed) {
+	uint32_t	s = *seed;
+
+	s ^= s << 13;
+	s ^= s >> 17;
+	s ^= s <<  5;
+	return (*seed = s);
+}
+
+static void
+zb_fill(uint32_t *buf, unsigned nw, uint32_t seed) {
+	for(unsigned k=0; k<nw; k++)
+		buf[k] = zb_prng(&seed);
+}
+
+//
+// zb_memcpy
+//
+// Copy 4kB back and forth between two buffers, n times each way
+//
+int
+zb_memcpy(int n) {
+	zb_fill(bufa, BUFWORDS, 0x13579bdf);
+
+	for(int k=0; k<n; k++) {
+		memcpy(bufb, bufa, sizeof(bufa));
+		memcpy(bufa, bufb, sizeof(bufb));
+	}
+
+	return memcmp(bufa, bufb, sizeof(bufa)) != 0;
+}
+
+//
+// zb_crc32
+//
+// The CRC-32 (IEEE 802.3) of a 4kB buffer, n times over.  The table is built
+// within the kernel, so that it's counted too.
+//
+static	uint32_t	crctbl[256];
+
+static uint32_t
+crc32(uint32_t crc, const uint8_t *buf, unsigned len) {
+	crc = ~crc;
+	while(len-- > 0)
+		crc = crctbl[(crc ^ *buf++) & 0x0ff] ^ (crc >> 8);
+	return ~crc;
+}
+
+int
+zb_crc32(int n) {
+	uint32_t	crc, first = 0;
+
+	for(unsigned k=0; k<256; k++) {
+		uint32_t	c = k;
+		for(int b=0; b<8; b++)
+			c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+		crctbl[k] = c;
+	}
+
+	// Check against the standard test vector
+	if (crc32(0, (const uint8_t *)"123456789", 9) != 0xcbf43926)
+		return 1;
+
+	zb_fill(bufa, BUFWORDS, 0x2468ace0);
+	for(int k=0; k<n; k++) {
+		crc = crc32(0, (const uint8_t *)bufa, sizeof(bufa));
+		if (k == 0)
+			first = crc;
+		else if (crc != first)
+			return 2;
+	}
+
+	return 0;
+}
+
+//
+// zb_divide
+//
+// n each of 32-bit and 64-bit divides of pseudorandom values, checking that
+// the quotient and remainder reconstruct the dividend
+//
+int
+zb_divide(int n) {
+	uint32_t	seed = 0x0badcafe;
+
+	for(int k=0; k<n; k++) {
+		uint32_t	a32, b32, q32, r32;
+		unsigned long	a64, b64, q64, r64;
+
+		a32 = zb_prng(&seed);
+		b32 = zb_prng(&seed) >> (k & 31);
+		if (b32 == 0)
+			b32 = 1;
+		q32 = a32 / b32;
+		r32 = a32 % b32;
+		if ((r32 >= b32)||(q32 * b32 + r32 != a32))
+			return 1;
+
+		a64 = ((unsigned long)zb_prng(&seed) << 32) | zb_prng(&seed);
+		b64 = ((unsigned long)zb_prng(&seed) << 32) | zb_prng(&seed);
+		b64 >>= (k & 63);
+		if (b64 == 0)
+			b64 = 1;
+		q64 = a64 / b64;
+		r64 = a64 % b64;
+		if ((r64 >= b64)||(q64 * b64 + r64 != a64))
+			return 2;
+	}
+
+	return 0;
+}
+
+//
+// zb_branch
+//
+// Insertion sort 256 pseudorandom words, n times.  Nearly every branch
+// depends upon the data, so there's little for a predictor to go on.
+//
+int
+zb_branch(int n) {
+	const	unsigned	NSORT = 256;
+	int32_t	*v = (int32_t *)bufa;
+
+	for(int k=0; k<n; k++) {
+		zb_fill(bufa, NSORT, 0x600dd00d + k);
+
+		for(unsigned i=1; i<NSORT; i++) {
+			int32_t		x = v[i];
+			unsigned	j = i;
+
+			while((j > 0)&&(v[j-1] > x)) {
+				v[j] = v[j-1];
+				j--;
+			}
+			v[j] = x;
+		}
+
+		for(unsigned i=1; i<NSORT; i++)
+			if (v[i-1] > v[i])
+				return 1;
+	}
+
+	return 0;
+}
+
+#ifdef	_BOARD_HAS_BUSCONSOLE
+//
+// zb_console
+//
+// Write n lines to the console at once, then wait for them to be sent.  With
+// more lines than the transmit ring holds, _console_write() must wait for
+// room, and it's the console interrupt--serviced by zbench's supervisor--that
+// makes it.
+//
+int
+zb_console(int n) {
+	static	const char	line[] =
+		"zb_console: this line was sent by the console interrupt   \n";
+	const	unsigned	LN = sizeof(line)-1;
+	char	*buf = (char *)bufa;
+
+	if ((unsigned)n * LN > sizeof(bufa))
+		return 1;
+	for(int k=0; k<n; k++) {
+		memcpy(&buf[k*LN], line, LN);
+		buf[k*LN+LN-3] = '0' + (k/10)%10;
+		buf[k*LN+LN-2] = '0' + k%10;
+	}
+
+	_console_write(buf, n * LN);
+	_console_flush();
+	return 0;
+}
+#endif
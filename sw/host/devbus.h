@@ -60,6 +60,27 @@ public:
 	BUSERR(const uint32 a) : addr(a) {};
 };
 
+//
+// BUSOP
+//
+// One single word read or write, within a sequence of them passed to
+// DEVBUS::pipeline()
+//
+class	BUSOP {
+public:
+	bool	m_wr,	// True for a write, false for a read
+		m_err;	// Set if a read returned a bus error
+	uint32	m_addr,	// The address to read or write
+		m_data;	// The value to write, or the value read
+	BUSOP(void) : m_wr(false), m_err(false), m_addr(0), m_data(0) {}
+	// A read
+	BUSOP(const uint32 a) : m_wr(false), m_err(false), m_addr(a),
+			m_data(0) {}
+	// A write
+	BUSOP(const uint32 a, const uint32 v) : m_wr(true), m_err(false),
+			m_addr(a), m_data(v) {}
+};
+
 class	DEVBUS {
 public:
 	typedef	uint32	BUSW;
@@ -120,6 +141,31 @@ public:
 	//
 	virtual	void	writez(const BUSW a, const int len, const BUSW *buf) = 0;
 
+	// Perform a sequence of reads and writes, in order.  Each read places
+	// its result into its op's m_data, or sets m_err on a bus error.  This
+	// is equivalent to:
+	//	for(int i=0; i<nops; i++)
+	//		if (ops[i].m_wr)
+	//			writeio(ops[i].m_addr, ops[i].m_data);
+	//		else
+	//			ops[i].m_data = readio(ops[i].m_addr);
+	// save for the error handling, only our implementation sends the
+	// whole sequence at once before collecting any of the results.  Use
+	// it when no address or value depends upon a prior read.
+	virtual	void	pipeline(const int nops, BUSOP *ops) {
+		for(int i=0; i<nops; i++) {
+			if (ops[i].m_wr) {
+				writeio(ops[i].m_addr, ops[i].m_data);
+				continue;
+			} try {
+				ops[i].m_data = readio(ops[i].m_addr);
+				ops[i].m_err  = false;
+			} catch(BUSERR be) {
+				ops[i].m_err  = true;
+			}
+		}
+	}
+
 	// Query whether or not an interrupt has taken place
 	virtual	bool	poll(void) = 0;
 
@@ -7,6 +7,18 @@
 // Purpose:	Read/Empty the entire contents of the flash memory to a file.
 //		The flash is unchanged by this process.
 //
+//	The flash is read a chunk at a time, and each chunk is written to the
+//	file as soon as it arrives.  A log, kept next to the file as
+//	<file>.crc, lists each chunk written along with its CRC-32.  Should
+//	the connection drop, dumpflash -r checks the file against this log
+//	and then picks up at the first chunk missing or bad.  Regions given
+//	with -e are known to be erased, and so are written as 0xff without
+//	being read.
+//
+//	Once the whole flash has been read, any trailing 0xff's are trimmed
+//	from the file.  Chunks are checked as though the file were padded
+//	back out with 0xff's.
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -59,57 +71,349 @@ void	closeup(int v) {
 #define	DUMPMEM		FLASHBASE
 #define	DUMPWORDS	(FLASHLEN>>2)
 
+#define	FLASHFILE	"qspidump.bin"
+#define	DEFCHUNK	(64*1024)	// Bytes read between writes to disk
+#define	MAXERASED	32
+#define	MAXRETRY	3	// Retries of a chunk whose reads differ, with -v
+
+void	usage(void) {
+	printf("USAGE: dumpflash [-hrv] [-a offset] [-c chunk] [-e offset:len] [-o file]\n");
+	printf("\n"
+"\t-a offset\tStart reading at this offset into the flash, keeping any\n"
+"\t\tchunks before it already in the file and its log.  Implies -r.\n"
+"\t-c chunk\tRead (and check) the flash in chunks of this many bytes.\n"
+"\t\tThe default is %d.\n"
+"\t-e offset:len\tThe len bytes starting at offset are known to be\n"
+"\t\terased.  They\'ll be written as 0xff, without being read.  May be\n"
+"\t\tgiven more than once.\n"
+"\t-h\tDisplay this usage statement\n"
+"\t-o file\tDump into file, rather than %s\n"
+"\t-r\tResume a dump that didn\'t finish, from the first chunk the log\n"
+"\t\tdoesn\'t list, or that doesn\'t match the file\n"
+"\t-v\tRead every chunk twice, and retry any whose reads differ, up to %d\n"
+"\t\ttimes\n",
+		DEFCHUNK, FLASHFILE, MAXRETRY);
+}
+
+#ifdef	FLASH_ACCESS
+static	unsigned	crctbl[256];
+
+static	unsigned	crc32(const char *buf, unsigned len) {
+	unsigned	crc = 0xffffffff;
+
+	if (crctbl[1] == 0) for(unsigned k=0; k<256; k++) {
+		unsigned	c = k;
+		for(int b=0; b<8; b++)
+			c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+		crctbl[k] = c;
+	}
+
+	while(len-- > 0)
+		crc = crctbl[(crc ^ *buf++) & 0x0ff] ^ (crc >> 8);
+	return ~crc;
+}
+
+// Regions known to be erased, as offsets into the flash
+static	unsigned	gbl_erased[MAXERASED][2];
+static	int		gbl_nerased = 0;
+
+//
+// Reads the len bytes at offset from the flash into buf, skipping any that
+// are known to be erased
+//
+static	void	readchunk(unsigned offset, unsigned len, char *buf) {
+	unsigned	end = offset + len;
+
+	memset(buf, 0xff, len);
+	while(offset < end) {
+		unsigned	stop = end;
+		bool		erased = false;
+
+		for(int k=0; (k<gbl_nerased)&&(!erased); k++) {
+			unsigned eo = gbl_erased[k][0], ee = eo + gbl_erased[k][1];
+
+			if ((eo <= offset)&&(offset < ee)) {
+				// Skip past it, then look again
+				offset = (ee < end) ? ee : end;
+				erased = true;
+			} else if ((offset < eo)&&(eo < stop))
+				stop = eo;
+		} if (erased)
+			continue;
+
+		m_fpga->readi(DUMPMEM+offset, (stop-offset)>>2,
+			(DEVBUS::BUSW *)&buf[len-(end-offset)]);
+		byteswapbuf((stop-offset)>>2,
+			(DEVBUS::BUSW *)&buf[len-(end-offset)]);
+		offset = stop;
+	}
+}
+
+//
+// Reads len bytes at offset back from the dump file, as though it were
+// padded out with 0xff's
+//
+static	void	readfile(FILE *fp, unsigned offset, unsigned len, char *buf) {
+	size_t	n = 0;
+
+	if (fseek(fp, offset, SEEK_SET) == 0)
+		n = fread(buf, 1, len, fp);
+	memset(&buf[n], 0xff, len-n);
+}
+
+//
+// Checks the chunks the log lists against the file, keeping those that
+// match and follow one another from the start of the flash--or, given
+// stop_at, those ending at or before it, unchecked.  The log is then cut
+// back to only these.  Returns where to pick up.
+//
+static	unsigned	checklog(FILE *fp, const char *logname, bool check,
+			unsigned stop_at) {
+	FILE		*lp;
+	char		line[80];
+	unsigned	next = 0;
+	long		good = 0;
+
+	lp = fopen(logname, "r");
+	if (NULL == lp) {
+		fprintf(stderr, "Cannot resume without the log, %s\n", logname);
+		exit(EXIT_FAILURE);
+	}
+
+	while(fgets(line, sizeof(line), lp)) {
+		unsigned	offset, len, crc;
+
+		if (sscanf(line, "%x %x %x", &offset, &len, &crc) != 3)
+			break;
+		if ((len == 0)||(len > FLASHLEN)||(offset > FLASHLEN-len))
+			break;
+		if (!check) {
+			if (offset + len > stop_at)
+				break;
+		} else {
+			char	*buf;
+			bool	match;
+
+			if (offset != next)
+				break;
+			buf = new char[len];
+			readfile(fp, offset, len, buf);
+			match = (crc32(buf, len) == crc);
+			delete[] buf;
+			if (!match) {
+				printf("Chunk at 0x%08x doesn\'t match the log\n",
+					offset);
+				break;
+			}
+		}
+
+		next = offset + len;
+		good = ftell(lp);
+	} fclose(lp);
+
+	if (truncate(logname, good) != 0) {
+		fprintf(stderr, "Cannot update the log, %s\n", logname);
+		exit(EXIT_FAILURE);
+	}
+
+	return (check) ? next : stop_at;
+}
+#endif
+
 int main(int argc, char **argv) {
 #ifdef	FLASH_ACCESS
-	FILE	*fp;
-	const int	BUFLN = FLASHLEN;
-	char	*buf = new char[FLASHLEN];
+	FILE		*fp, *lp;
+	const char	*fname = FLASHFILE;
+	char		*logname, *buf, *vbuf = NULL;
+	unsigned	chunk = DEFCHUNK, start = 0, sz;
+	bool		resume = false, offset_given = false, verify = false;
+	int		skp;
+
+	skp=1;
+	for(int argn=0; argn<argc-skp; argn++) {
+		if (argv[argn+skp][0] == '-') {
+			char	*str = argv[argn+skp+1], *ptr;
+
+			switch(argv[argn+skp][1]) {
+			case 'a':
+				if (argn+skp+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				start = strtoul(str, NULL, 0);
+				offset_given = resume = true;
+				skp++;
+				break;
+			case 'c':
+				if (argn+skp+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				chunk = strtoul(str, NULL, 0);
+				skp++;
+				break;
+			case 'e':
+				if ((argn+skp+1 >= argc)||(gbl_nerased >= MAXERASED)){
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				gbl_erased[gbl_nerased][0] = strtoul(str, &ptr, 0);
+				if (*ptr++ != ':') {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				gbl_erased[gbl_nerased][1] = strtoul(ptr, NULL, 0);
+				if ((gbl_erased[gbl_nerased][0] & 3)
+					||(gbl_erased[gbl_nerased][1] & 3)) {
+					fprintf(stderr, "Erased regions must be word aligned\n");
+					exit(EXIT_FAILURE);
+				}
+				gbl_nerased++;
+				skp++;
+				break;
+			case 'h':
+				usage();
+				exit(EXIT_SUCCESS);
+				break;
+			case 'o':
+				if (argn+skp+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				fname = str;
+				skp++;
+				break;
+			case 'r':
+				resume = true;
+				break;
+			case 'v':
+				verify = true;
+				break;
+			default:
+				fprintf(stderr, "Unknown option, -%c\n\n",
+					argv[argn+skp][1]);
+				usage();
+				exit(EXIT_FAILURE);
+				break;
+			} skp++; argn--;
+		} else
+			argv[argn] = argv[argn+skp];
+	} argc -= skp;
+
+	if (argc != 0) {
+		usage();
+		exit(EXIT_FAILURE);
+	} else if ((chunk < 4)||(chunk & 3)||(chunk > FLASHLEN)) {
+		fprintf(stderr, "The chunk size must be a multiple of four bytes\n");
+		exit(EXIT_FAILURE);
+	} else if ((start & 3)||(start > FLASHLEN)) {
+		fprintf(stderr, "Bad starting offset, 0x%08x\n", start);
+		exit(EXIT_FAILURE);
+	}
+
+	logname = new char[strlen(fname)+5];
+	strcpy(logname, fname);
+	strcat(logname, ".crc");
+	buf = new char[chunk];
+	if (verify)
+		vbuf = new char[chunk];
+
+	if (!resume) {
+		if (access(fname, F_OK)==0) {
+			fprintf(stderr, "Cowardly refusing to overwrite %s\n", fname);
+			exit(EXIT_FAILURE);
+		}
+
+		fp = fopen(fname, "w+");
+		lp = fopen(logname, "w");
+	} else {
+		fp = fopen(fname, "r+");
+		if (NULL == fp) {
+			fprintf(stderr, "Cannot resume %s\n", fname);
+			exit(EXIT_FAILURE);
+		}
+
+		start = checklog(fp, logname, !offset_given, start);
+		lp = fopen(logname, "a");
+		printf("Resuming at offset 0x%08x\n", start);
+	} if ((NULL == fp)||(NULL == lp)) {
+		fprintf(stderr, "Cannot open %s\n", (fp) ? logname : fname);
+		exit(EXIT_FAILURE);
+	}
 
 	FPGAOPEN(m_fpga);
+	signal(SIGSTOP, closeup);
+	signal(SIGHUP, closeup);
 	fprintf(stderr, "Before starting, nread = %ld\n", 
 		m_fpga->m_total_nread);
 
 	// Start with testing the version:
 	printf("VERSION: %08x\n", m_fpga->readio(R_VERSION));
 
-	// SPI flash testing
-	// Enable the faster (vector) reads
-	bool	vector_read = true;
-	unsigned	sz;
+	try {
+		int	tries = 0;
 
-	if (vector_read) {
-		m_fpga->readi(DUMPMEM, BUFLN>>2, (DEVBUS::BUSW *)&buf[0]);
-		byteswapbuf(BUFLN>>2, (DEVBUS::BUSW *)&buf[0]);
-	} else {
-		for(int i=0; i<BUFLN; i+=4) {
-			DEVBUS::BUSW	word;
-
-			word = m_fpga->readio(DUMPMEM+i);
-			
-			buf[i  ] = (word>>24) & 0x0ff;
-			buf[i+1] = (word>>16) & 0x0ff;
-			buf[i+2] = (word>> 8) & 0x0ff;
-			buf[i+3] = (word    ) & 0x0ff;
+		for(unsigned offset = start; offset < FLASHLEN; ) {
+			unsigned	len = chunk - (offset % chunk), crc;
+
+			if (offset + len > FLASHLEN)
+				len = FLASHLEN - offset;
+
+			readchunk(offset, len, buf);
+			crc = crc32(buf, len);
+			if (verify) {
+				readchunk(offset, len, vbuf);
+				if (crc32(vbuf, len) != crc) {
+					if (++tries > MAXRETRY) {
+						fprintf(stderr, "\nERR: Reads at 0x%08x still differ after %d retries\n",
+							offset, MAXRETRY);
+						fprintf(stderr, "Run again with -r to pick up where this left off\n");
+						exit(EXIT_FAILURE);
+					}
+					printf("\nReads at 0x%08x differ, retrying\n",
+						offset);
+					continue;
+				}
+			} tries = 0;
+
+			// The data must reach the file before the log says
+			// it's there
+			fseek(fp, offset, SEEK_SET);
+			if (fwrite(buf, 1, len, fp) != len) {
+				fprintf(stderr, "Write to %s failed\n", fname);
+				exit(EXIT_FAILURE);
+			} fflush(fp);
+			fprintf(lp, "%08x %08x %08x\n", offset, len, crc);
+			fflush(lp);
+
+			offset += len;
+			fprintf(stderr, "\r%5u of %5u kB", offset>>10,
+				FLASHLEN>>10);
 		}
+	} catch(BUSERR b) {
+		fprintf(stderr, "\nBUS-ERR @0x%08x\n", b.addr);
+		fprintf(stderr, "Run again with -r to pick up where this left off\n");
+		exit(EXIT_FAILURE);
 	}
 	printf("\nREAD-COMPLETE\n");
 
 	// Now, let's find the end
-	sz = BUFLN-1;
-	while((sz>0)&&((unsigned char)buf[sz] == 0xff))
-		sz--;
-	sz+=1;
-
-#define	FLASHFILE	"qspidump.bin"
+	sz = FLASHLEN;
+	while(sz > 0) {
+		unsigned	len = (sz < chunk) ? sz : chunk, k;
 
-	if (access(FLASHFILE, F_OK)==0) {
-		fprintf(stderr, "Cowardly refusing to overwrite %s\n", FLASHFILE);
-		exit(EXIT_FAILURE);
+		readfile(fp, sz-len, len, buf);
+		for(k=len; (k>0)&&((unsigned char)buf[k-1] == 0xff); k--)
+			;
+		sz -= len - k;
+		if (k > 0)
+			break;
 	}
 
-	fp = fopen(FLASHFILE,"w");
-	fwrite(buf, sizeof(buf[0]), sz, fp);
 	fclose(fp);
+	fclose(lp);
+	if (truncate(fname, sz) != 0)
+		fprintf(stderr, "Could not trim %s\n", fname);
 
 	printf("The read was accomplished in %ld bytes over the UART\n",
 		m_fpga->m_total_nread);
@@ -117,6 +421,9 @@ int main(int argc, char **argv) {
 	if (m_fpga->poll())
 		printf("FPGA was interrupted\n");
 	delete	m_fpga;
+	delete[] buf;
+	delete[] vbuf;
+	delete[] logname;
 #else // FLASH_ACCESS
 	printf(
 "This design requires some kind of flash be available within your design.\n"
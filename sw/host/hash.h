@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	hash.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	The hash functions behind the host tools' name and address
+//		lookups: the register tables in regdefs.cpp, and SYMTAB.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	HASH_H
+#define	HASH_H
+
+#include <ctype.h>
+
+// FNV-1a over a name, ignoring case.  The seed picks one of a family of
+// such hashes, as the register table's perfect hash needs.
+static inline unsigned	namehash(const char *v, unsigned seed = 0) {
+	unsigned	h = 2166136261u ^ (seed * 0x9e3779b9u);
+
+	while(*v)
+		h = (h ^ tolower(*v++)) * 16777619u;
+	return h ^ (h >> 15);
+}
+
+// Addresses are word aligned, so the bottom two bits carry nothing
+static inline unsigned	addrhash(unsigned v) {
+	return ((v >> 2) * 0x9e3779b1u) >> 7;
+}
+
+#endif
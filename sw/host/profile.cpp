@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	profile.cpp
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	The flat profile listing shared by zipprof and zipstate.
+//		See profile.h.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "profile.h"
+
+typedef	struct	{
+	unsigned	c_count;
+	int		c_sym;	// Index into the symbol table, or -1
+	unsigned	c_addr;
+} PROFCOUNT;
+
+static int
+countcmp(const void *va, const void *vb) {
+	const PROFCOUNT	*a = (const PROFCOUNT *)va, *b = (const PROFCOUNT *)vb;
+
+	if (a->c_count != b->c_count)
+		return (a->c_count > b->c_count) ? -1 : 1;
+	return (a->c_addr < b->c_addr) ? -1 : (a->c_addr > b->c_addr);
+}
+
+void	profile(SYMTAB &sym, unsigned npcs, const unsigned *pc,
+		const unsigned *count, unsigned nsamples,
+		int maxlist, bool list_pcs) {
+	int		nsyms = sym.size();
+	PROFCOUNT	*fn, *hist;
+	unsigned	nhist = 0;
+
+	// Look up the function of each PC only once
+	hist = new PROFCOUNT[npcs+1];
+	for(unsigned k=0; k<npcs; k++) {
+		if (count[k] == 0)
+			continue;
+		hist[nhist].c_addr  = pc[k];
+		hist[nhist].c_count = count[k];
+		hist[nhist].c_sym   = sym.nearest(pc[k], true);
+		nhist++;
+	}
+
+	// Histogram by function.  One extra slot for PCs outside any function.
+	fn = new PROFCOUNT[nsyms+1];
+	for(int k=0; k<=nsyms; k++) {
+		fn[k].c_count = 0;
+		fn[k].c_sym   = (k < nsyms) ? k : -1;
+		fn[k].c_addr  = (k < nsyms) ? sym[k].m_addr : 0xffffffff;
+	}
+
+	for(unsigned k=0; k<nhist; k++) {
+		int	s = hist[k].c_sym;
+		fn[(s < 0) ? nsyms : s].c_count += hist[k].c_count;
+	}
+
+	qsort(fn, nsyms+1, sizeof(PROFCOUNT), countcmp);
+
+	printf("%7s %8s  %s\n", "Percent", "Samples", "Function");
+	for(int k=0; (k<=nsyms)&&(fn[k].c_count > 0); k++) {
+		if ((maxlist > 0)&&(k >= maxlist))
+			break;
+		printf("%6.2f%% %8u  %s\n", 100.0 * fn[k].c_count / nsamples,
+			fn[k].c_count,
+			(fn[k].c_sym < 0) ? "(unknown)" : sym[fn[k].c_sym].m_name);
+	}
+	delete[] fn;
+
+	if (list_pcs) {
+		qsort(hist, nhist, sizeof(PROFCOUNT), countcmp);
+
+		printf("\n%7s %8s  %-10s  %s\n", "Percent", "Samples",
+			"Address", "Function");
+		for(unsigned k=0; k<nhist; k++) {
+			if ((maxlist > 0)&&(k >= (unsigned)maxlist))
+				break;
+			if (hist[k].c_sym < 0)
+				printf("%6.2f%% %8u  0x%08x  (unknown)\n",
+					100.0 * hist[k].c_count / nsamples,
+					hist[k].c_count, hist[k].c_addr);
+			else
+				printf("%6.2f%% %8u  0x%08x  %s+0x%x\n",
+					100.0 * hist[k].c_count / nsamples,
+					hist[k].c_count, hist[k].c_addr,
+					sym[hist[k].c_sym].m_name,
+					hist[k].c_addr - sym[hist[k].c_sym].m_addr);
+		}
+	}
+
+	delete[] hist;
+}
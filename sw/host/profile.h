@@ -0,0 +1,59 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	profile.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Lists a flat profile of sampled PCs, by function and
+//		(optionally) by address.  zipprof gets its samples from the
+//	buffer zprof fills on the board, and zipstate by sampling the running
+//	CPU over the debug port.  Both list them through here.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	PROFILE_H
+#define	PROFILE_H
+
+#include "symtab.h"
+
+//
+// Lists the profile of nsamples samples, given as the npcs PCs in pc[] and
+// the number of times each was sampled in count[].  Entries with a zero count
+// are ignored, so a hash table may be passed as it is.  With maxlist
+// positive, only that many of the most frequently sampled functions (and
+// addresses) are listed.  With list_pcs, the most frequently sampled
+// addresses are listed after the functions.
+//
+extern	void	profile(SYMTAB &sym, unsigned npcs, const unsigned *pc,
+			const unsigned *count, unsigned nsamples,
+			int maxlist, bool list_pcs);
+
+#endif
@@ -43,6 +43,7 @@
 #include <stdlib.h>
 #include <strings.h>
 #include <ctype.h>
+#include "hash.h"
 #include "regdefs.h"
 
 const	REGNAME	raw_bregs[] = {
@@ -87,11 +88,109 @@ const	REGNAME	raw_bregs[] = {
 const	REGNAME		*bregs = raw_bregs;
 const	int	NREGS = RAW_NREGS;
 
+//
+// Register names are found via a perfect hash, built the first time one is
+// looked up.  A name's first hash picks its bucket, and each bucket is then
+// given the seed that places all of its names into empty slots of the table.
+// Finding a name thus costs two hashes and one string compare, no matter how
+// many registers there are.  Addresses go through an ordinary open addressed
+// table, keeping the first name given for each.
+//
+static	int		*reg_byname = NULL, *reg_byaddr = NULL;
+static	unsigned	*reg_seed = NULL, reg_bmask, reg_smask;
+
+static	void	reg_index(void) {
+	unsigned	nb = 1;
+	int		*first, *next, *bucket, maxn = 0;
+
+	if (reg_byname)
+		return;
+
+	while(nb < (unsigned)NREGS)
+		nb <<= 1;
+	reg_bmask = nb-1;
+	reg_smask = 2*nb-1;
+	reg_seed   = (unsigned *)calloc(nb, sizeof(unsigned));
+	reg_byname = (int *)malloc(2*nb*sizeof(int));
+	reg_byaddr = (int *)malloc(2*nb*sizeof(int));
+	first  = (int *)malloc(nb*sizeof(int));
+	next   = (int *)malloc(NREGS*sizeof(int));
+	bucket = (int *)malloc(NREGS*sizeof(int));
+	for(unsigned s=0; s<2*nb; s++)
+		reg_byname[s] = reg_byaddr[s] = -1;
+	for(unsigned b=0; b<nb; b++)
+		first[b] = -1;
+
+	for(int i=0; i<NREGS; i++) {
+		bool	dup = false;
+
+		// Only the first of any names repeated is ever found
+		for(int j=0; (j<i)&&(!dup); j++)
+			dup = (strcasecmp(bregs[i].m_name, bregs[j].m_name)==0);
+		if (!dup) {
+			unsigned b = namehash(bregs[i].m_name, 0) & reg_bmask;
+			next[i] = first[b];
+			first[b] = i;
+		}
+
+		unsigned s = addrhash(bregs[i].m_addr) & reg_smask;
+		while((reg_byaddr[s] >= 0)
+				&&(bregs[reg_byaddr[s]].m_addr != bregs[i].m_addr))
+			s = (s+1) & reg_smask;
+		if (reg_byaddr[s] < 0)
+			reg_byaddr[s] = i;
+	}
+
+	// Place the fullest buckets first, while the table is emptiest
+	for(unsigned b=0; b<nb; b++) {
+		int	n = 0;
+		for(int i=first[b]; i>=0; i=next[i])
+			n++;
+		if (n > maxn)
+			maxn = n;
+	}
+
+	for(int n=maxn; n>0; n--) for(unsigned b=0; b<nb; b++) {
+		int	k = 0;
+
+		for(int i=first[b]; i>=0; i=next[i])
+			k++;
+		if (k != n)
+			continue;
+
+		for(unsigned seed=1; reg_seed[b]==0; seed++) {
+			k = 0;
+			for(int i=first[b]; i>=0; i=next[i], k++) {
+				unsigned s = namehash(bregs[i].m_name, seed)
+							& reg_smask;
+				if (reg_byname[s] >= 0)
+					break;
+				reg_byname[s] = i;
+				bucket[k] = s;
+			}
+
+			if (k == n)
+				reg_seed[b] = seed;
+			else while(k > 0)
+				reg_byname[bucket[--k]] = -1;
+		}
+	}
+
+	free(first);
+	free(next);
+	free(bucket);
+}
+
 unsigned	addrdecode(const char *v) {
 	if (isalpha(v[0])) {
-		for(int i=0; i<NREGS; i++)
-			if (strcasecmp(v, bregs[i].m_name)==0)
+		reg_index();
+
+		unsigned b = namehash(v, 0) & reg_bmask;
+		if (reg_seed[b]) {
+			int i = reg_byname[namehash(v, reg_seed[b]) & reg_smask];
+			if ((i >= 0)&&(strcasecmp(v, bregs[i].m_name)==0))
 				return bregs[i].m_addr;
+		}
 #ifdef	R_ZIPCTRL
 		if (strcasecmp(v, "CPU")==0)
 			return R_ZIPCTRL;
@@ -107,9 +206,12 @@ unsigned	addrdecode(const char *v) {
 }
 
 const	char *addrname(const unsigned v) {
-	for(int i=0; i<NREGS; i++)
-		if (bregs[i].m_addr == v)
-			return bregs[i].m_name;
+	reg_index();
+
+	for(unsigned s=addrhash(v) & reg_smask; reg_byaddr[s] >= 0;
+			s = (s+1) & reg_smask)
+		if (bregs[reg_byaddr[s]].m_addr == v)
+			return bregs[reg_byaddr[s]].m_name;
 	return NULL;
 }
 
@@ -0,0 +1,237 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	symtab.cpp
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Loads, and then looks up, the symbols declared in symtab.h.
+//		Symbols are sorted by address the first time one is looked
+//	up after being added, so the symbol containing an address can be found
+//	by a binary search.  Names and exact addresses go through hash tables
+//	at the same time.  Where a name or address is given more than once,
+//	the first symbol given for it is the one found.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "symtab.h"
+#include "hash.h"
+
+SYMTAB::SYMTAB(void) : m_sym(NULL), m_nsyms(0), m_nalloc(0),
+		m_byname(NULL), m_byaddr(NULL), m_mask(0), m_dirty(false) {}
+
+SYMTAB::~SYMTAB(void) {
+	for(int k=0; k<m_nsyms; k++)
+		free(m_sym[k].m_name);
+	free(m_sym);
+	free(m_byname);
+	free(m_byaddr);
+}
+
+void	SYMTAB::add(unsigned addr, const char *name, unsigned size, bool func) {
+	if (m_nsyms >= m_nalloc) {
+		m_nalloc = (m_nalloc) ? 2*m_nalloc : 64;
+		m_sym = (SYMENTRY *)realloc(m_sym, m_nalloc * sizeof(SYMENTRY));
+	}
+
+	m_sym[m_nsyms].m_addr = addr;
+	m_sym[m_nsyms].m_size = size;
+	m_sym[m_nsyms].m_func = func;
+	m_sym[m_nsyms].m_name = strdup(name);
+	m_nsyms++;
+	m_dirty = true;
+}
+
+void	SYMTAB::add(ELFSYMBOL **symbols, int nsyms) {
+	for(int k=0; k<nsyms; k++)
+		add(symbols[k]->m_addr, symbols[k]->m_name,
+			symbols[k]->m_size, symbols[k]->m_func);
+}
+
+int	SYMTAB::loadmap(const char *fname) {
+	FILE	*fp;
+	char	line[512];
+	int	n = 0;
+
+	fp = fopen(fname, "r");
+	if (NULL == fp) {
+		fprintf(stderr, "ERR: Could not open MAP file, %s\n", fname);
+		exit(EXIT_FAILURE);
+	}
+
+	while(fgets(line, sizeof(line), fp)) {
+		char	*astr, *nstr, *xstr, *end;
+		unsigned	addr;
+
+		astr = strtok(line, " \t\n");
+		if (!astr)
+			continue;
+		nstr = strtok(NULL, " \t\n");
+		if (!nstr)
+			continue;
+		xstr = strtok(NULL, " \t\n");
+		if (xstr)
+			continue;
+		if (!isdigit(*astr))
+			continue;
+		addr = strtoul(astr, &end, 0);
+		if (*end)
+			continue;
+		add(addr, nstr);
+		n++;
+	}
+
+	fclose(fp);
+	return n;
+}
+
+//
+// Sorts the symbols by address, keeping those at the same address in the
+// order they were given, and then rebuilds both hash tables
+//
+static	const SYMENTRY	*gbl_sortsym;
+
+static	int	symcmp(const void *va, const void *vb) {
+	int	a = *(const int *)va, b = *(const int *)vb;
+
+	if (gbl_sortsym[a].m_addr != gbl_sortsym[b].m_addr)
+		return (gbl_sortsym[a].m_addr < gbl_sortsym[b].m_addr) ? -1 : 1;
+	return a - b;
+}
+
+void	SYMTAB::index(void) {
+	int		*order;
+	SYMENTRY	*sorted;
+
+	if (!m_dirty)
+		return;
+	m_dirty = false;
+
+	order = (int *)malloc(m_nsyms * sizeof(int));
+	for(int k=0; k<m_nsyms; k++)
+		order[k] = k;
+	gbl_sortsym = m_sym;
+	qsort(order, m_nsyms, sizeof(int), symcmp);
+
+	sorted = (SYMENTRY *)malloc(m_nalloc * sizeof(SYMENTRY));
+	for(int k=0; k<m_nsyms; k++)
+		sorted[k] = m_sym[order[k]];
+	free(m_sym);
+	m_sym = sorted;
+
+	// Keep both tables under half full
+	m_mask = 63;
+	while(m_mask+1 < 2u*m_nsyms)
+		m_mask = 2*m_mask+1;
+	m_byname = (int *)realloc(m_byname, (m_mask+1) * sizeof(int));
+	m_byaddr = (int *)realloc(m_byaddr, (m_mask+1) * sizeof(int));
+	for(unsigned s=0; s<=m_mask; s++)
+		m_byname[s] = m_byaddr[s] = -1;
+
+	for(int k=0; k<m_nsyms; k++) {
+		// Names: the first given, not the lowest addressed, wins
+		unsigned s = namehash(m_sym[k].m_name) & m_mask;
+		while((m_byname[s] >= 0)&&(strcasecmp(m_sym[k].m_name,
+					m_sym[m_byname[s]].m_name)!=0))
+			s = (s+1) & m_mask;
+		if ((m_byname[s] < 0)||(order[k] < order[m_byname[s]]))
+			m_byname[s] = k;
+
+		s = addrhash(m_sym[k].m_addr) & m_mask;
+		while((m_byaddr[s] >= 0)
+				&&(m_sym[m_byaddr[s]].m_addr != m_sym[k].m_addr))
+			s = (s+1) & m_mask;
+		if (m_byaddr[s] < 0)
+			m_byaddr[s] = k;
+	}
+
+	free(order);
+}
+
+int	SYMTAB::find(const char *name) {
+	index();
+	if (m_nsyms == 0)
+		return -1;
+
+	for(unsigned s = namehash(name) & m_mask; m_byname[s] >= 0;
+			s = (s+1) & m_mask)
+		if (strcasecmp(name, m_sym[m_byname[s]].m_name)==0)
+			return m_byname[s];
+	return -1;
+}
+
+int	SYMTAB::find(unsigned addr) {
+	index();
+	if (m_nsyms == 0)
+		return -1;
+
+	for(unsigned s = addrhash(addr) & m_mask; m_byaddr[s] >= 0;
+			s = (s+1) & m_mask)
+		if (m_sym[m_byaddr[s]].m_addr == addr)
+			return m_byaddr[s];
+	return -1;
+}
+
+//
+// A binary search for the last symbol at or below addr.  Symbols without
+// a size are assumed to run up to the next symbol.
+//
+int	SYMTAB::nearest(unsigned addr, bool fnonly) {
+	int	lo = 0, hi = m_nsyms-1, best = -1;
+
+	index();
+	while(lo <= hi) {
+		int	mid = (lo+hi)/2;
+		if (m_sym[mid].m_addr <= addr) {
+			best = mid;
+			lo = mid+1;
+		} else
+			hi = mid-1;
+	}
+
+	// Of several symbols at the same address, the first given
+	while((best > 0)&&(m_sym[best-1].m_addr == m_sym[best].m_addr))
+		best--;
+	// Step back past any data objects, to the nearest function
+	while((fnonly)&&(best >= 0)&&(!m_sym[best].m_func))
+		best--;
+	if (best < 0)
+		return -1;
+	if ((m_sym[best].m_size != 0)
+			&&(addr - m_sym[best].m_addr >= m_sym[best].m_size))
+		return -1;
+	return best;
+}
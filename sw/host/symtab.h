@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	symtab.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	A symbol table shared by the host tools.  Symbols may come
+//		from a map file, with one "address name" pair per line, or
+//	from an ELF file's symbol table.  Once loaded, a symbol may be found
+//	by its name (regardless of case), by its address, or as the symbol
+//	containing any given address.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	SYMTAB_H
+#define	SYMTAB_H
+
+#include <stdlib.h>
+#include "zipelf.h"
+
+class	SYMENTRY {
+public:
+	unsigned	m_addr, m_size;	// A size of zero runs to the next symbol
+	bool		m_func;
+	char		*m_name;
+};
+
+class	SYMTAB {
+	SYMENTRY	*m_sym;
+	int		m_nsyms, m_nalloc;
+	// Open addressed hash tables, holding indexes into m_sym, or -1
+	int		*m_byname, *m_byaddr;
+	unsigned	m_mask;
+	// Set by add(), until the symbols are next sorted and hashed
+	bool		m_dirty;
+
+	void	index(void);
+public:
+	SYMTAB(void);
+	~SYMTAB(void);
+
+	void	add(unsigned addr, const char *name, unsigned size = 0,
+			bool func = true);
+	void	add(ELFSYMBOL **symbols, int nsyms);
+	// Reads a map file, exiting if it can't be opened.  Returns the
+	// number of symbols found within it.
+	int	loadmap(const char *fname);
+
+	int	size(void) const { return m_nsyms; }
+	// Symbols are kept sorted by address.  Indexes are only good until
+	// the next add().
+	const SYMENTRY	&operator[](int k) { index(); return m_sym[k]; }
+
+	// Each of these returns an index, or -1 if there's no such symbol
+	int	find(const char *name);
+	int	find(unsigned addr);
+	// The symbol containing addr, if any.  With fnonly, data objects
+	// are skipped in favor of the function before them.
+	int	nearest(unsigned addr, bool fnonly = false);
+
+	// The name of the symbol at addr, or NULL
+	const char	*name(unsigned addr) {
+		int	k = find(addr);
+		return (k < 0) ? NULL : m_sym[k].m_name;
+	}
+};
+
+#endif
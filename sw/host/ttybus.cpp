@@ -256,48 +256,7 @@ void	TTYBUS::writev(const BUSW a, const int p, const int len, const BUSW *buf) {
 
 		DBGPRINTF("WRITEV-SUB(%08x%s,#%d,&buf[%d])\n", a+nw, (p)?"++":"", ln, nw);
 		for(int i=0; i<ln; i++) {
-			BUSW	val = buf[nw+i];
-
-			int	caddr = 0;
-			// Let's try compression
-			for(int i=1; i<256; i++) {
-				unsigned	tstaddr;
-				tstaddr = (m_wraddr - i) & 0x0ff;
-				if ((!m_wrloaded)&&(tstaddr > (unsigned)m_wraddr))
-					break;
-				if (m_writetbl[tstaddr] == val) {
-					caddr = ( m_wraddr- tstaddr ) & 0x0ff;
-					break;
-				}
-			}
-
-		/*
-		if (caddr != 0)
-			DBGPRINTF("WR[%08x] = %08x (= TBL[%4x] <= %4x)\n", m_lastaddr, val, caddr, m_wraddr);
-		else
-			DBGPRINTF("WR[%08x] = %08x\n", m_lastaddr, val);
-		*/
-
-			if (caddr != 0) {
-				*ptr++ = charenc( (((caddr>>6)&0x03)<<1) + (p?1:0) + 0x010);
-				*ptr++ = charenc(    caddr    &0x3f    );
-			
-			} else {
-				// For testing, let's start just doing this the hard way
-				*ptr++ = charenc( (((val>>30)&0x03)<<1) + (p?1:0) + 0x018);
-				*ptr++ = charenc( (val>>24)&0x3f);
-				*ptr++ = charenc( (val>>18)&0x3f);
-				*ptr++ = charenc( (val>>12)&0x3f);
-				*ptr++ = charenc( (val>> 6)&0x3f);
-				*ptr++ = charenc( (val    )&0x3f);
-
-				m_writetbl[m_wraddr++] = val;
-				m_wraddr &= 0x0ff;
-				if (m_wraddr == 0) {
-					m_wrloaded = true;
-				}
-			}
-
+			ptr = encode_write(ptr, buf[nw+i], p);
 			if (p == 1) m_lastaddr+=4;
 		}
 		// *ptr++ = charenc(0x2e);
@@ -327,6 +286,58 @@ void	TTYBUS::writev(const BUSW a, const int p, const int len, const BUSW *buf) {
 	readidle();
 }
 
+/*
+ * encode_write
+ *
+ * Encodes a single write of val, following whatever address has already been
+ * set, into ptr, returning a pointer to the end of what was written.  p is
+ * one if the address is to be incremented afterwards.
+ */
+char	*TTYBUS::encode_write(char *ptr, const BUSW val, const int p) {
+	int	caddr = 0;
+
+	// Let's try compression
+	for(int i=1; i<256; i++) {
+		unsigned	tstaddr;
+		tstaddr = (m_wraddr - i) & 0x0ff;
+		if ((!m_wrloaded)&&(tstaddr > (unsigned)m_wraddr))
+			break;
+		if (m_writetbl[tstaddr] == val) {
+			caddr = ( m_wraddr- tstaddr ) & 0x0ff;
+			break;
+		}
+	}
+
+	/*
+	if (caddr != 0)
+		DBGPRINTF("WR[%08x] = %08x (= TBL[%4x] <= %4x)\n", m_lastaddr, val, caddr, m_wraddr);
+	else
+		DBGPRINTF("WR[%08x] = %08x\n", m_lastaddr, val);
+	*/
+
+	if (caddr != 0) {
+		*ptr++ = charenc( (((caddr>>6)&0x03)<<1) + (p?1:0) + 0x010);
+		*ptr++ = charenc(    caddr    &0x3f    );
+	
+	} else {
+		// For testing, let's start just doing this the hard way
+		*ptr++ = charenc( (((val>>30)&0x03)<<1) + (p?1:0) + 0x018);
+		*ptr++ = charenc( (val>>24)&0x3f);
+		*ptr++ = charenc( (val>>18)&0x3f);
+		*ptr++ = charenc( (val>>12)&0x3f);
+		*ptr++ = charenc( (val>> 6)&0x3f);
+		*ptr++ = charenc( (val    )&0x3f);
+
+		m_writetbl[m_wraddr++] = val;
+		m_wraddr &= 0x0ff;
+		if (m_wraddr == 0) {
+			m_wrloaded = true;
+		}
+	}
+
+	return ptr;
+}
+
 /*
  * writez
  *
@@ -587,6 +598,88 @@ void	TTYBUS::readz(const TTYBUS::BUSW a, const int len, TTYBUS::BUSW *buf) {
 	readv(a, 0, len, buf);
 }
 
+/*
+ * pipeline
+ *
+ * Sends a whole sequence of single word reads and writes at once, and only
+ * then collects the results.  Over a serial link, this replaces a round trip
+ * per read with one round trip per MAXPIPE operations.  It's the same
+ * protocol as always, just with the commands queued back to back: address,
+ * write or read, address, write or read, and so on.
+ *
+ * A bus error on a read marks that read.  A bus error on a write is returned
+ * in place of its acknowledgement, and so gets reported against the read
+ * following it.
+ */
+void	TTYBUS::pipeline(const int nops, BUSOP *ops) {
+	const	int	MAXPIPE = 256;
+	// Worst case: a six character address, plus a six character write,
+	// or a two character read
+	char	*cmd = new char[MAXPIPE*14+2], *ptr;
+	int	nsent = 0, rdaddr;
+	BUSW	lastaddr;
+
+	DBGPRINTF("PIPELINE(#%d)\n", nops);
+
+	// Check our alignment before anything goes out
+	for(int i=0; i<nops; i++)
+		if (ops[i].m_addr & 3) {
+			delete[] cmd;
+			throw BUSERR(ops[i].m_addr);
+		}
+
+	while(nsent < nops) {
+		int	ln = nops-nsent;
+		if (ln > MAXPIPE)
+			ln = MAXPIPE;
+
+		// encode_address() resets our copy of the read compression
+		// table, assuming the read will follow right away.  Here, the
+		// reads (and the resets) only happen as the results arrive.
+		rdaddr = m_rdaddr;
+		ptr = cmd;
+		for(int i=nsent; i<nsent+ln; i++) {
+			char	*aend = encode_address(ops[i].m_addr);
+
+			memcpy(ptr, m_buf, aend-m_buf);
+			ptr += aend-m_buf;
+			m_lastaddr = ops[i].m_addr; m_addr_set = true;
+
+			if (ops[i].m_wr)
+				ptr = encode_write(ptr, ops[i].m_data, 0);
+			else
+				ptr = readcmd(0, 1, ptr);
+		}
+		*ptr++ = '\n'; *ptr = '\0';
+		m_dev->write(cmd, ptr-cmd);
+		DBGPRINTF(">> %s\n", cmd);
+		m_rdaddr = rdaddr;
+
+		// The address confirmations that come back with each read will
+		// move m_lastaddr around.  Where we left it is where the bus
+		// will end up.
+		lastaddr = m_lastaddr;
+		for(int i=nsent; i<nsent+ln; i++) {
+			if (ops[i].m_wr)
+				continue;
+			try {
+				ops[i].m_data = readword();
+				ops[i].m_err  = false;
+			} catch(BUSERR b) {
+				DBGPRINTF("PIPELINE::BUSERR reading %08x\n", ops[i].m_addr);
+				ops[i].m_err  = true;
+			}
+		} m_lastaddr = lastaddr;
+
+		nsent += ln;
+	}
+
+	delete[] cmd;
+
+	// Clear out the acknowledgements of any trailing writes
+	readidle();
+}
+
 /*
  * readword()
  *
@@ -649,6 +742,9 @@ TTYBUS::BUSW	TTYBUS::readword(void) {
 
 			m_addr_set = true;
 			m_lastaddr = val<<2;
+			// The bus resets its compression table with every
+			// address it sends
+			m_rdaddr = 0;
 
 			DBGPRINTF("RCVD ADDR: 0x%08x\n", val<<2);
 		} else if (0x0c == (sixbits & 0x03c)) { // Set 32-bit address,compressed
@@ -675,6 +771,7 @@ TTYBUS::BUSW	TTYBUS::readword(void) {
 
 			m_addr_set = true;
 			m_lastaddr = val<<2;
+			m_rdaddr = 0;
 			DBGPRINTF("RCVD ADDR: 0x%08x (%d bytes)\n", val<<2, nw+1);
 		} else
 			found_start = true;
@@ -102,6 +102,7 @@ private:
 	int	lclread(char *buf, int len);
 	int	lclreadcode(char *buf, int len);
 	char	*encode_address(const BUSW a);
+	char	*encode_write(char *ptr, const BUSW val, const int p);
 	char	*readcmd(const int inc, const int len, char *buf);
 public:
 	TTYBUS(LLCOMMSI *comms) : m_dev(comms) { init(); }
@@ -120,6 +121,7 @@ public:
 	void	readz( const BUSW a, const int len, BUSW *buf);
 	void	writei(const BUSW a, const int len, const BUSW *buf);
 	void	writez(const BUSW a, const int len, const BUSW *buf);
+	void	pipeline(const int nops, BUSOP *ops);
 	bool	poll(void) { return m_interrupt_flag; };
 	void	usleep(unsigned msec); // Sleep until interrupt
 	void	wait(void); // Sleep until interrupt
@@ -8,6 +8,17 @@
 //		and write wishbone registers one at a time.  Thus this program
 //	implements readio() and writeio() but nothing more.
 //
+//	Given a script, with -f, it will instead run a whole list of such
+//	operations over the one connection.  Runs of reads and writes go out
+//	together, in one pipeline(), so a script of a hundred register
+//	writes costs about as much as one.  See usage() for the script's
+//	format.
+//
+//	With -r, it instead monitors a list of registers, reading them all
+//	in one pipeline() at the rate given, or as close to it as the link
+//	allows.  Each sample is written out with a timestamp, as CSV or (-b)
+//	binary, and a summary of each register follows once done.
+//
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -46,9 +57,11 @@
 #include <string.h>
 #include <signal.h>
 #include <assert.h>
+#include <time.h>
 
 #include "port.h"
 #include "regdefs.h"
+#include "symtab.h"
 #include "ttybus.h"
 
 FPGA	*m_fpga;
@@ -76,71 +89,412 @@ bool	isvalue(const char *v) {
 	return (isdigit(*ptr));
 }
 
-unsigned getmap_address(const char *map_fname, const char *name) {
-	FILE	*fmp = fopen(map_fname, "r");
-	char	line[512];
+//
+// The map file is read once, the first time it's needed, and then kept
+//
+static	SYMTAB	*gbl_map = NULL;
 
-	if (NULL == fmp) {
-		fprintf(stderr, "ERR: Could not open MAP file, %s\n", map_fname);
-		exit(EXIT_FAILURE);
+static	SYMTAB	*loadmap(const char *map_fname) {
+	if (!gbl_map) {
+		gbl_map = new SYMTAB;
+		gbl_map->loadmap(map_fname);
 	}
 
-	while(fgets(line, sizeof(line), fmp)) {
-		char	*astr, *nstr, *xstr;
+	return gbl_map;
+}
 
-		astr = strtok(line, " \t\n");
-		if (!astr)
-			continue;
-		nstr = strtok(NULL, " \t\n");
-		if (!nstr)
-			continue;
-		xstr = strtok(NULL, " \t\n");
-		if (xstr)
+//
+// Turns a register name, or number, into an address, and the name to list
+// it by
+//
+void	lookup(const char *map_file, const char *named_address,
+		unsigned &address, const char *&nm) {
+	nm = NULL;
+	if (isvalue(named_address)) {
+		address = strtoul(named_address, NULL, 0);
+		if (map_file)
+			nm = loadmap(map_file)->name(address);
+		if (nm == NULL)
+			nm = addrname(address);
+	} else {
+		int	k = (map_file) ? loadmap(map_file)->find(named_address) : -1;
+
+		if (k >= 0) {
+			address = (*gbl_map)[k].m_addr;
+			nm = gbl_map->name(address);
+		} else {
+			address = addrdecode(named_address);
+			nm = addrname(address);
+		}
+	}
+}
+
+void	showread(unsigned address, const char *nm, unsigned v, bool use_decimal) {
+	unsigned char a, b, c, d;
+
+	a = (v>>24)&0x0ff;
+	b = (v>>16)&0x0ff;
+	c = (v>> 8)&0x0ff;
+	d = (v    )&0x0ff;
+	if (use_decimal)
+		printf("%d\n", v);
+	else
+	printf("%08x (%8s) : [%c%c%c%c] %08x\n", address, nm, 
+		isgraph(a)?a:'.', isgraph(b)?b:'.',
+		isgraph(c)?c:'.', isgraph(d)?d:'.', v);
+}
+
+//
+// Scripts
+//
+typedef	enum	{ OP_READ, OP_WRITE, OP_DUMP, OP_POLL, OP_DELAY } OPTYPE;
+
+class	SCRIPTOP {
+public:
+	OPTYPE		m_op;
+	int		m_line;
+	unsigned	m_addr,
+			m_value,	// To write, or to poll for
+			m_mask,		// Bits of the poll value to compare
+			m_count;	// Words to dump, or milliseconds to wait
+	const char	*m_name;
+	char		*m_file;	// Where to dump to
+};
+
+#define	POLL_TIMEOUT	1000	// Default, in milliseconds
+#define	DUMP_CHUNK	1024	// Words per readi() when dumping
+
+//
+// Reads the whole script before anything is run, so that a mistake on its
+// last line won't leave the board half set up
+//
+int	readscript(FILE *fp, const char *map_file, SCRIPTOP *&ops) {
+	char	line[512];
+	int	nops = 0, nalloc = 64, ln = 0;
+
+	ops = (SCRIPTOP *)malloc(nalloc * sizeof(SCRIPTOP));
+	while(fgets(line, sizeof(line), fp)) {
+		char		*tok[6], *cmt;
+		int		ntok = 0;
+		SCRIPTOP	*op;
+
+		ln++;
+		if ((cmt = strchr(line, '#')) != NULL)
+			*cmt = '\0';
+		for(char *t = strtok(line, " \t\n"); (t)&&(ntok < 6);
+				t = strtok(NULL, " \t\n"))
+			tok[ntok++] = t;
+		if (ntok == 0)
 			continue;
-		if (!isvalue(astr))
+
+		if (nops >= nalloc) {
+			nalloc *= 2;
+			ops = (SCRIPTOP *)realloc(ops, nalloc * sizeof(SCRIPTOP));
+		}
+		op = &ops[nops];
+		op->m_line  = ln;
+		op->m_value = 0;
+		op->m_mask  = 0xffffffff;
+		op->m_count = 0;
+		op->m_name  = NULL;
+		op->m_file  = NULL;
+		op->m_addr  = 0;
+
+		if (strcasecmp(tok[0], "dump")==0) {
+			if (ntok != 4) {
+				fprintf(stderr, "ERR: Line %d, expected dump <address> <count> <file>\n", ln);
+				exit(EXIT_FAILURE);
+			}
+			op->m_op = OP_DUMP;
+			lookup(map_file, tok[1], op->m_addr, op->m_name);
+			op->m_count = strtoul(tok[2], NULL, 0);
+			op->m_file  = strdup(tok[3]);
+		} else if (strcasecmp(tok[0], "poll")==0) {
+			if ((ntok < 3)||(ntok > 5)) {
+				fprintf(stderr, "ERR: Line %d, expected poll <address> <value> [<mask> [<timeout-ms>]]\n", ln);
+				exit(EXIT_FAILURE);
+			}
+			op->m_op = OP_POLL;
+			lookup(map_file, tok[1], op->m_addr, op->m_name);
+			op->m_value = strtoul(tok[2], NULL, 0);
+			if (ntok > 3)
+				op->m_mask = strtoul(tok[3], NULL, 0);
+			op->m_count = (ntok > 4) ? strtoul(tok[4], NULL, 0)
+					: POLL_TIMEOUT;
+		} else if (strcasecmp(tok[0], "delay")==0) {
+			if (ntok != 2) {
+				fprintf(stderr, "ERR: Line %d, expected delay <ms>\n", ln);
+				exit(EXIT_FAILURE);
+			}
+			op->m_op = OP_DELAY;
+			op->m_count = strtoul(tok[1], NULL, 0);
+		} else if (ntok <= 2) {
+			op->m_op = (ntok == 2) ? OP_WRITE : OP_READ;
+			lookup(map_file, tok[0], op->m_addr, op->m_name);
+			if (ntok == 2) {
+				if (!isvalue(tok[1])) {
+					fprintf(stderr, "ERR: Line %d, %s is not a value\n", ln, tok[1]);
+					exit(EXIT_FAILURE);
+				}
+				op->m_value = strtoul(tok[1], NULL, 0);
+			}
+		} else {
+			fprintf(stderr, "ERR: Line %d, unknown command %s\n", ln, tok[0]);
+			exit(EXIT_FAILURE);
+		}
+		nops++;
+	}
+
+	return nops;
+}
+
+static unsigned
+now_ms(void) {
+	struct	timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+//
+// Runs the script.  Each run of reads and writes goes out as one pipeline.
+// Polls, dumps, and delays run on their own, in between.  Returns non-zero
+// if a poll timed out, or a dump failed.
+//
+int	runscript(DEVBUS *fpga, int nops, SCRIPTOP *ops, bool use_decimal) {
+	for(int i=0; i<nops; ) {
+		SCRIPTOP	*op = &ops[i];
+
+		if ((op->m_op == OP_READ)||(op->m_op == OP_WRITE)) {
+			int	n = 0;
+			BUSOP	*bops;
+
+			while((i+n < nops)&&((ops[i+n].m_op == OP_READ)
+					||(ops[i+n].m_op == OP_WRITE)))
+				n++;
+
+			bops = new BUSOP[n];
+			for(int k=0; k<n; k++) {
+				if (op[k].m_op == OP_WRITE)
+					bops[k] = BUSOP(op[k].m_addr,
+							op[k].m_value);
+				else
+					bops[k] = BUSOP(op[k].m_addr);
+			}
+			fpga->pipeline(n, bops);
+
+			for(int k=0; k<n; k++) {
+				if (op[k].m_op == OP_WRITE)
+					printf("%08x (%8s)-> %08x\n",
+						op[k].m_addr, op[k].m_name,
+						op[k].m_value);
+				else if (bops[k].m_err)
+					printf("%08x (%8s) : BUS-ERROR\n",
+						op[k].m_addr, op[k].m_name);
+				else
+					showread(op[k].m_addr, op[k].m_name,
+						bops[k].m_data, use_decimal);
+			}
+			delete[] bops;
+			i += n;
 			continue;
-		if (0 == strcasecmp(nstr, name))
-			return strtoul(astr, NULL, 0);
+		}
+
+		switch(op->m_op) {
+		case OP_DUMP: {
+			FILE		*fp = fopen(op->m_file, "wb");
+			unsigned	buf[DUMP_CHUNK];
+			unsigned char	bytes[4*DUMP_CHUNK];
+
+			if (!fp) {
+				fprintf(stderr, "ERR: Line %d, could not open %s\n",
+					op->m_line, op->m_file);
+				return 1;
+			}
+			try {
+				for(unsigned k=0; k<op->m_count; k+=DUMP_CHUNK) {
+					unsigned ln = op->m_count - k;
+					if (ln > DUMP_CHUNK)
+						ln = DUMP_CHUNK;
+					fpga->readi(op->m_addr+4*k, ln, buf);
+					// Bytes in bus (big endian) order
+					for(unsigned j=0; j<ln; j++) {
+						bytes[4*j  ] = buf[j] >> 24;
+						bytes[4*j+1] = buf[j] >> 16;
+						bytes[4*j+2] = buf[j] >>  8;
+						bytes[4*j+3] = buf[j];
+					}
+					fwrite(bytes, 4, ln, fp);
+				}
+			} catch(BUSERR b) {
+				fclose(fp);
+				fprintf(stderr, "ERR: Line %d, BUS-ERROR at %08x\n",
+					op->m_line, b.addr);
+				return 1;
+			}
+			fclose(fp);
+			printf("%08x (%8s) : %u words to %s\n", op->m_addr,
+				op->m_name, op->m_count, op->m_file);
+			} break;
+		case OP_POLL: {
+			unsigned	start = now_ms(), v, nreads = 0;
+
+			while(1) {
+				v = fpga->readio(op->m_addr);
+				nreads++;
+				if ((v & op->m_mask) == op->m_value)
+					break;
+				if (now_ms() - start >= op->m_count) {
+					fprintf(stderr, "ERR: Line %d, timed out waiting for %08x (%s) & %08x == %08x, last read %08x\n",
+						op->m_line, op->m_addr,
+						op->m_name, op->m_mask,
+						op->m_value, v);
+					return 1;
+				}
+			}
+			showread(op->m_addr, op->m_name, v, use_decimal);
+			} break;
+		case OP_DELAY:
+			usleep(op->m_count * 1000);
+			break;
+		default:
+			break;
+		}
+		i++;
 	}
-	
-	fclose(fmp);
+
 	return 0;
 }
 
-char	*getmap_name(const char *map_fname, const unsigned val) {
-	if (!map_fname)
-		return NULL;
-	FILE	*fmp = fopen(map_fname, "r");
-	char	line[512];
-	if (NULL == fmp) {
-		fprintf(stderr, "ERR: Could not open MAP file, %s\n", map_fname);
-		exit(EXIT_FAILURE);
+//
+// Monitoring
+//
+#define	MAXMON		64	// Most registers we'll monitor at once
+
+bool	gbl_stop = false;
+
+void	stop_monitor(int v) {
+	gbl_stop = true;
+}
+
+static unsigned long
+now_us(void) {
+	struct	timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ul + ts.tv_nsec / 1000;
+}
+
+static void
+putle(FILE *fp, unsigned long v, int nbytes) {
+	for(int k=0; k<nbytes; k++, v >>= 8)
+		fputc(v & 0x0ff, fp);
+}
+
+//
+// Reads all nregs registers, in one pipeline, rate times a second--or as
+// often as the link allows, if that's less.  Should we fall behind, we
+// pick up from the next sample time, rather than rushing to catch up.
+//
+void	monitor(DEVBUS *fpga, int nregs, const unsigned *addr,
+		const char **names, double rate, unsigned long nsamples,
+		FILE *fp, bool binary) {
+	BUSOP		ops[MAXMON];
+	unsigned	vmin[MAXMON], vmax[MAXMON], vfirst[MAXMON],
+			vlast[MAXMON], ngood[MAXMON], nerr[MAXMON];
+	unsigned long	period = (unsigned long)(1e6 / rate), start, next,
+			t = 0, tfirst = 0, taken = 0;
+
+	if (!binary) {
+		fprintf(fp, "time");
+		for(int k=0; k<nregs; k++)
+			fprintf(fp, ",%s", names[k]);
+		fprintf(fp, "\n");
 	}
 
-	while(fgets(line, sizeof(line), fmp)) {
-		char	*astr, *nstr, *xstr;
+	for(int k=0; k<nregs; k++)
+		ngood[k] = nerr[k] = 0;
 
-		astr = strtok(line, " \t\n");
-		if (!astr)
-			continue;
-		nstr = strtok(NULL, " \t\n");
-		if (!nstr)
-			continue;
-		xstr = strtok(NULL, " \t\n");
-		if (xstr)
-			continue;
-		if (!isvalue(astr))
+	start = next = now_us();
+	while((!gbl_stop)&&((nsamples == 0)||(taken < nsamples))) {
+		unsigned long	before, after;
+
+		for(int k=0; k<nregs; k++)
+			ops[k] = BUSOP(addr[k]);
+
+		before = now_us();
+		fpga->pipeline(nregs, ops);
+		after = now_us();
+		// Time stamp each sample by the middle of its round trip
+		t = (before + after)/2 - start;
+		if (taken == 0)
+			tfirst = t;
+
+		if (binary)
+			putle(fp, t, 8);
+		else
+			fprintf(fp, "%lu.%06lu", t / 1000000, t % 1000000);
+		for(int k=0; k<nregs; k++) {
+			unsigned	v = ops[k].m_data;
+
+			if (ops[k].m_err) {
+				nerr[k]++;
+				v = 0;
+			} else {
+				if (ngood[k]++ == 0)
+					vmin[k] = vmax[k] = vfirst[k] = v;
+				if (v < vmin[k]) vmin[k] = v;
+				if (v > vmax[k]) vmax[k] = v;
+				vlast[k] = v;
+			}
+
+			if (binary)
+				putle(fp, v, 4);
+			else if (ops[k].m_err)
+				fprintf(fp, ",ERR");
+			else
+				fprintf(fp, ",0x%08x", v);
+		}
+		if (!binary)
+			fprintf(fp, "\n");
+		taken++;
+
+		next += period;
+		after = now_us();
+		if (next > after)
+			usleep(next - after);
+		else
+			next = after;
+	}
+	fflush(fp);
+
+	if (taken == 0)
+		return;
+
+	t -= tfirst;
+	fprintf(stderr, "%lu samples in %.3f seconds, %.1f per second\n",
+		taken, t * 1e-6, (t > 0) ? (taken-1) * 1e6 / t : 0.0);
+	fprintf(stderr, "%-12s %10s %10s %10s %10s %12s %6s\n", "Register",
+		"First", "Last", "Min", "Max", "Delta/sec", "Errs");
+	for(int k=0; k<nregs; k++) {
+		// Delta as a signed 32-bit difference, so counters may wrap
+		int	delta = (int)(vlast[k] - vfirst[k]);
+
+		if (ngood[k] == 0) {
+			fprintf(stderr, "%-12s %-56s %6u\n", names[k],
+				"(No valid samples)", nerr[k]);
 			continue;
-		if (strtoul(astr, NULL, 0) == val)
-			return strdup(nstr);
+		}
+		fprintf(stderr, "%-12s 0x%08x 0x%08x 0x%08x 0x%08x %12.1f %6u\n",
+			names[k], vfirst[k], vlast[k], vmin[k], vmax[k],
+			(t > 0) ? delta * 1e6 / t : 0.0, nerr[k]);
 	}
-	
-	fclose(fmp);
-	return NULL;
 }
 
 void	usage(void) {
-	printf("USAGE: wbregs [-d] address [value]\n"
+	printf("USAGE: wbregs [-d] [-m mapfile] address [value]\n"
+"       wbregs [-d] [-m mapfile] -f script\n"
+"       wbregs [-m mapfile] -r rate [-n count] [-b] [-o file] address ...\n"
 "\n"
 "\tWBREGS stands for Wishbone registers.  It is designed to allow a\n"
 "\tuser to peek and poke at registers within a given FPGA design, so\n"
@@ -156,13 +510,39 @@ void	usage(void) {
 "\n"
 "\tIf a value is given, that value will be written to the indicated\n"
 "\taddress, otherwise the result from reading the address will be \n"
-"\twritten to the screen.\n");
+"\twritten to the screen.\n"
+"\n"
+"\t-f script\tRuns each line of the script, or of stdin if it's -,\n"
+"\t\tover a single connection.  Each line is one of:\n"
+"\n"
+"\t\taddress [value]\tRead, or write, as above\n"
+"\t\tdump address count file\n"
+"\t\t\t\tRead count words from address on, into a file\n"
+"\t\tpoll address value [mask [timeout]]\n"
+"\t\t\t\tRead until (address & mask) == value, failing\n"
+"\t\t\t\tafter timeout ms (default %d)\n"
+"\t\tdelay ms\tWait\n"
+"\n"
+"\t\tAnything following a # is a comment.  Consecutive reads and\n"
+"\t\twrites are sent together.\n"
+"\n"
+"\t-r rate\tMonitors the addresses given, reading them all rate times a\n"
+"\t\tsecond, or as often as the link allows, until count (-n)\n"
+"\t\tsamples have been taken or it's interrupted.  Each sample is\n"
+"\t\twritten, to stdout or to the file given by -o, as a line of CSV:\n"
+"\t\tthe time in seconds, then each value.  With -b, each is instead\n"
+"\t\ta binary record: a 64-bit time in microseconds, then a 32-bit\n"
+"\t\tword per address, all little endian.  A summary of each address\n"
+"\t\tfollows, on stderr.\n", POLL_TIMEOUT);
 }
 
 int main(int argc, char **argv) {
 	int	skp=0;
 	bool	use_decimal = false;
-	char	*map_file = NULL;
+	bool	binary = false;
+	char	*map_file = NULL, *script = NULL, *out_file = NULL;
+	double	rate = 0;
+	unsigned long	nsamples = 0;
 
 	skp=1;
 	for(int argn=0; argn<argc-skp; argn++) {
@@ -175,7 +555,41 @@ int main(int argc, char **argv) {
 					exit(EXIT_SUCCESS);
 				}
 				map_file = argv[argn+skp+1];
-				skp++; argn--;
+				skp++;
+			} else if (argv[argn+skp][1] == 'f') {
+				if (argn+skp+1 >= argc) {
+					fprintf(stderr, "ERR: No script given\n");
+					exit(EXIT_FAILURE);
+				}
+				script = argv[argn+skp+1];
+				skp++;
+			} else if (argv[argn+skp][1] == 'r') {
+				if (argn+skp+1 >= argc) {
+					fprintf(stderr, "ERR: No sample rate given\n");
+					exit(EXIT_FAILURE);
+				}
+				rate = atof(argv[argn+skp+1]);
+				if (rate <= 0) {
+					fprintf(stderr, "ERR: Bad sample rate, %s\n", argv[argn+skp+1]);
+					exit(EXIT_FAILURE);
+				}
+				skp++;
+			} else if (argv[argn+skp][1] == 'n') {
+				if (argn+skp+1 >= argc) {
+					fprintf(stderr, "ERR: No sample count given\n");
+					exit(EXIT_FAILURE);
+				}
+				nsamples = strtoul(argv[argn+skp+1], NULL, 0);
+				skp++;
+			} else if (argv[argn+skp][1] == 'o') {
+				if (argn+skp+1 >= argc) {
+					fprintf(stderr, "ERR: No output file given\n");
+					exit(EXIT_FAILURE);
+				}
+				out_file = argv[argn+skp+1];
+				skp++;
+			} else if (argv[argn+skp][1] == 'b') {
+				binary = true;
 			} else {
 				usage();
 				exit(EXIT_SUCCESS);
@@ -185,6 +599,79 @@ int main(int argc, char **argv) {
 			argv[argn] = argv[argn+skp];
 	} argc -= skp;
 
+	if ((map_file)&&(access(map_file, R_OK)!=0)) {
+		fprintf(stderr, "ERR: Cannot open/read map file, %s\n", map_file);
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	}
+
+	if (script) {
+		SCRIPTOP	*ops;
+		FILE		*fp;
+		int		nops, r;
+
+		if (strcmp(script, "-")==0)
+			fp = stdin;
+		else if ((fp = fopen(script, "r")) == NULL) {
+			fprintf(stderr, "ERR: Cannot open script, %s\n", script);
+			exit(EXIT_FAILURE);
+		}
+		nops = readscript(fp, map_file, ops);
+		if (fp != stdin)
+			fclose(fp);
+
+		FPGAOPEN(m_fpga);
+		signal(SIGSTOP, closeup);
+		signal(SIGHUP, closeup);
+
+		r = runscript(m_fpga, nops, ops, use_decimal);
+		if (m_fpga->poll())
+			printf("FPGA was interrupted\n");
+		delete	m_fpga;
+		exit((r) ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+
+	if (rate > 0) {
+		unsigned	*addr;
+		const char	**names;
+		FILE		*fp = stdout;
+
+		if ((argc < 1)||(argc > MAXMON)) {
+			fprintf(stderr, "ERR: Monitor between 1 and %d registers\n", MAXMON);
+			exit(EXIT_FAILURE);
+		}
+
+		addr  = new unsigned[argc];
+		names = new const char *[argc];
+		for(int k=0; k<argc; k++) {
+			lookup(map_file, argv[k], addr[k], names[k]);
+			// Label columns as the user named them
+			if (!isvalue(argv[k]))
+				names[k] = argv[k];
+			else if (names[k] == NULL)
+				names[k] = argv[k];
+		}
+
+		if ((out_file)&&((fp = fopen(out_file, (binary)?"wb":"w"))==NULL)) {
+			fprintf(stderr, "ERR: Cannot open %s\n", out_file);
+			exit(EXIT_FAILURE);
+		}
+
+		FPGAOPEN(m_fpga);
+		signal(SIGSTOP, closeup);
+		signal(SIGHUP, closeup);
+		signal(SIGINT, stop_monitor);
+
+		monitor(m_fpga, argc, addr, names, rate, nsamples, fp, binary);
+
+		if (fp != stdout)
+			fclose(fp);
+		delete[] addr;
+		delete[] names;
+		delete	m_fpga;
+		exit(EXIT_SUCCESS);
+	}
+
 	FPGAOPEN(m_fpga);
 
 	signal(SIGSTOP, closeup);
@@ -196,48 +683,16 @@ int main(int argc, char **argv) {
 		exit(-1);
 	}
 
-	if ((map_file)&&(access(map_file, R_OK)!=0)) {
-		fprintf(stderr, "ERR: Cannot open/read map file, %s\n", map_file);
-		perror("O/S Err:");
-		exit(EXIT_FAILURE);
-	}
-
 	const char *nm = NULL, *named_address = argv[0];
 	unsigned address, value;
 
-	if (isvalue(named_address)) {
-		address = strtoul(named_address, NULL, 0);
-		if (map_file)
-			nm = getmap_name(map_file, address);
-		if (nm == NULL)
-			nm = addrname(address);
-	} else if (map_file) {
-		address = getmap_address(map_file, named_address);
-		nm = getmap_name(map_file, address);
-		if (!nm) {
-			address = addrdecode(named_address);
-			nm = addrname(address);
-		}
-	} else {
-		address = addrdecode(named_address);
-		nm = addrname(address);
-	}
+	lookup(map_file, named_address, address, nm);
 
 	if (argc < 2) {
 		FPGA::BUSW	v;
 		try {
-			unsigned char a, b, c, d;
 			v = m_fpga->readio(address);
-			a = (v>>24)&0x0ff;
-			b = (v>>16)&0x0ff;
-			c = (v>> 8)&0x0ff;
-			d = (v    )&0x0ff;
-			if (use_decimal)
-				printf("%d\n", v);
-			else
-			printf("%08x (%8s) : [%c%c%c%c] %08x\n", address, nm, 
-				isgraph(a)?a:'.', isgraph(b)?b:'.',
-				isgraph(c)?c:'.', isgraph(d)?d:'.', v);
+			showread(address, nm, v, use_decimal);
 		} catch(BUSERR b) {
 			printf("%08x (%8s) : BUS-ERROR\n", address, nm);
 		}
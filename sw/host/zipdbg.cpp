@@ -56,6 +56,9 @@
 #include "devbus.h"
 #include "regdefs.h"
 #include "ttybus.h"
+#include "zipsnap.h"
+#include "zipelf.h"
+#include "symtab.h"
 
 #include "port.h"
 
@@ -71,28 +74,7 @@
 #define	KEY_RETURN	10
 #define	CTRL(X)		((X)&0x01f)
 
-class	SPARSEMEM {
-public:
-	bool	m_valid;
-	unsigned int	m_a, m_d;
-};
-
 bool	gbl_err = false;
-class	ZIPSTATE {
-public:
-	bool		m_valid, m_gie, m_last_pc_valid;
-	unsigned int	m_sR[16], m_uR[16];
-	unsigned int	m_p[20];
-	unsigned int	m_last_pc, m_pc, m_sp;
-	SPARSEMEM	m_smem[5];
-	SPARSEMEM	m_imem[5];
-	ZIPSTATE(void) : m_valid(false), m_last_pc_valid(false) {}
-
-	void	step(void) {
-		m_last_pc_valid = true;
-		m_last_pc = m_pc;
-	}
-};
 
 // No particular "parameters" need definition or redefinition here.
 class	ZIPPY : public DEVBUS {
@@ -102,85 +84,42 @@ class	ZIPPY : public DEVBUS {
 	int	m_cursor;
 	ZIPSTATE	m_state;
 	bool	m_user_break, m_show_users_timers, m_show_cc;
+	// True once the CPU might have changed since we last read it
+	bool	m_stale;
+	// Symbols, if any, to show where the PC is
+	SYMTAB	*m_syms;
 public:
-	ZIPPY(DEVBUS *fpga) : m_fpga(fpga), m_cursor(0), m_user_break(false),
-		m_show_users_timers(false), m_show_cc(false) {}
+	ZIPPY(DEVBUS *fpga, SYMTAB *syms = NULL) : m_fpga(fpga), m_cursor(0),
+		m_user_break(false), m_show_users_timers(false),
+		m_show_cc(false), m_stale(true), m_syms(syms) {}
 
 	void	read_raw_state(void) {
-		m_state.m_valid = false;
-		for(int i=0; i<16; i++)
-			m_state.m_sR[i] = cmd_read(i);
-		for(int i=0; i<16; i++)
-			m_state.m_uR[i] = cmd_read(i+16);
-		for(int i=0; i<20; i++)
-			m_state.m_p[i]  = cmd_read(i+32);
-
-		m_state.m_gie = (m_state.m_sR[14] & 0x020);
-		m_state.m_pc  = (m_state.m_gie) ? (m_state.m_uR[15]):(m_state.m_sR[15]);
-		m_state.m_sp  = (m_state.m_gie) ? (m_state.m_uR[13]):(m_state.m_sR[13]);
-
-		if (m_state.m_last_pc_valid)
-			m_state.m_imem[0].m_a = m_state.m_last_pc;
-		else
-			m_state.m_imem[0].m_a = m_state.m_pc - 4;
-		try {
-			m_state.m_imem[0].m_d = readio(m_state.m_imem[0].m_a);
-			m_state.m_imem[0].m_valid = true;
-		} catch(BUSERR be) {
-			m_state.m_imem[0].m_valid = false;
-		}
-		m_state.m_imem[1].m_a = m_state.m_pc;
-		try {
-			m_state.m_imem[1].m_d = readio(m_state.m_imem[1].m_a);
-			m_state.m_imem[1].m_valid = true;
-		} catch(BUSERR be) {
-			m_state.m_imem[1].m_valid = false;
-		}
+		zipsnap(m_fpga, m_state);
+		m_stale = false;
+	}
 
-		for(int i=1; i<4; i++) {
-			if (!m_state.m_imem[i].m_valid) {
-				m_state.m_imem[i+1].m_valid = false;
-				m_state.m_imem[i+1].m_a = m_state.m_imem[i].m_a+4;
-				continue;
-			}
-			m_state.m_imem[i+1].m_a = zop_early_branch(
-					m_state.m_imem[i].m_a,
-					m_state.m_imem[i].m_d);
-			try {
-				m_state.m_imem[i+1].m_d = readio(m_state.m_imem[i+1].m_a);
-				m_state.m_imem[i+1].m_valid = true;
-			} catch(BUSERR be) {
-				m_state.m_imem[i+1].m_valid = false;
-			}
-		}
+	bool	stale(void) const { return m_stale; }
+	unsigned	ntrips(void) const { return m_state.m_ntrips; }
 
-		m_state.m_smem[0].m_a = m_state.m_sp;
-		for(int i=1; i<5; i++)
-			m_state.m_smem[i].m_a = m_state.m_smem[i-1].m_a+4;
-		for(int i=0; i<5; i++) {
-			m_state.m_smem[i].m_valid = true;
-			if (m_state.m_smem[i].m_valid)
-			try {
-				m_state.m_smem[i].m_d = readio(m_state.m_smem[i].m_a);
-				m_state.m_smem[i].m_valid = true;
-			} catch(BUSERR be) {
-				m_state.m_smem[i].m_valid = false;
-			}
-		}
-		m_state.m_valid = true;
-	}
+	// Forget every instruction word we've cached, and read everything
+	// again on the next refresh
+	void	flush(void) { m_state.flush(); m_stale = true; }
 
 	void	kill(void) { m_fpga->kill(); }
 	void	close(void) { m_fpga->close(); }
-	void	writeio(const BUSW a, const BUSW v) { m_fpga->writeio(a, v); }
+	void	writeio(const BUSW a, const BUSW v) {
+		m_state.invalidate(a, 1); m_stale = true;
+		m_fpga->writeio(a, v); }
 	BUSW	readio(const BUSW a) { return m_fpga->readio(a); }
 	void	readi(const BUSW a, const int len, BUSW *buf) {
 		return m_fpga->readi(a, len, buf); }
 	void	readz(const BUSW a, const int len, BUSW *buf) {
 		return m_fpga->readz(a, len, buf); }
 	void	writei(const BUSW a, const int len, const BUSW *buf) {
+		m_state.invalidate(a, len); m_stale = true;
 		return m_fpga->writei(a, len, buf); }
 	void	writez(const BUSW a, const int len, const BUSW *buf) {
+		m_state.invalidate(a, 1); m_stale = true;
 		return m_fpga->writez(a, len, buf); }
 	bool	poll(void) { return m_fpga->poll(); }
 	void	usleep(unsigned ms) { m_fpga->usleep(ms); }
@@ -189,9 +128,11 @@ public:
 	void	reset_err(void) { m_fpga->reset_err(); }
 	void	clear(void) { m_fpga->clear(); }
 
-	void	reset(void) { writeio(R_ZIPCTRL, CPU_RESET|CPU_HALT); }
+	// Once it's been released, the CPU can write anywhere--code included
+	void	reset(void) { release(); writeio(R_ZIPCTRL, CPU_RESET|CPU_HALT); }
 	void	step(void) { writeio(R_ZIPCTRL, CPU_STEP); m_state.step(); }
-	void	go(void) { writeio(R_ZIPCTRL, CPU_GO); }
+	void	go(void) { release(); writeio(R_ZIPCTRL, CPU_GO); }
+	void	release(void) { flush(); m_state.m_last_pc_valid = false; }
 	void	halt(void) {	writeio(R_ZIPCTRL, CPU_HALT); }
 	bool	stalled(void) { return ((readio(R_ZIPCTRL)&CPU_STALL)==0); }
 
@@ -263,34 +204,6 @@ public:
 		attroff(A_BOLD);
 	}
 
-	unsigned int	cmd_read(unsigned int a) {
-		int errcount = 0;
-		unsigned int	s;
-
-		writeio(R_ZIPCTRL, CMD_HALT|(a&0x3f));
-		while((((s=readio(R_ZIPCTRL))&CPU_STALL)== 0)&&(errcount<MAXERR)
-				&&(!m_user_break))
-			errcount++;
-		if (m_user_break) {
-			endwin();
-			exit(EXIT_SUCCESS);
-		} else if (errcount >= MAXERR) {
-			endwin();
-			printf("ERR: errcount(%d) >= MAXERR on cmd_read(a=%2x)\n", errcount, a);
-			printf("ZIPCTRL = 0x%08x", s);
-			if ((s & 0x0200)==0) printf(" STALL");
-			if  (s & 0x0400) printf(" HALTED");
-			if ((s & 0x03000)==0x01000)
-				printf(" SW-HALT");
-			else {
-				if (s & 0x01000) printf(" SLEEPING");
-				if (s & 0x02000) printf(" GIE(UsrMode)");
-			} printf("\n");
-			exit(EXIT_FAILURE);
-		}
-		return readio(R_ZIPDATA);
-	}
-
 	void	cmd_write(unsigned int a, int v) {
 		int errcount = 0;
 		unsigned int	s;
@@ -304,7 +217,7 @@ public:
 			exit(EXIT_SUCCESS);
 		} else if (errcount >= MAXERR) {
 			endwin();
-			printf("ERR: errcount(%d) >= MAXERR on cmd_read(a=%2x)\n", errcount, a);
+			printf("ERR: errcount(%d) >= MAXERR on cmd_write(a=%2x)\n", errcount, a);
 			printf("ZIPCTRL = 0x%08x", s);
 			if ((s & 0x0200)==0) printf(" STALL");
 			if  (s & 0x0400) printf(" HALTED");
@@ -321,11 +234,15 @@ public:
 	}
 
 	void	read_state(void) {
+		read_raw_state();
+		draw_state();
+	}
+
+	// Draws the state last read, without touching the bus
+	void	draw_state(void) {
 		int	ln= 0;
 		bool	gie;
 
-		read_raw_state();
-
 		if (m_cursor < 0)
 			m_cursor = 0;
 		else if (m_cursor >= 44)
@@ -334,7 +251,7 @@ public:
 		mvprintw(ln,0, "Peripherals");
 		mvprintw(ln,30,"%-50s", "CPU State: ");
 		{
-			unsigned int v = readio(R_ZIPCTRL);
+			unsigned int v = m_state.m_ctrl;
 			mvprintw(ln,41, "0x%08x ", v);
 			// if (v & 0x010000)
 				// printw("INT ");
@@ -379,6 +296,14 @@ public:
 		}
 
 		ln++;
+		if (m_syms) {
+			int	s = m_syms->nearest(m_state.m_pc, true);
+
+			mvprintw(ln, 0, "%-79s", "");
+			if (s >= 0)
+				mvprintw(ln,30, "PC: %s+0x%x", (*m_syms)[s].m_name,
+					m_state.m_pc - (*m_syms)[s].m_addr);
+		}
 		ln++;
 		unsigned int cc = m_state.m_sR[14];
 		gie = (cc & 0x020);
@@ -598,6 +523,58 @@ void	stall_screen(void) {
 	mvprintw(0,0, "CPU is stalled.  (Q to quit)\n");
 }
 
+static	unsigned	now_ms(void) {
+	struct	timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+//
+// watch
+//
+// Lets the CPU run, stopping it only long enough to read and draw its state,
+// WATCH_HZ times a second--or less often, if the link can't keep up.  Reading
+// the state takes the bus for some time, t.  Waiting at least another t before
+// the next look keeps the link no more than half busy, and the CPU running at
+// least half the time.  Any key halts the CPU again.
+//
+#define	WATCH_HZ	10
+void	watch(ZIPPY *zip) {
+	unsigned	period = 1000 / WATCH_HZ;
+	int		chv = ERR;
+
+	erase();
+	zip->go();
+	while(chv == ERR) {
+		unsigned	start = now_ms(), busy;
+
+		zip->halt();
+		if (zip->stalled())
+			stall_screen();
+		else
+			zip->read_state();
+		zip->go();
+
+		busy = now_ms() - start;
+		period = 1000 / WATCH_HZ;
+		if (period < 2*busy)
+			period = 2*busy;
+		mvprintw(23, 0, "Watching: every %4d ms, %d round trip(s).  "
+			"Any key halts the CPU.", period, zip->ntrips());
+		refresh();
+
+		timeout(period - busy);
+		chv = getch();
+	}
+	timeout(-1);
+
+	zip->halt();
+	for(int i=0; (i<5)&&(zip->stalled()); i++)
+		;
+	erase();
+}
+
 char	gbl_errstr[8192];
 void	eprintf(const char *fmt, ...) {
 	va_list	args;
@@ -607,13 +584,44 @@ void	eprintf(const char *fmt, ...) {
 	va_end(args);
 }
 
+//
+// Symbols come from either the program's ELF file, or from a map file
+//
+SYMTAB	*load_symbols(const char *fname) {
+	SYMTAB	*syms = new SYMTAB;
+
+	if (access(fname, R_OK)!=0) {
+		fprintf(stderr, "Cannot open symbol file, %s\n", fname);
+		exit(EXIT_FAILURE);
+	}
+
+	if (iself(fname)) {
+		ELFSYMBOL	**elfsym;
+		int		nsyms;
+
+		nsyms = elfsymbols(fname, elfsym);
+		syms->add(elfsym, nsyms);
+		free(elfsym);
+	} else
+		syms->loadmap(fname);
+
+	return syms;
+}
+
 int	main(int argc, char **argv) {
 	// FPGAOPEN(m_fpga);
 	ZIPPY	*zip; //
+	SYMTAB	*syms = NULL;
 	gbl_errstr[0] = '\0';
 
+	if (argc > 2) {
+		fprintf(stderr, "USAGE: zipdbg [elf-file|map-file]\n");
+		exit(EXIT_FAILURE);
+	} else if (argc == 2)
+		syms = load_symbols(argv[1]);
+
 	FPGAOPEN(m_fpga);
-	zip = new ZIPPY(m_fpga);
+	zip = new ZIPPY(m_fpga, syms);
 
 	try {
 
@@ -646,6 +654,7 @@ int	main(int argc, char **argv) {
 				done = true;
 				break;
 			case 'l': case 'L': case CTRL('L'):
+				zip->flush();
 				redrawwin(stdscr);
 			case 'm': case 'M':
 				zip->show_user_timers(false);
@@ -666,6 +675,9 @@ int	main(int argc, char **argv) {
 			case 'u': case 'U':
 				zip->show_user_timers(true);
 				break;
+			case 'w': case 'W':
+				watch(zip);
+				break;
 			case '\r': case  '\n':
 			case KEY_IC: case KEY_ENTER:
 				get_value(zip);
@@ -687,8 +699,12 @@ int	main(int argc, char **argv) {
 				;
 			}
 
+			// Keys which only change what's shown, such as
+			// moving the cursor, don't need the bus at all
 			if ((done)||(gbl_err))
 				break;
+			else if (!zip->stale())
+				zip->draw_state();
 			else if (zip->stalled())
 				stall_screen();
 			else
@@ -0,0 +1,475 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zipdis.cpp
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Disassembles a ZipCPU ELF program, without needing the
+//		cross compiler's objdump.  The executable segments found by
+//	elfread() are split into chunks, which are then disassembled by as
+//	many threads as there are cores.
+//
+//	This happens in two passes.  The first finds the target of every
+//	branch, via zop_early_branch(), so that the second can mark where each
+//	lands while it disassembles.  Symbols from the ELF file head each
+//	function, and branches are listed along with the symbol they go to.
+//
+//	The listing is either text, or (with -x) the indexed format described
+//	in zipdis.h, for other tools to mmap().
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "zopcodes.h"
+#include "zipelf.h"
+#include "symtab.h"
+#include "zipdis.h"
+
+#define	CHUNKWORDS	8192	// Instruction words per chunk
+
+void	usage(void) {
+	printf("USAGE: zipdis [-hx] [-j threads] [-o file] <zip-program-file>\n"
+"\n"
+"\t-h\tDisplay this usage statement\n"
+"\t-j threads\tDisassemble using this many threads, rather than one\n"
+"\t\tper core\n"
+"\t-o file\tWrite the listing to file, rather than to stdout\n"
+"\t-x\tWrite the indexed format of zipdis.h, rather than text\n");
+}
+
+//
+// TEXTBUF
+//
+// A growing buffer, which each chunk appends its listing (or its strings)
+// to.  Each thread owns the buffers of the chunks it's working on, so no
+// locking is needed.
+//
+class	TEXTBUF {
+public:
+	char		*m_buf;
+	unsigned	m_len, m_size;
+
+	TEXTBUF(void) : m_buf(NULL), m_len(0), m_size(0) {}
+	~TEXTBUF(void) { free(m_buf); }
+
+	void	grow(unsigned n) {
+		if (m_len + n <= m_size)
+			return;
+		while(m_len + n > m_size)
+			m_size = (m_size) ? 2*m_size : 65536;
+		m_buf = (char *)realloc(m_buf, m_size);
+	}
+
+	void	printf(const char *fmt, ...) {
+		va_list	args;
+		int	n;
+
+		grow(256);
+		va_start(args, fmt);
+		n = vsnprintf(&m_buf[m_len], m_size-m_len, fmt, args);
+		va_end(args);
+		if (m_len + n >= m_size) {
+			grow(n+1);
+			va_start(args, fmt);
+			vsnprintf(&m_buf[m_len], m_size-m_len, fmt, args);
+			va_end(args);
+		} m_len += n;
+	}
+
+	// Adds a NUL terminated string, returning where it starts
+	unsigned	str(const char *s) {
+		unsigned	n = strlen(s)+1, at = m_len;
+
+		grow(n);
+		memcpy(&m_buf[m_len], s, n);
+		m_len += n;
+		return at;
+	}
+};
+
+class	DISCHUNK {
+public:
+	const ELFSECTION	*m_sec;
+	uint32_t	m_addr;
+	unsigned	m_first;	// Index of the chunk's first word
+	unsigned	m_nwords;
+	const char	*m_data;
+	TEXTBUF		m_text;
+};
+
+// Every executable word, across all sections, in address order
+static	unsigned	gbl_nwords = 0;
+static	ZIPDISWORD	*gbl_words;
+static	DISCHUNK	*gbl_chunks;
+static	unsigned	gbl_nchunks, gbl_next;
+static	ELFSECTION	**gbl_secs;
+static	unsigned	*gbl_secfirst;	// Index of each section's first word
+static	int		gbl_nsecs;
+static	SYMTAB		gbl_syms;
+static	bool		gbl_indexed = false;
+
+//
+// Returns the index of the word at addr, or -1 if it's not within any of the
+// sections being disassembled
+//
+static	int	wordindex(uint32_t addr) {
+	int	lo = 0, hi = gbl_nsecs-1;
+
+	if (addr & 3)
+		return -1;
+	while(lo <= hi) {
+		int	mid = (lo+hi)/2;
+		const ELFSECTION *s = gbl_secs[mid];
+
+		if (addr < s->m_start)
+			hi = mid-1;
+		else if (addr - s->m_start >= (s->m_len & -4))
+			lo = mid+1;
+		else
+			return gbl_secfirst[mid] + (addr - s->m_start)/4;
+	} return -1;
+}
+
+//
+// The first pass: where does each word branch to?
+//
+static	void	findbranches(DISCHUNK &c) {
+	const unsigned char	*d = (const unsigned char *)c.m_data;
+
+	for(unsigned k=0; k<c.m_nwords; k++, d+=4) {
+		ZIPDISWORD	&w = gbl_words[c.m_first+k];
+		uint32_t	target;
+		int		t;
+
+		w.w_addr = c.m_addr + 4*k;
+		w.w_ins  = (d[0]<<24)|(d[1]<<16)|(d[2]<<8)|d[3];
+		target = zop_early_branch(w.w_addr, w.w_ins);
+		if (target == w.w_addr + 4)
+			continue;
+
+		w.w_target = target;
+		__atomic_or_fetch(&w.w_flags, ZIPDIS_BRANCH, __ATOMIC_RELAXED);
+		if ((t = wordindex(target)) >= 0)
+			__atomic_or_fetch(&gbl_words[t].w_flags, ZIPDIS_TARGET,
+				__ATOMIC_RELAXED);
+	}
+}
+
+//
+// The second pass: disassemble, and then list each word
+//
+static	void	listchunk(DISCHUNK &c) {
+	ZOPDIS	*dis = new ZOPDIS[c.m_nwords];
+
+	zop_disassemble(c.m_addr, c.m_data, c.m_nwords, dis);
+
+	if ((!gbl_indexed)&&(c.m_addr == c.m_sec->m_start))
+		c.m_text.printf("\nDisassembly of 0x%08x-0x%08x\n",
+			c.m_sec->m_start, c.m_sec->m_start+c.m_sec->m_len);
+
+	for(unsigned k=0; k<c.m_nwords; k++) {
+		ZIPDISWORD	&w = gbl_words[c.m_first+k];
+
+		if (gbl_indexed) {
+			// Relative to the chunk's strings, for now
+			w.w_a = c.m_text.str(dis[k].z_a);
+			w.w_b = (dis[k].z_b[0]) ? c.m_text.str(dis[k].z_b) : 0;
+			continue;
+		}
+
+		for(int s = gbl_syms.find(w.w_addr); (s >= 0)
+				&&(s < gbl_syms.size())
+				&&(gbl_syms[s].m_addr == w.w_addr); s++)
+			c.m_text.printf("\n%08x <%s>:\n", w.w_addr,
+				gbl_syms[s].m_name);
+
+		c.m_text.printf("%c%08x:  %08x  ",
+			(w.w_flags & ZIPDIS_TARGET) ? '>' : ' ',
+			w.w_addr, w.w_ins);
+		if (w.w_flags & ZIPDIS_BRANCH) {
+			int	s = gbl_syms.nearest(w.w_target);
+
+			c.m_text.printf("%-30s", dis[k].z_a);
+
+			if (s < 0)
+				c.m_text.printf("<0x%08x>", w.w_target);
+			else if (gbl_syms[s].m_addr == w.w_target)
+				c.m_text.printf("<%s>", gbl_syms[s].m_name);
+			else
+				c.m_text.printf("<%s+0x%x>", gbl_syms[s].m_name,
+					w.w_target - gbl_syms[s].m_addr);
+		} else
+			c.m_text.printf("%s", dis[k].z_a);
+		c.m_text.printf("\n");
+		if (dis[k].z_b[0])
+			c.m_text.printf("%22s%s\n", "", dis[k].z_b);
+	}
+
+	delete[] dis;
+}
+
+static	void	(*gbl_pass)(DISCHUNK &c);
+
+static	void	*worker(void *) {
+	unsigned	k;
+
+	while((k = __atomic_fetch_add(&gbl_next, 1, __ATOMIC_RELAXED))
+			< gbl_nchunks)
+		gbl_pass(gbl_chunks[k]);
+	return NULL;
+}
+
+// Runs pass over every chunk, on nthreads threads
+static	void	runpass(void (*pass)(DISCHUNK &), int nthreads) {
+	pthread_t	*threads = new pthread_t[nthreads];
+
+	gbl_pass = pass;
+	gbl_next = 0;
+	for(int k=0; k<nthreads; k++) {
+		if (pthread_create(&threads[k], NULL, worker, NULL) != 0) {
+			fprintf(stderr, "Could not start a thread\n");
+			exit(EXIT_FAILURE);
+		}
+	} for(int k=0; k<nthreads; k++)
+		pthread_join(threads[k], NULL);
+
+	delete[] threads;
+}
+
+static int
+seccmp(const void *va, const void *vb) {
+	const ELFSECTION	*a = *(ELFSECTION *const *)va,
+				*b = *(ELFSECTION *const *)vb;
+
+	return (a->m_start < b->m_start) ? -1 : (a->m_start > b->m_start);
+}
+
+//
+// The indexed format: a header, the words, the symbols, and then all of the
+// strings
+//
+static	void	writeindex(FILE *fp) {
+	ZIPDISHDR	hdr;
+	ZIPDISSYM	*syms;
+	uint32_t	base;
+	unsigned	nsyms = gbl_syms.size(), namelen = 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+	strcpy(hdr.h_magic, ZIPDIS_MAGIC);
+	hdr.h_order  = ZIPDIS_ORDER;
+	hdr.h_nwords = gbl_nwords;
+	hdr.h_words  = sizeof(hdr);
+	hdr.h_nsyms  = nsyms;
+	hdr.h_syms   = hdr.h_words + gbl_nwords * sizeof(ZIPDISWORD);
+	hdr.h_strings= hdr.h_syms + nsyms * sizeof(ZIPDISSYM);
+
+	// Point the words at where their chunk's strings will land
+	base = hdr.h_strings;
+	for(unsigned c=0; c<gbl_nchunks; c++) {
+		for(unsigned k=0; k<gbl_chunks[c].m_nwords; k++) {
+			ZIPDISWORD &w = gbl_words[gbl_chunks[c].m_first+k];
+			w.w_a += base;
+			if (w.w_b)
+				w.w_b += base;
+		} base += gbl_chunks[c].m_text.m_len;
+	}
+
+	syms = new ZIPDISSYM[nsyms+1];
+	for(unsigned k=0; k<nsyms; k++) {
+		syms[k].s_addr = gbl_syms[k].m_addr;
+		syms[k].s_size = gbl_syms[k].m_size;
+		syms[k].s_name = base + namelen;
+		syms[k].s_func = gbl_syms[k].m_func;
+		namelen += strlen(gbl_syms[k].m_name)+1;
+	} hdr.h_size = base + namelen;
+
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	fwrite(gbl_words, sizeof(ZIPDISWORD), gbl_nwords, fp);
+	fwrite(syms, sizeof(ZIPDISSYM), nsyms, fp);
+	for(unsigned c=0; c<gbl_nchunks; c++)
+		fwrite(gbl_chunks[c].m_text.m_buf, 1,
+			gbl_chunks[c].m_text.m_len, fp);
+	for(unsigned k=0; k<nsyms; k++)
+		fwrite(gbl_syms[k].m_name, 1, strlen(gbl_syms[k].m_name)+1,
+			fp);
+
+	delete[] syms;
+}
+
+int main(int argc, char **argv) {
+	int		skp, nthreads = 0, nsyms;
+	const char	*execfile, *outfile = NULL;
+	uint32_t	entry;
+	ELFSECTION	**sections;
+	ELFSYMBOL	**elfsym;
+	FILE		*fp;
+
+	skp=1;
+	for(int argn=0; argn<argc-skp; argn++) {
+		if (argv[argn+skp][0] == '-') {
+			switch(argv[argn+skp][1]) {
+			case 'h':
+				usage();
+				exit(EXIT_SUCCESS);
+				break;
+			case 'j':
+				if (argn+skp+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				nthreads = atoi(argv[argn+skp+1]);
+				skp++;
+				break;
+			case 'o':
+				if (argn+skp+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				outfile = argv[argn+skp+1];
+				skp++;
+				break;
+			case 'x':
+				gbl_indexed = true;
+				break;
+			default:
+				fprintf(stderr, "Unknown option, -%c\n\n",
+					argv[argn+skp][1]);
+				usage();
+				exit(EXIT_FAILURE);
+				break;
+			} skp++; argn--;
+		} else
+			argv[argn] = argv[argn+skp];
+	} argc -= skp;
+
+	if (argc != 1) {
+		usage();
+		exit(EXIT_FAILURE);
+	} execfile = argv[0];
+
+	if ((access(execfile, R_OK)!=0)||(!iself(execfile))) {
+		fprintf(stderr, "Cannot open executable, %s\n", execfile);
+		exit(EXIT_FAILURE);
+	} if ((gbl_indexed)&&(outfile == NULL)) {
+		fprintf(stderr, "The indexed format needs an output file, -o\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0)
+		nthreads = 1;
+
+	elfread(execfile, entry, sections);
+	nsyms = elfsymbols(execfile, elfsym);
+	gbl_syms.add(elfsym, nsyms);
+	free(elfsym);
+	// Sort and hash the symbols now, so the threads only ever read them
+	gbl_syms.find(entry);
+
+	// Executable sections only, in address order
+	gbl_nsecs = 0;
+	for(int i=0; sections[i]->m_len; i++)
+		if (sections[i]->m_exec)
+			gbl_nsecs++;
+	gbl_secs = new ELFSECTION *[gbl_nsecs+1];
+	gbl_secfirst = new unsigned[gbl_nsecs+1];
+	gbl_nsecs = 0;
+	for(int i=0; sections[i]->m_len; i++)
+		if (sections[i]->m_exec)
+			gbl_secs[gbl_nsecs++] = sections[i];
+	qsort(gbl_secs, gbl_nsecs, sizeof(ELFSECTION *), seccmp);
+
+	gbl_nchunks = 0;
+	for(int i=0; i<gbl_nsecs; i++) {
+		unsigned	n = gbl_secs[i]->m_len / 4;
+
+		gbl_secfirst[i] = gbl_nwords;
+		gbl_nwords  += n;
+		gbl_nchunks += (n + CHUNKWORDS-1) / CHUNKWORDS;
+	}
+
+	if (gbl_nwords == 0) {
+		fprintf(stderr, "No executable code found in %s\n", execfile);
+		exit(EXIT_FAILURE);
+	}
+
+	gbl_words  = new ZIPDISWORD[gbl_nwords];
+	memset(gbl_words, 0, gbl_nwords * sizeof(ZIPDISWORD));
+	gbl_chunks = new DISCHUNK[gbl_nchunks];
+	for(int i=0, c=0; i<gbl_nsecs; i++) {
+		unsigned	n = gbl_secs[i]->m_len / 4;
+
+		for(unsigned k=0; k<n; k+=CHUNKWORDS, c++) {
+			gbl_chunks[c].m_sec    = gbl_secs[i];
+			gbl_chunks[c].m_addr   = gbl_secs[i]->m_start + 4*k;
+			gbl_chunks[c].m_first  = gbl_secfirst[i] + k;
+			gbl_chunks[c].m_nwords = (n-k < CHUNKWORDS)
+						? n-k : CHUNKWORDS;
+			gbl_chunks[c].m_data   = &gbl_secs[i]->m_data[4*k];
+		}
+	}
+
+	if ((unsigned)nthreads > gbl_nchunks)
+		nthreads = gbl_nchunks;
+	runpass(findbranches, nthreads);
+	runpass(listchunk, nthreads);
+
+	if (outfile) {
+		fp = fopen(outfile, (gbl_indexed) ? "wb" : "w");
+		if (NULL == fp) {
+			fprintf(stderr, "Cannot open %s\n", outfile);
+			exit(EXIT_FAILURE);
+		}
+	} else
+		fp = stdout;
+
+	if (gbl_indexed)
+		writeindex(fp);
+	else for(unsigned c=0; c<gbl_nchunks; c++)
+		fwrite(gbl_chunks[c].m_text.m_buf, 1,
+			gbl_chunks[c].m_text.m_len, fp);
+
+	if (fp != stdout)
+		fclose(fp);
+
+	delete[] gbl_chunks;
+	delete[] gbl_words;
+	delete[] gbl_secs;
+	delete[] gbl_secfirst;
+	free(sections);
+}
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	zipdis.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	The layout of the indexed disassembly files written by
+//		zipdis -x, for other tools to mmap() and use in place.
+//
+//	The file starts with a ZIPDISHDR.  An array of h_nwords ZIPDISWORDs
+//	follows, sorted by address, and then an array of h_nsyms ZIPDISSYMs,
+//	also sorted by address.  The strings these refer to, each terminated
+//	by a NUL, come last.  All offsets are in bytes from the start of the
+//	file, and every value is in the byte order of the host that wrote it;
+//	h_order tells which that was.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	ZIPDIS_H
+#define	ZIPDIS_H
+
+#include <stdint.h>
+
+#define	ZIPDIS_MAGIC	"ZIPDIS1"
+#define	ZIPDIS_ORDER	0x01020304	// As written, in host order
+
+// Flags, for ZIPDISWORD::w_flags
+#define	ZIPDIS_TARGET	1	// Some branch lands here
+#define	ZIPDIS_BRANCH	2	// w_target holds where this branches to
+
+typedef	struct	{
+	char		h_magic[8];	// ZIPDIS_MAGIC, NUL terminated
+	uint32_t	h_order;	// ZIPDIS_ORDER
+	uint32_t	h_nwords, h_words;	// Count, and offset to the first
+	uint32_t	h_nsyms, h_syms;
+	uint32_t	h_strings, h_size;	// String table, and file size
+} ZIPDISHDR;
+
+typedef	struct	{
+	uint32_t	w_addr, w_ins;
+	uint32_t	w_target;
+	// The text of each half.  w_b is zero unless the word holds a pair
+	// of compressed instructions.
+	uint32_t	w_a, w_b;
+	uint32_t	w_flags;
+} ZIPDISWORD;
+
+typedef	struct	{
+	uint32_t	s_addr, s_size;
+	uint32_t	s_name, s_func;
+} ZIPDISSYM;
+
+#endif
@@ -222,6 +222,7 @@ assert(n != 0);
 
 		r[i]->m_start = phdr.p_paddr;
 		r[i]->m_len   = phdr.p_filesz;
+		r[i]->m_exec  = (phdr.p_flags & PF_X) != 0;
 
 		current_offset += phdr.p_memsz + sizeof(ELFSECTION);
 
@@ -259,3 +260,115 @@ assert(n != 0);
 	close(fd);
 }
 
+
+static int
+elfsymcmp(const void *va, const void *vb) {
+	const ELFSYMBOL	*a = *(const ELFSYMBOL *const *)va,
+			*b = *(const ELFSYMBOL *const *)vb;
+
+	if (a->m_addr != b->m_addr)
+		return (a->m_addr < b->m_addr) ? -1 : 1;
+	// Place functions ahead of any object sharing their address
+	return (int)b->m_func - (int)a->m_func;
+}
+
+int	elfsymbols(const char *fname, ELFSYMBOL **&symbols) {
+	Elf		*e;
+	Elf_Scn		*scn = NULL;
+	Elf_Data	*data;
+	GElf_Shdr	shdr;
+	GElf_Sym	sym;
+	int		fd, nsyms = 0, total;
+	unsigned	namelen = 0;
+
+	if (elf_version(EV_CURRENT) == EV_NONE) {
+		fprintf(stderr, "ELF library initialization err, %s\n", elf_errmsg(-1));
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	} if ((fd = open(fname, O_RDONLY, 0)) < 0) {
+		fprintf(stderr, "Could not open %s\n", fname);
+		perror("O/S Err:");
+		exit(EXIT_FAILURE);
+	} if ((e = elf_begin(fd, ELF_C_READ, NULL))==NULL) {
+		fprintf(stderr, "Could not run elf_begin, %s\n", elf_errmsg(-1));
+		exit(EXIT_FAILURE);
+	}
+
+	// Find the symbol table
+	while((scn = elf_nextscn(e, scn)) != NULL) {
+		if (gelf_getshdr(scn, &shdr) != &shdr) {
+			fprintf(stderr, "getshdr() failed: %s\n", elf_errmsg(-1));
+			exit(EXIT_FAILURE);
+		} if (shdr.sh_type == SHT_SYMTAB)
+			break;
+	}
+
+	symbols = NULL;
+	if ((scn == NULL)||((data = elf_getdata(scn, NULL)) == NULL)
+			||(shdr.sh_entsize == 0)) {
+		symbols = (ELFSYMBOL **)calloc(1, sizeof(ELFSYMBOL *));
+		elf_end(e);
+		close(fd);
+		return 0;
+	}
+
+	// First pass: count the symbols we want, and the space for their names
+	total = shdr.sh_size / shdr.sh_entsize;
+	for(int i=0; i<total; i++) {
+		int	st;
+		const char	*name;
+
+		if (gelf_getsym(data, i, &sym) != &sym)
+			continue;
+		st = GELF_ST_TYPE(sym.st_info);
+		if ((st != STT_FUNC)&&(st != STT_OBJECT))
+			continue;
+		if (sym.st_shndx == SHN_UNDEF)
+			continue;
+		name = elf_strptr(e, shdr.sh_link, sym.st_name);
+		if ((name == NULL)||(name[0] == '\0'))
+			continue;
+		nsyms++;
+		namelen += strlen(name)+1;
+	}
+
+	// Second pass: one allocation holds the pointers, the symbols, and
+	// their names
+	char	*d = (char *)malloc((nsyms+1)*(sizeof(ELFSYMBOL *)
+					+ sizeof(ELFSYMBOL)) + namelen);
+	ELFSYMBOL	**r = symbols = (ELFSYMBOL **)d;
+	ELFSYMBOL	*sp = (ELFSYMBOL *)&d[(nsyms+1)*sizeof(ELFSYMBOL *)];
+	char		*np = (char *)&sp[nsyms+1];
+	int		k = 0;
+
+	for(int i=0; (i<total)&&(k<nsyms); i++) {
+		int	st;
+		const char	*name;
+
+		if (gelf_getsym(data, i, &sym) != &sym)
+			continue;
+		st = GELF_ST_TYPE(sym.st_info);
+		if ((st != STT_FUNC)&&(st != STT_OBJECT))
+			continue;
+		if (sym.st_shndx == SHN_UNDEF)
+			continue;
+		name = elf_strptr(e, shdr.sh_link, sym.st_name);
+		if ((name == NULL)||(name[0] == '\0'))
+			continue;
+
+		r[k] = &sp[k];
+		sp[k].m_addr = (uint32_t)sym.st_value;
+		sp[k].m_size = (uint32_t)sym.st_size;
+		sp[k].m_func = (st == STT_FUNC);
+		sp[k].m_name = np;
+		strcpy(np, name);
+		np += strlen(name)+1;
+		k++;
+	} r[k] = NULL;
+
+	qsort(r, k, sizeof(ELFSYMBOL *), elfsymcmp);
+
+	elf_end(e);
+	close(fd);
+	return k;
+}
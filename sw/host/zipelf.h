@@ -44,10 +44,24 @@
 class	ELFSECTION {
 public:
 	uint32_t	m_start, m_len;
+	bool		m_exec;		// From an executable (PF_X) segment
 	char		m_data[4];
 };
 
+class	ELFSYMBOL {
+public:
+	uint32_t	m_addr, m_size;
+	bool		m_func;		// STT_FUNC, as opposed to STT_OBJECT
+	char		*m_name;
+};
+
 bool	iself(const char *fname);
 void	elfread(const char *fname, uint32_t &entry, ELFSECTION **&sections);
 
+// Reads the function and data object symbols from fname's symbol table,
+// sorted by address.  Returns the number of symbols found, or zero if the
+// file has been stripped.  The array is NULL terminated; free() it, and
+// the names along with it, once done.
+int	elfsymbols(const char *fname, ELFSYMBOL **&symbols);
+
 #endif
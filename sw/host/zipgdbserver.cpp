@@ -0,0 +1,983 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	zipgdbserver.cpp
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	A GDB remote serial protocol server for the ZipCPU, working
+//		through the debug port (R_ZIPCTRL/R_ZIPDATA) over any DEVBUS.
+//	Point GDB at it with "target remote localhost:2345".
+//
+//	The debug bus is slow--a UART, more often than not--so this server
+//	tries to cross it as seldom as it can:
+//
+//	- All 32 registers are read in one pipelined round trip, and kept
+//	  until the CPU is next released.  G and P packets only write the
+//	  registers that actually change.
+//	- Memory is cached in 64 byte lines, read with readi() a contiguous
+//	  run of missing lines at a time.  Writes go through the cache, and
+//	  the whole cache is forgotten whenever the CPU runs or steps.  Only
+//	  memory is cached, never peripherals.
+//	- Software breakpoints are only placed in memory while the CPU runs,
+//	  all in one pipeline, so GDB never sees them and stepping needs no
+//	  memory writes at all.
+//
+//	Registers are numbered as they are on the debug port: 0-15 are sR0
+//	through sPC, and 16-31 are uR0 through uPC.
+//
+//	The number of bus transactions (calls into the DEVBUS) and words each
+//	GDB command took are counted, and listed when GDB disconnects.  With
+//	-v, each command's count is printed as it completes.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <ctype.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "port.h"
+#include "llcomms.h"
+#include "regdefs.h"
+#include "ttybus.h"
+
+#define	GDBPORT		2345
+#define	NREGS		32	// sR0-sPC, then uR0-uPC
+#define	REG_sCC		14
+#define	REG_sPC		15
+#define	REG_uPC		31
+#define	LINEWORDS	16	// Words per memory cache line
+#define	LINEBYTES	(LINEWORDS*4)
+#define	NLINES		256	// Lines in the memory cache, a power of two
+#define	MAXPKT		4096	// Longest packet we'll take or send
+#define	MAXBKPTS	64
+#define	MAXTRIES	1000	// Polls for the CPU to halt, before giving up
+#define	ZIP_BREAK	0x77000000	// The BRK instruction
+#define	CC_GIE		0x0020
+#define	CC_BREAK	0x0080	// Let BRK halt the CPU from user mode as well
+#define	CC_ILL		0x0100
+#define	CC_BUSERR	0x0400
+#define	CC_DIVERR	0x0800
+
+// Signals, as GDB numbers them
+#define	GDB_SIGINT	2
+#define	GDB_SIGILL	4
+#define	GDB_SIGTRAP	5
+#define	GDB_SIGFPE	8
+#define	GDB_SIGBUS	10
+
+FPGA	*m_fpga;
+bool	gbl_verbose = false;
+
+//
+// GDBBUS
+//
+// Passes everything through to the real bus, counting the transactions, and
+// the words within them, as it goes.
+//
+class	GDBBUS : public DEVBUS {
+	typedef	DEVBUS::BUSW	BUSW;
+	DEVBUS	*m_fpga;
+public:
+	unsigned long	m_calls, m_words;
+
+	GDBBUS(DEVBUS *fpga) : m_fpga(fpga), m_calls(0), m_words(0) {}
+
+	void	kill(void) { m_fpga->kill(); }
+	void	close(void) { m_fpga->close(); }
+	void	writeio(const BUSW a, const BUSW v) {
+		m_calls++; m_words++;
+		m_fpga->writeio(a, v); }
+	BUSW	readio(const BUSW a) {
+		m_calls++; m_words++;
+		return m_fpga->readio(a); }
+	void	readi(const BUSW a, const int len, BUSW *buf) {
+		m_calls++; m_words += len;
+		m_fpga->readi(a, len, buf); }
+	void	readz(const BUSW a, const int len, BUSW *buf) {
+		m_calls++; m_words += len;
+		m_fpga->readz(a, len, buf); }
+	void	writei(const BUSW a, const int len, const BUSW *buf) {
+		m_calls++; m_words += len;
+		m_fpga->writei(a, len, buf); }
+	void	writez(const BUSW a, const int len, const BUSW *buf) {
+		m_calls++; m_words += len;
+		m_fpga->writez(a, len, buf); }
+	void	pipeline(const int nops, BUSOP *ops) {
+		m_calls++; m_words += nops;
+		m_fpga->pipeline(nops, ops); }
+	bool	poll(void) { return m_fpga->poll(); }
+	void	usleep(unsigned ms) { m_fpga->usleep(ms); }
+	void	wait(void) { m_fpga->wait(); }
+	bool	bus_err(void) const { return m_fpga->bus_err(); }
+	void	reset_err(void) { m_fpga->reset_err(); }
+	void	clear(void) { m_fpga->clear(); }
+};
+
+//
+// MEMCACHE
+//
+// A direct mapped, write through cache of the board's memories.  It's only
+// valid while the CPU is halted, and so must be flushed before the CPU is
+// released.
+//
+class	MEMCACHE {
+	DEVBUS		*m_bus;
+	bool		m_valid[NLINES];
+	unsigned	m_tag[NLINES];
+	unsigned	m_data[NLINES][LINEWORDS];
+
+	static	unsigned	line(unsigned a) {
+		return (a / LINEBYTES) & (NLINES-1); }
+	bool	hit(unsigned a) const {
+		unsigned l = line(a);
+		return (m_valid[l])&&(m_tag[l] == (a & -LINEBYTES));
+	}
+
+	// True if the nw words from a fit within the cache at once, and are
+	// all within one RAM
+	static	bool	cacheable(unsigned a, unsigned nw) {
+		unsigned	end = a + 4*nw;
+
+		if ((end & -LINEBYTES) - (a & -LINEBYTES) >= NLINES*LINEBYTES)
+			return false;
+		return inram(a, nw);
+	}
+public:
+	MEMCACHE(DEVBUS *bus) : m_bus(bus) { flush(); }
+
+	// True if the nw words from a are all within one RAM.  Only these can
+	// be written with plain bus writes--the flash ignores them, and needs
+	// its own driver to be programmed.
+	static	bool	inram(unsigned a, unsigned nw) {
+		unsigned	end = a + 4*nw;
+
+		if (end < a)
+			return false;
+#ifdef	BKRAMBASE
+		if ((a >= BKRAMBASE)&&(end <= BKRAMBASE+BKRAMLEN))
+			return true;
+#endif
+#ifdef	SDRAMBASE
+		if ((a >= SDRAMBASE)&&(end <= SDRAMBASE+SDRAMLEN))
+			return true;
+#endif
+		return false;
+	}
+
+	void	flush(void) {
+		for(int i=0; i<NLINES; i++)
+			m_valid[i] = false;
+	}
+
+	// Reads nw words from the word address a.  Each run of lines we don't
+	// have is read in a single readi().  Throws BUSERR, as readi() does.
+	void	read(unsigned a, unsigned nw, unsigned *buf) {
+		unsigned	end = a + 4*nw;
+
+		if (!cacheable(a, nw)) {
+			m_bus->readi(a, nw, buf);
+			return;
+		}
+
+		for(unsigned la = a & -LINEBYTES; la < end; ) {
+			unsigned	first = la, n, *tmp;
+
+			if (hit(la)) {
+				la += LINEBYTES;
+				continue;
+			}
+
+			while((la < end)&&(!hit(la)))
+				la += LINEBYTES;
+			n = (la - first) / 4;
+
+			tmp = new unsigned[n];
+			try {
+				m_bus->readi(first, n, tmp);
+			} catch(BUSERR b) {
+				delete[] tmp;
+				throw;
+			}
+
+			for(unsigned k=0; k<n; k+=LINEWORDS) {
+				unsigned l = line(first + 4*k);
+				m_valid[l] = true;
+				m_tag[l]   = first + 4*k;
+				memcpy(m_data[l], &tmp[k], LINEBYTES);
+			}
+			delete[] tmp;
+		}
+
+		for(unsigned k=0; k<nw; k++) {
+			unsigned	b = a + 4*k;
+			buf[k] = m_data[line(b)][(b/4)%LINEWORDS];
+		}
+	}
+
+	void	write(unsigned a, unsigned nw, const unsigned *buf) {
+		m_bus->writei(a, nw, buf);
+		for(unsigned k=0; k<nw; k++) {
+			unsigned	b = a + 4*k;
+			if (hit(b))
+				m_data[line(b)][(b/4)%LINEWORDS] = buf[k];
+		}
+	}
+};
+
+//
+// GDBLINK
+//
+// The TCP connection to GDB, and its packet framing
+//
+class	GDBLINK {
+	int	m_fd, m_len, m_pos;
+	bool	m_noack;
+	char	m_buf[MAXPKT];
+
+	int	getch(void) {
+		if (m_pos >= m_len) {
+			m_len = recv(m_fd, m_buf, sizeof(m_buf), 0);
+			m_pos = 0;
+			if (m_len <= 0)
+				return -1;
+		} return (unsigned char)m_buf[m_pos++];
+	}
+
+	void	put(const char *str, int len) {
+		while(len > 0) {
+			int	nw = send(m_fd, str, len, 0);
+			if (nw <= 0)
+				return;
+			str += nw; len -= nw;
+		}
+	}
+public:
+	GDBLINK(int fd) : m_fd(fd), m_len(0), m_pos(0), m_noack(false) {}
+
+	void	noack(void) { m_noack = true; }
+
+	// Reads the next packet into pkt, acknowledging it.  Returns false
+	// once GDB has gone away.
+	bool	get(char *pkt) {
+		while(1) {
+			int		c, len = 0;
+			unsigned	sum = 0, cksum;
+			char		hex[3];
+
+			// Skip acknowledgments, and anything else between
+			// packets
+			while(((c = getch()) >= 0)&&(c != '$'))
+				;
+			if (c < 0)
+				return false;
+			while(((c = getch()) >= 0)&&(c != '#')) {
+				sum += c;
+				if (len < MAXPKT-1)
+					pkt[len++] = c;
+			} if (c < 0)
+				return false;
+			pkt[len] = '\0';
+
+			if ((c = getch()) < 0)
+				return false;
+			hex[0] = c;
+			if ((c = getch()) < 0)
+				return false;
+			hex[1] = c; hex[2] = '\0';
+			cksum = strtoul(hex, NULL, 16);
+
+			if (m_noack)
+				return true;
+			else if (cksum == (sum & 0x0ff)) {
+				put("+", 1);
+				return true;
+			} put("-", 1);
+		}
+	}
+
+	void	reply(const char *pkt) {
+		char		*buf = new char[strlen(pkt)+5];
+		unsigned	sum = 0;
+		int		len;
+
+		for(const char *p = pkt; *p; p++)
+			sum += (unsigned char)*p;
+		len = sprintf(buf, "$%s#%02x", pkt, sum & 0x0ff);
+
+		do {
+			put(buf, len);
+		} while((!m_noack)&&(getch() == '-'));
+		delete[] buf;
+	}
+
+	// Waits up to ms milliseconds for GDB to ask us to stop the CPU.
+	// Returns 1 if it did, -1 if it's gone, and zero otherwise.
+	int	interrupted(int ms) {
+		struct	pollfd	p;
+
+		if (m_pos >= m_len) {
+			p.fd = m_fd; p.events = POLLIN; p.revents = 0;
+			if (::poll(&p, 1, ms) <= 0)
+				return 0;
+		}
+
+		int c = getch();
+		if (c < 0)
+			return -1;
+		return (c == 0x03) ? 1 : 0;
+	}
+};
+
+//
+// ZIPGDB
+//
+// The CPU, as GDB sees it
+//
+class	ZIPGDB {
+	GDBBUS		*m_bus;
+	MEMCACHE	m_mem;
+	unsigned	m_r[NREGS];
+	bool		m_rvalid,
+			m_codewr,	// Memory written since the CPU last ran
+			m_setbreak;	// We set CC_BREAK, and must clear it
+	unsigned	m_bkpt[MAXBKPTS];
+	int		m_nbkpts;
+public:
+	int		m_signal;
+
+	ZIPGDB(GDBBUS *bus) : m_bus(bus), m_mem(bus), m_rvalid(false),
+		m_codewr(false), m_setbreak(false), m_nbkpts(0),
+		m_signal(GDB_SIGTRAP) {}
+
+	bool	halted(void) {
+		return (m_bus->readio(R_ZIPCTRL) & CPU_STALL) != 0;
+	}
+
+	void	halt(void) {
+		int	tries = 0;
+
+		m_bus->writeio(R_ZIPCTRL, CPU_HALT);
+		while(!halted()) {
+			if (++tries >= MAXTRIES) {
+				fprintf(stderr, "ERR: The CPU won\'t halt\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	// Before the CPU runs, forget everything we know of it
+	void	release(void) {
+		m_mem.flush();
+		m_rvalid = false;
+		m_codewr = false;
+	}
+
+	// All the registers, in one round trip
+	const unsigned	*regs(void) {
+		BUSOP	ops[2*NREGS];
+
+		if (m_rvalid)
+			return m_r;
+		for(int i=0; i<NREGS; i++) {
+			ops[2*i  ] = BUSOP(R_ZIPCTRL, CPU_HALT|i);
+			ops[2*i+1] = BUSOP(R_ZIPDATA);
+		}
+		m_bus->pipeline(2*NREGS, ops);
+		for(int i=0; i<NREGS; i++)
+			m_r[i] = ops[2*i+1].m_data;
+		m_rvalid = true;
+		return m_r;
+	}
+
+	// Writes whichever of the registers have changed
+	void	setregs(const unsigned *v) {
+		BUSOP	ops[2*NREGS];
+		int	nops = 0;
+
+		regs();
+		for(int i=0; i<NREGS; i++) {
+			if (v[i] == m_r[i])
+				continue;
+			ops[nops++] = BUSOP(R_ZIPCTRL, CPU_HALT|i);
+			ops[nops++] = BUSOP(R_ZIPDATA, v[i]);
+			m_r[i] = v[i];
+		}
+		if (nops > 0)
+			m_bus->pipeline(nops, ops);
+	}
+
+	void	setreg(int r, unsigned v) {
+		unsigned	v32[NREGS];
+
+		memcpy(v32, regs(), sizeof(v32));
+		v32[r] = v;
+		setregs(v32);
+	}
+
+	// The PC of whichever mode the CPU is in
+	int	pcreg(void) {
+		return (regs()[REG_sCC] & CC_GIE) ? REG_uPC : REG_sPC;
+	}
+
+	void	read(unsigned a, unsigned nw, unsigned *buf) {
+		m_mem.read(a, nw, buf);
+	}
+
+	// Returns false, having written nothing, unless all nw words are
+	// within RAM
+	bool	write(unsigned a, unsigned nw, const unsigned *buf) {
+		if (!MEMCACHE::inram(a, nw))
+			return false;
+		m_mem.write(a, nw, buf);
+		m_codewr = true;
+		return true;
+	}
+
+	// Breakpoints are BRK instructions written over the code, and so only
+	// work in RAM
+	bool	set_bkpt(unsigned a) {
+		for(int i=0; i<m_nbkpts; i++)
+			if (m_bkpt[i] == a)
+				return true;
+		if ((a & 3)||(m_nbkpts >= MAXBKPTS)
+				||(!MEMCACHE::inram(a, 1)))
+			return false;
+		m_bkpt[m_nbkpts++] = a;
+		return true;
+	}
+
+	void	clear_bkpt(unsigned a) {
+		for(int i=0; i<m_nbkpts; i++)
+			if (m_bkpt[i] == a) {
+				m_bkpt[i] = m_bkpt[--m_nbkpts];
+				return;
+			}
+	}
+
+	bool	is_bkpt(unsigned a) {
+		for(int i=0; i<m_nbkpts; i++)
+			if (m_bkpt[i] == a)
+				return true;
+		return false;
+	}
+
+	// Once halted, why?
+	int	stop_signal(void) {
+		unsigned	cc = regs()[REG_sCC];
+
+		if (cc & CC_BUSERR)
+			return GDB_SIGBUS;
+		if (cc & CC_ILL)
+			return GDB_SIGILL;
+		if (cc & CC_DIVERR)
+			return GDB_SIGFPE;
+		return GDB_SIGTRAP;
+	}
+
+	// Waits for the CPU to halt, polling less often the longer it runs.
+	// Returns false if GDB went away while we were waiting.
+	bool	wait_for_halt(GDBLINK &gdb) {
+		int	ms = 1;
+
+		while(!halted()) {
+			int	r = gdb.interrupted(ms);
+			if (r < 0)
+				return false;
+			else if (r > 0) {
+				halt();
+				release();
+				m_signal = GDB_SIGINT;
+				return true;
+			}
+			if (ms < 100)
+				ms *= 2;
+		}
+
+		release();
+		m_signal = stop_signal();
+		return true;
+	}
+
+	bool	step(GDBLINK &gdb) {
+		unsigned	ctrl = CPU_STEP;
+
+		if (m_codewr)
+			ctrl |= CPU_CLRCACHE;
+		release();
+		m_bus->writeio(R_ZIPCTRL, ctrl);
+		return wait_for_halt(gdb);
+	}
+
+	//
+	// Lets the CPU run until it hits a breakpoint, or GDB interrupts it.
+	// Placing the breakpoints, enabling them in user mode, and releasing
+	// the CPU all take one round trip.  Removing them takes one more.
+	//
+	bool	cont(GDBLINK &gdb) {
+		BUSOP		ops[2*MAXBKPTS+3];
+		int		nops = 0;
+		unsigned	cc;
+		bool		r;
+
+		// A breakpoint at the PC would stop us right where we are
+		if (is_bkpt(regs()[pcreg()])) {
+			if (!step(gdb))
+				return false;
+			if ((m_signal != GDB_SIGTRAP)
+					||(is_bkpt(regs()[pcreg()])))
+				return true;
+		}
+
+		for(int i=0; i<m_nbkpts; i++) {
+			ops[nops++] = BUSOP(m_bkpt[i]);
+			ops[nops++] = BUSOP(m_bkpt[i], ZIP_BREAK);
+		}
+
+		cc = regs()[REG_sCC];
+		if (!(cc & CC_BREAK)) {
+			ops[nops++] = BUSOP(R_ZIPCTRL, CPU_HALT|REG_sCC);
+			ops[nops++] = BUSOP(R_ZIPDATA, cc | CC_BREAK);
+			m_setbreak = true;
+		}
+		ops[nops++] = BUSOP(R_ZIPCTRL, CPU_GO
+			| (((m_codewr)||(m_nbkpts > 0)) ? CPU_CLRCACHE : 0));
+		release();
+		m_bus->pipeline(nops, ops);
+
+		r = wait_for_halt(gdb);
+		if (!r)
+			halt();
+
+		// Put back what the breakpoints replaced
+		if (m_nbkpts > 0) {
+			BUSOP	rops[MAXBKPTS];
+			int	nr = 0;
+
+			for(int i=0; i<m_nbkpts; i++)
+				if (!ops[2*i].m_err)
+					rops[nr++] = BUSOP(m_bkpt[i],
+							ops[2*i].m_data);
+			if (nr > 0)
+				m_bus->pipeline(nr, rops);
+			m_codewr = true;
+		}
+
+		return r;
+	}
+
+	void	go(void) {
+		m_bus->writeio(R_ZIPCTRL, CPU_GO | ((m_codewr) ? CPU_CLRCACHE:0));
+		release();
+	}
+
+	// Lets the CPU go, as it was before GDB attached
+	void	detach(void) {
+		if (m_setbreak) {
+			setreg(REG_sCC, regs()[REG_sCC] & ~CC_BREAK);
+			m_setbreak = false;
+		}
+		go();
+	}
+
+	void	reset(void) {
+		m_bus->writeio(R_ZIPCTRL, CPU_RESET|CPU_HALT);
+		release();
+	}
+};
+
+//
+// Statistics, by the first letter of each GDB command
+//
+class	CMDSTATS {
+public:
+	unsigned long	m_count, m_calls, m_words;
+	CMDSTATS(void) : m_count(0), m_calls(0), m_words(0) {}
+};
+
+CMDSTATS	gbl_stats[128];
+
+void	print_stats(void) {
+	printf("%3s %8s %10s %10s %10s\n", "Cmd", "Count", "BusXfers",
+		"Words", "Xfers/Cmd");
+	for(int i=0; i<128; i++) {
+		if (gbl_stats[i].m_count == 0)
+			continue;
+		printf("%3c %8lu %10lu %10lu %10.2f\n", isprint(i) ? i : '?',
+			gbl_stats[i].m_count, gbl_stats[i].m_calls,
+			gbl_stats[i].m_words,
+			gbl_stats[i].m_calls / (double)gbl_stats[i].m_count);
+	}
+}
+
+static	unsigned	hexval(const char *&ptr) {
+	return strtoul(ptr, (char **)&ptr, 16);
+}
+
+static	unsigned	hexbyte(const char *ptr) {
+	char	hex[3];
+
+	hex[0] = ptr[0]; hex[1] = ptr[1]; hex[2] = '\0';
+	return strtoul(hex, NULL, 16);
+}
+
+//
+// Handles one packet from GDB, filling in the reply.  Returns false if the
+// connection should then be closed.
+//
+bool	command(ZIPGDB &zip, GDBLINK &gdb, const char *pkt, char *reply) {
+	const char	*ptr = pkt+1;
+
+	reply[0] = '\0';
+	switch(pkt[0]) {
+	case '?':
+		sprintf(reply, "S%02x", zip.m_signal);
+		break;
+	case 'g': {
+		const unsigned *r = zip.regs();
+		for(int i=0; i<NREGS; i++)
+			sprintf(&reply[8*i], "%08x", r[i]);
+		} break;
+	case 'G': {
+		unsigned	v[NREGS];
+
+		if (strlen(ptr) < 8*NREGS) {
+			strcpy(reply, "E01");
+			break;
+		}
+		for(int i=0; i<NREGS; i++) {
+			char	hex[9];
+			memcpy(hex, &ptr[8*i], 8); hex[8] = '\0';
+			v[i] = strtoul(hex, NULL, 16);
+		}
+		zip.setregs(v);
+		strcpy(reply, "OK");
+		} break;
+	case 'p': {
+		unsigned	r = hexval(ptr);
+
+		if (r >= NREGS)
+			strcpy(reply, "E01");
+		else
+			sprintf(reply, "%08x", zip.regs()[r]);
+		} break;
+	case 'P': {
+		unsigned	r = hexval(ptr), v;
+
+		if ((r >= NREGS)||(*ptr++ != '=')) {
+			strcpy(reply, "E01");
+			break;
+		}
+		v = hexval(ptr);
+		zip.setreg(r, v);
+		strcpy(reply, "OK");
+		} break;
+	case 'm': {
+		unsigned	a, len, wa, nw, *buf;
+
+		a = hexval(ptr);
+		if (*ptr++ != ',') {
+			strcpy(reply, "E01");
+			break;
+		}
+		len = hexval(ptr);
+		if (len > (MAXPKT-8)/2)
+			len = (MAXPKT-8)/2;
+		if (len == 0)
+			break;
+		wa = a & -4;
+		nw = (a + len - wa + 3) / 4;
+		buf = new unsigned[nw];
+		try {
+			zip.read(wa, nw, buf);
+			for(unsigned k=0; k<len; k++) {
+				unsigned b = a + k, w = buf[(b-wa)/4];
+				sprintf(&reply[2*k], "%02x",
+					(w >> (24-8*(b&3))) & 0x0ff);
+			}
+		} catch(BUSERR b) {
+			strcpy(reply, "E0e");	// EFAULT
+		}
+		delete[] buf;
+		} break;
+	case 'M': {
+		unsigned	a, len, wa, nw, *buf;
+
+		a = hexval(ptr);
+		if (*ptr++ != ',') {
+			strcpy(reply, "E01");
+			break;
+		}
+		len = hexval(ptr);
+		if ((*ptr++ != ':')||(strlen(ptr) < 2*len)) {
+			strcpy(reply, "E01");
+			break;
+		} else if (len == 0) {
+			strcpy(reply, "OK");
+			break;
+		}
+
+		wa = a & -4;
+		nw = (a + len - wa + 3) / 4;
+		if (!MEMCACHE::inram(wa, nw)) {
+			// Writes to the flash would be ignored
+			strcpy(reply, "E01");
+			break;
+		}
+		buf = new unsigned[nw];
+		try {
+			// Only partial words need reading first
+			if ((a & 3)||(len & 3))
+				zip.read(wa, nw, buf);
+			for(unsigned k=0; k<len; k++) {
+				unsigned b = a + k, sh = 24-8*(b&3),
+					*w = &buf[(b-wa)/4];
+				*w = (*w & ~(0x0ff << sh))
+					| (hexbyte(&ptr[2*k]) << sh);
+			}
+			zip.write(wa, nw, buf);
+			strcpy(reply, "OK");
+		} catch(BUSERR b) {
+			strcpy(reply, "E0e");
+		}
+		delete[] buf;
+		} break;
+	case 'c': case 's': {
+		bool	alive;
+
+		if (*ptr)
+			zip.setreg(zip.pcreg(), hexval(ptr));
+		if (pkt[0] == 'c')
+			alive = zip.cont(gdb);
+		else
+			alive = zip.step(gdb);
+		if (!alive)
+			return false;
+		sprintf(reply, "S%02x", zip.m_signal);
+		} break;
+	case 'Z': case 'z': {
+		unsigned	a;
+
+		// Only software breakpoints, and only in RAM
+		if (*ptr++ != '0')
+			break;
+		if (*ptr++ != ',') {
+			strcpy(reply, "E01");
+			break;
+		}
+		a = hexval(ptr);
+		if (pkt[0] == 'z') {
+			zip.clear_bkpt(a);
+			strcpy(reply, "OK");
+		} else if (zip.set_bkpt(a))
+			strcpy(reply, "OK");
+		else
+			strcpy(reply, "E01");
+		} break;
+	case 'D':
+		// Detach, leaving the CPU running
+		zip.detach();
+		gdb.reply("OK");
+		return false;
+	case 'k':
+		// Kill, leaving the CPU reset and halted.  No reply.
+		zip.reset();
+		return false;
+	case 'H': case 'T':
+		strcpy(reply, "OK");
+		break;
+	case 'q':
+		if (strncmp(pkt, "qSupported", 10)==0)
+			sprintf(reply, "PacketSize=%x;QStartNoAckMode+", MAXPKT);
+		else if (strcmp(pkt, "qAttached")==0)
+			strcpy(reply, "1");
+		break;
+	case 'Q':
+		if (strcmp(pkt, "QStartNoAckMode")==0) {
+			gdb.reply("OK");
+			gdb.noack();
+			return true;
+		} break;
+	default:
+		// Anything else, we don't support
+		break;
+	}
+
+	gdb.reply(reply);
+	return true;
+}
+
+int	setup_listener(const int port) {
+	int	skt;
+	struct  sockaddr_in     my_addr;
+
+	skt = socket(AF_INET, SOCK_STREAM, 0);
+	if (skt < 0) {
+		perror("Could not allocate socket: ");
+		exit(EXIT_FAILURE);
+	}
+
+	// Set the reuse address option
+	{
+		int optv = 1, er;
+		er = setsockopt(skt, SOL_SOCKET, SO_REUSEADDR, &optv, sizeof(optv));
+		if (er != 0) {
+			perror("SockOpt Err:");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	memset(&my_addr, 0, sizeof(struct sockaddr_in)); // clear structure
+	my_addr.sin_family = AF_INET;
+	my_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	my_addr.sin_port = htons(port);
+
+	if (bind(skt, (struct sockaddr *)&my_addr, sizeof(my_addr))!=0) {
+		perror("BIND FAILED:");
+		exit(EXIT_FAILURE);
+	}
+
+	if (listen(skt, 1) != 0) {
+		perror("Listen failed:");
+		exit(EXIT_FAILURE);
+	}
+
+	return skt;
+}
+
+void	usage(void) {
+	printf("USAGE: zipgdbserver [-hv] [-p <port>]\n");
+	printf("\n"
+"\t-h\tDisplay this usage statement\n"
+"\t-p <port>\tListen for GDB on this TCP port, rather than %d\n"
+"\t-v\tShow the bus transactions each GDB command takes\n", GDBPORT);
+}
+
+int main(int argc, char **argv) {
+#ifndef	R_ZIPCTRL
+	fprintf(stderr, "This design doesn\'t seem to contain a ZipCPU\n");
+	return	EXIT_FAILURE;
+#else
+	int	skp, port = GDBPORT, skt;
+
+	skp=1;
+	for(int argn=0; argn<argc-skp; argn++) {
+		if (argv[argn+skp][0] == '-') {
+			switch(argv[argn+skp][1]) {
+			case 'h':
+				usage();
+				exit(EXIT_SUCCESS);
+				break;
+			case 'p':
+				if (argn+skp+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				port = atoi(argv[argn+skp+1]);
+				skp++;
+				break;
+			case 'v':
+				gbl_verbose = true;
+				break;
+			default:
+				fprintf(stderr, "Unknown option, -%c\n\n",
+					argv[argn+skp][1]);
+				usage();
+				exit(EXIT_FAILURE);
+				break;
+			} skp++; argn--;
+		} else
+			argv[argn] = argv[argn+skp];
+	} argc -= skp;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	FPGAOPEN(m_fpga);
+	GDBBUS	bus(m_fpga);
+	ZIPGDB	zip(&bus);
+
+	skt = setup_listener(port);
+	while(1) {
+		char	*pkt = new char[MAXPKT], *reply = new char[2*MAXPKT+8];
+		int	fd;
+
+		printf("Waiting for GDB on port %d\n", port);
+		fd = accept(skt, NULL, NULL);
+		if (fd < 0) {
+			perror("Accept failed:");
+			exit(EXIT_FAILURE);
+		}
+
+		try {
+			GDBLINK	gdb(fd);
+
+			// Attaching stops the CPU
+			zip.halt();
+			zip.release();
+			zip.m_signal = GDB_SIGTRAP;
+
+			while(gdb.get(pkt)) {
+				unsigned long	calls = bus.m_calls,
+						words = bus.m_words;
+				bool		alive;
+
+				alive = command(zip, gdb, pkt, reply);
+
+				CMDSTATS &st = gbl_stats[pkt[0] & 0x07f];
+				st.m_count++;
+				st.m_calls += bus.m_calls - calls;
+				st.m_words += bus.m_words - words;
+				if (gbl_verbose)
+					fprintf(stderr, "%-16.16s %4lu xfers, %6lu words\n",
+						pkt, bus.m_calls - calls,
+						bus.m_words - words);
+				if (!alive)
+					break;
+			}
+		} catch(BUSERR b) {
+			fprintf(stderr, "ERR: Bus error at 0x%08x\n", b.addr);
+		}
+
+		close(fd);
+		delete[] pkt;
+		delete[] reply;
+		printf("GDB disconnected\n");
+		print_stats();
+	}
+#endif
+}
@@ -0,0 +1,254 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	zippack.cpp
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Compresses a boot image, for the decompressing bootloader
+//		in sw/zlib/crt0.c (built with -D_ZIP_LZBOOT).  The format is
+//	that of an LZ4 block, preceded by the uncompressed length as a 32-bit
+//	big-endian word:
+//
+//	[len:32]  { token, [literal length], literals, offset, [match length] }*
+//
+//	Each token holds the number of literals in its upper nibble, and the
+//	match length less four in its lower.  A nibble of 15 is extended by
+//	the bytes that follow, for as long as they are 255.  Match offsets are
+//	16-bit little-endian, as in LZ4.  The last sequence has literals only.
+//
+//	The decompressor has to be tiny, and has to run from flash, so all of
+//	the work is done here instead: matches are found by searching a hash
+//	chain rather than taking the first candidate.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#define	MINMATCH	4
+#define	MAXOFFSET	65535
+#define	HASHBITS	16
+#define	MAXCHAIN	256
+// As with LZ4, the last five bytes are always literals, and no match may
+// start within twelve bytes of the end
+#define	LASTLITERALS	5
+#define	MFLIMIT		12
+
+void	usage(void) {
+	printf("USAGE: zippack [-hv] <binary-image> <compressed-image>\n");
+	printf("\n"
+"\t-h\tDisplay this usage statement\n"
+"\t-v\tReport the compressed size\n");
+}
+
+static unsigned	hash4(const uint8_t *p) {
+	uint32_t	v = (p[0]<<24)|(p[1]<<16)|(p[2]<<8)|p[3];
+
+	return (v * 2654435761u) >> (32-HASHBITS);
+}
+
+// Write a length nibble's extension bytes
+static uint8_t	*putlen(uint8_t *op, unsigned n) {
+	while(n >= 255) {
+		*op++ = 255;
+		n -= 255;
+	} *op++ = n;
+	return op;
+}
+
+static uint8_t	*putseq(uint8_t *op, const uint8_t *lit, unsigned nlit,
+		unsigned offset, unsigned mlen) {
+	uint8_t	*tok = op++;
+	unsigned	ml = (mlen) ? mlen - MINMATCH : 0;
+
+	*tok = ((nlit >= 15) ? 15 : nlit) << 4;
+	if (nlit >= 15)
+		op = putlen(op, nlit - 15);
+	memcpy(op, lit, nlit);
+	op += nlit;
+
+	if (mlen == 0)
+		return op;
+
+	*op++ = offset & 0x0ff;
+	*op++ = (offset >> 8) & 0x0ff;
+	*tok |= (ml >= 15) ? 15 : ml;
+	if (ml >= 15)
+		op = putlen(op, ml - 15);
+	return op;
+}
+
+//
+// lzpack
+//
+// Compress len bytes from src into dst, returning the compressed length.
+// dst must have room for the worst case, len + len/255 + 16 bytes.
+//
+unsigned	lzpack(const uint8_t *src, unsigned len, uint8_t *dst) {
+	int		*head, *prev;
+	const uint8_t	*anchor = src, *ip = src, *end = src + len;
+	uint8_t		*op = dst;
+
+	head = new int[1<<HASHBITS];
+	prev = new int[len+1];
+	for(int k=0; k<(1<<HASHBITS); k++)
+		head[k] = -1;
+
+	*op++ = (len >> 24) & 0x0ff;
+	*op++ = (len >> 16) & 0x0ff;
+	*op++ = (len >>  8) & 0x0ff;
+	*op++ = (len      ) & 0x0ff;
+
+	while((len >= MFLIMIT)&&(ip <= end - MFLIMIT)) {
+		unsigned	h = hash4(ip), pos = ip - src;
+		unsigned	best = 0, boff = 0, chain = 0;
+		const uint8_t	*mlimit = end - LASTLITERALS;
+
+		for(int c = head[h]; (c >= 0)&&(pos - c <= MAXOFFSET)
+					&&(chain < MAXCHAIN); c = prev[c], chain++) {
+			const uint8_t	*a = ip, *b = src + c;
+
+			while((a < mlimit)&&(*a == *b)) {
+				a++; b++;
+			}
+
+			if ((unsigned)(a - ip) > best) {
+				best = a - ip;
+				boff = pos - c;
+			}
+		}
+
+		if (best < MINMATCH) {
+			prev[pos] = head[h];
+			head[h] = pos;
+			ip++;
+			continue;
+		}
+
+		op = putseq(op, anchor, ip - anchor, boff, best);
+
+		// Index every position the match covers
+		for(unsigned k=0; k<best; k++, ip++) {
+			if (ip + MINMATCH > end)
+				continue;
+			pos = ip - src;
+			h = hash4(ip);
+			prev[pos] = head[h];
+			head[h] = pos;
+		} anchor = ip;
+	}
+
+	op = putseq(op, anchor, end - anchor, 0, 0);
+
+	delete[] head;
+	delete[] prev;
+	return op - dst;
+}
+
+int main(int argc, char **argv) {
+	bool		verbose = false;
+	int		skp;
+	FILE		*fp;
+	uint8_t		*ibuf, *obuf;
+	long		ilen;
+	unsigned	olen;
+
+	skp=1;
+	for(int argn=0; argn<argc-skp; argn++) {
+		if (argv[argn+skp][0] == '-') {
+			switch(argv[argn+skp][1]) {
+			case 'h':
+				usage();
+				exit(EXIT_SUCCESS);
+				break;
+			case 'v':
+				verbose = true;
+				break;
+			default:
+				fprintf(stderr, "Unknown option, -%c\n\n",
+					argv[argn+skp][1]);
+				usage();
+				exit(EXIT_FAILURE);
+				break;
+			} skp++; argn--;
+		} else
+			argv[argn] = argv[argn+skp];
+	} argc -= skp;
+
+	if (argc != 2) {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	fp = fopen(argv[0], "rb");
+	if (!fp) {
+		fprintf(stderr, "Could not open %s\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	fseek(fp, 0l, SEEK_END);
+	ilen = ftell(fp);
+	fseek(fp, 0l, SEEK_SET);
+
+	ibuf = new uint8_t[ilen+1];
+	obuf = new uint8_t[ilen + ilen/255 + 16];
+	if ((long)fread(ibuf, 1, ilen, fp) != ilen) {
+		fprintf(stderr, "Could not read %s\n", argv[0]);
+		exit(EXIT_FAILURE);
+	} fclose(fp);
+
+	olen = lzpack(ibuf, ilen, obuf);
+
+	// The bootloader reads nothing past the compressed data, but pad to
+	// a whole word anyway, so the section that follows stays aligned
+	while(olen & 3)
+		obuf[olen++] = 0;
+
+	fp = fopen(argv[1], "wb");
+	if (!fp) {
+		fprintf(stderr, "Could not open %s for writing\n", argv[1]);
+		exit(EXIT_FAILURE);
+	}
+	if (fwrite(obuf, 1, olen, fp) != olen) {
+		fprintf(stderr, "Could not write %s\n", argv[1]);
+		exit(EXIT_FAILURE);
+	} fclose(fp);
+
+	if (verbose)
+		printf("%s: %ld bytes packed into %u (%ld%%)\n", argv[0],
+			ilen, olen, (ilen) ? (100l * olen + ilen/2) / ilen : 0);
+
+	delete[] ibuf;
+	delete[] obuf;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,220 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zipprof.cpp
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Collects the samples taken by the ZipCPU's sampling profiler,
+//		sw/zlib/zprof.c, and turns them into a profile.  The
+//	profiler's buffer, _zprof, is found from the program's ELF symbol
+//	table, read over the debug bus, and each sampled PC is then attributed
+//	to the function containing it.
+//
+//	The buffer may be read while the program is still running, although
+//	the last few samples may then be in flux.  Call zprof_stop(), or halt
+//	the CPU, for an exact snapshot.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <strings.h>
+#include <ctype.h>
+#include <string.h>
+#include <signal.h>
+#include <assert.h>
+
+#include "port.h"
+#include "regdefs.h"
+#include "ttybus.h"
+#include "zipelf.h"
+#include "symtab.h"
+#include "profile.h"
+
+// These must match sw/zlib/zprof.h
+#define	ZPROF_MAGIC	0x5a50524f
+#define	ZPROF_HDRWORDS	4
+
+// Upper limit on the samples we'll believe the header about
+#define	ZPROF_MAXSAMPLES	(1<<20)
+
+FPGA	*m_fpga;
+void	closeup(int v) {
+	m_fpga->kill();
+	exit(0);
+}
+
+void	usage(void) {
+	printf("USAGE: zipprof [-h] [-a addr] [-n count] [-p] <zip-program-file>\n"
+"\n"
+"\t-h\tDisplay this usage statement\n"
+"\t-a addr\tRead the sample buffer from addr, rather than from the address\n"
+"\t\tof _zprof in the program file\n"
+"\t-n count\tList only the count most frequently sampled functions\n"
+"\t-p\tAlso list the most frequently sampled individual addresses\n");
+}
+
+static int
+pccmp(const void *va, const void *vb) {
+	unsigned	a = *(const unsigned *)va, b = *(const unsigned *)vb;
+
+	return (a < b) ? -1 : (a > b);
+}
+
+int main(int argc, char **argv) {
+	int		skp, nsyms, maxlist = 0;
+	bool		addr_given = false, list_pcs = false;
+	unsigned	addr = 0, hdr[ZPROF_HDRWORDS];
+	const char	*execfile = NULL;
+	ELFSYMBOL	**elfsym;
+	SYMTAB		sym;
+
+	skp=1;
+	for(int argn=0; argn<argc-skp; argn++) {
+		if (argv[argn+skp][0] == '-') {
+			switch(argv[argn+skp][1]) {
+			case 'a':
+				if (argn+skp+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				addr = strtoul(argv[argn+skp+1], NULL, 0);
+				addr_given = true;
+				skp++;
+				break;
+			case 'h':
+				usage();
+				exit(EXIT_SUCCESS);
+				break;
+			case 'n':
+				if (argn+skp+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				maxlist = atoi(argv[argn+skp+1]);
+				skp++;
+				break;
+			case 'p':
+				list_pcs = true;
+				break;
+			default:
+				fprintf(stderr, "Unknown option, -%c\n\n",
+					argv[argn+skp][1]);
+				usage();
+				exit(EXIT_FAILURE);
+				break;
+			} skp++; argn--;
+		} else
+			argv[argn] = argv[argn+skp];
+	} argc -= skp;
+
+	if (argc != 1) {
+		usage();
+		exit(EXIT_FAILURE);
+	} execfile = argv[0];
+
+	if ((access(execfile, R_OK)!=0)||(!iself(execfile))) {
+		fprintf(stderr, "Cannot open executable, %s\n", execfile);
+		exit(EXIT_FAILURE);
+	}
+
+	nsyms = elfsymbols(execfile, elfsym);
+	if (nsyms == 0) {
+		fprintf(stderr, "No symbols found in %s.  Has it been stripped?\n",
+			execfile);
+		exit(EXIT_FAILURE);
+	}
+
+	sym.add(elfsym, nsyms);
+	free(elfsym);
+
+	if (!addr_given) {
+		int	k = sym.find("_zprof");
+		if (k < 0) {
+			fprintf(stderr, "%s doesn\'t contain _zprof.  Was it linked with zprof.o?\n", execfile);
+			exit(EXIT_FAILURE);
+		} addr = sym[k].m_addr;
+	}
+
+	FPGAOPEN(m_fpga);
+	signal(SIGSTOP, closeup);
+	signal(SIGHUP, closeup);
+
+	unsigned	*pc = NULL, nsamples;
+	try {
+		m_fpga->readi(addr, ZPROF_HDRWORDS, hdr);
+
+		if (hdr[0] != ZPROF_MAGIC) {
+			fprintf(stderr, "No profile found at 0x%08x.  Has zprof_start() been called?\n", addr);
+			exit(EXIT_FAILURE);
+		} if ((hdr[2] == 0)||(hdr[2] > ZPROF_MAXSAMPLES)) {
+			fprintf(stderr, "Invalid sample buffer size, %u\n", hdr[2]);
+			exit(EXIT_FAILURE);
+		}
+
+		nsamples = (hdr[3] < hdr[2]) ? hdr[3] : hdr[2];
+		pc = new unsigned[nsamples+1];
+		if (nsamples > 0)
+			m_fpga->readi(addr + ZPROF_HDRWORDS * 4, nsamples, pc);
+	} catch(BUSERR b) {
+		fprintf(stderr, "BUS-ERR @0x%08x\n", b.addr);
+		exit(EXIT_FAILURE);
+	}
+
+	m_fpga->kill();
+
+	printf("%u samples, one every %u clocks", hdr[3], hdr[1]);
+	if (hdr[3] > hdr[2])
+		printf(", only the last %u of which were kept", hdr[2]);
+	printf("\n\n");
+
+	if (nsamples == 0)
+		exit(EXIT_SUCCESS);
+
+	// Sort the PCs, then count the runs
+	unsigned	*count = new unsigned[nsamples], npcs = 0;
+
+	qsort(pc, nsamples, sizeof(unsigned), pccmp);
+	for(unsigned k=0; k<nsamples; k++) {
+		if ((npcs > 0)&&(pc[npcs-1] == pc[k])) {
+			count[npcs-1]++;
+			continue;
+		}
+		pc[npcs] = pc[k];
+		count[npcs++] = 1;
+	}
+
+	profile(sym, npcs, pc, count, nsamples, maxlist, list_pcs);
+
+	delete[] count;
+	delete[] pc;
+}
@@ -0,0 +1,225 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	zipsnap.cpp
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Captures the state of a ZipCPU, in as few round trips across
+//		the debug bus as possible.  See zipsnap.h.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "regdefs.h"
+#include "zopcodes.h"
+#include "zipsnap.h"
+
+// The most memory words we'll read: the last PC, the straight line path
+// from the word before the PC, the stack, and then the rest of the
+// instructions following each branch
+#define	MAXPOOL	(1+ZIPSNAP_NIMEM+ZIPSNAP_NSMEM+ZIPSNAP_NIMEM*ZIPSNAP_NIMEM)
+
+// A word of the pool.  Instruction words (m_code) may come from, and go to,
+// the instruction cache.  Only those with m_fetch set need to be read.
+class	SNAPWORD : public SPARSEMEM {
+public:
+	bool	m_fetch, m_code;
+};
+
+//
+// Adds n words, starting at address a, to the pool of words to be read.
+// If given a state to look in, these are instruction words, and any found
+// in its cache won't be read again.
+//
+static void
+snapqueue(unsigned a, int n, SNAPWORD *pool, int &npool, ZIPSTATE *st) {
+	for(int i=0; i<n; i++, a+=4) {
+		SNAPWORD	&w = pool[npool++];
+
+		w.m_a = a;
+		w.m_valid = false;
+		w.m_d = 0;
+		w.m_fetch = true;
+		w.m_code = (st != NULL);
+		if (st) {
+			const SPARSEMEM &c = st->m_icache[(a>>2)&(ZIPSNAP_NICACHE-1)];
+			if ((c.m_valid)&&(c.m_a == a)) {
+				w.m_valid = true;
+				w.m_d = c.m_d;
+				w.m_fetch = false;
+			}
+		}
+	}
+}
+
+//
+// Reads every word in the pool from first on that still needs reading, all
+// in one round trip, caching the instruction words
+//
+static void
+snapfetch(DEVBUS *fpga, SNAPWORD *pool, int first, int npool, ZIPSTATE &st) {
+	BUSOP	ops[MAXPOOL];
+	int	nops = 0;
+
+	for(int i=first; i<npool; i++) {
+		if ((pool[i].m_fetch)&&(pool[i].m_a & 3))
+			pool[i].m_fetch = false;
+		if (pool[i].m_fetch)
+			ops[nops++] = BUSOP(pool[i].m_a);
+	}
+
+	if (nops == 0)
+		return;
+	fpga->pipeline(nops, ops);
+	st.m_ntrips++;
+
+	for(int i=first, k=0; i<npool; i++) {
+		if (!pool[i].m_fetch)
+			continue;
+		pool[i].m_valid = !ops[k].m_err;
+		pool[i].m_d     =  ops[k].m_data;
+		pool[i].m_fetch = false;
+		k++;
+
+		if ((pool[i].m_code)&&(pool[i].m_valid))
+			st.m_icache[(pool[i].m_a>>2)&(ZIPSNAP_NICACHE-1)]
+				= pool[i];
+	}
+}
+
+static bool
+snaplookup(unsigned a, const SNAPWORD *pool, int npool, SPARSEMEM &m) {
+	for(int i=0; i<npool; i++)
+		if (pool[i].m_a == a) {
+			m = pool[i];
+			return true;
+		}
+	return false;
+}
+
+void	zipsnap(DEVBUS *fpga, ZIPSTATE &st) {
+	BUSOP		ops[2*ZIPSNAP_NREGS+1+ZIPSNAP_NSMEM];
+	SNAPWORD	pool[MAXPOOL];
+	int		nops = 0, npool = 0;
+	unsigned	oldsp = st.m_sp;
+	bool		guess_sp;
+
+	// If we know where the stack was, it's probably still there
+	guess_sp = (st.m_valid)&&((oldsp & 3)==0);
+	st.m_valid = false;
+	st.m_ntrips = 0;
+
+	//
+	// First round trip: all of the registers.  Selecting a register
+	// halts the CPU.  Then the control register, now that we're halted,
+	// and the stack where we last saw it.
+	//
+	for(int i=0; i<ZIPSNAP_NREGS; i++) {
+		ops[nops++] = BUSOP(R_ZIPCTRL, CPU_HALT|i);
+		ops[nops++] = BUSOP(R_ZIPDATA);
+	}
+	ops[nops++] = BUSOP(R_ZIPCTRL);
+	if (guess_sp) for(int i=0; i<ZIPSNAP_NSMEM; i++)
+		ops[nops++] = BUSOP(oldsp + 4*i);
+	fpga->pipeline(nops, ops);
+	st.m_ntrips++;
+
+	for(int i=0; i<16; i++)
+		st.m_sR[i] = ops[2*i+1].m_data;
+	for(int i=0; i<16; i++)
+		st.m_uR[i] = ops[2*(i+16)+1].m_data;
+	for(int i=0; i<20; i++)
+		st.m_p[i]  = ops[2*(i+32)+1].m_data;
+	st.m_ctrl = ops[2*ZIPSNAP_NREGS].m_data;
+
+	st.m_gie = (st.m_sR[14] & 0x020);
+	st.m_pc  = (st.m_gie) ? (st.m_uR[15]):(st.m_sR[15]);
+	st.m_sp  = (st.m_gie) ? (st.m_uR[13]):(st.m_sR[13]);
+
+	if ((guess_sp)&&(st.m_sp == oldsp)) {
+		for(int i=0; i<ZIPSNAP_NSMEM; i++) {
+			const BUSOP	&op = ops[2*ZIPSNAP_NREGS+1+i];
+
+			snapqueue(op.m_addr, 1, pool, npool, NULL);
+			pool[npool-1].m_valid = !op.m_err;
+			pool[npool-1].m_d     =  op.m_data;
+			pool[npool-1].m_fetch =  false;
+		}
+	} else
+		snapqueue(st.m_sp, ZIPSNAP_NSMEM, pool, npool, NULL);
+
+	//
+	// Second round trip, if it's needed at all: whatever we don't
+	// already have of the instruction before the PC, the PC and those
+	// following it in a straight line, and the stack
+	//
+	st.m_imem[0].m_a = (st.m_last_pc_valid) ? st.m_last_pc : st.m_pc - 4;
+	if (st.m_imem[0].m_a != st.m_pc - 4)
+		snapqueue(st.m_imem[0].m_a, 1, pool, npool, &st);
+	snapqueue(st.m_pc - 4, ZIPSNAP_NIMEM, pool, npool, &st);
+	snapfetch(fpga, pool, 0, npool, st);
+
+	st.m_imem[0].m_valid = false;
+	snaplookup(st.m_imem[0].m_a, pool, npool, st.m_imem[0]);
+	st.m_imem[1].m_a = st.m_pc;
+	st.m_imem[1].m_valid = false;
+	snaplookup(st.m_pc, pool, npool, st.m_imem[1]);
+
+	//
+	// Follow the instruction stream, reading more only where it branches
+	// somewhere we haven't read
+	//
+	for(int i=1; i<ZIPSNAP_NIMEM-1; i++) {
+		unsigned	next;
+
+		if (!st.m_imem[i].m_valid) {
+			st.m_imem[i+1].m_valid = false;
+			st.m_imem[i+1].m_a = st.m_imem[i].m_a+4;
+			continue;
+		}
+
+		next = zop_early_branch(st.m_imem[i].m_a, st.m_imem[i].m_d);
+		if (!snaplookup(next, pool, npool, st.m_imem[i+1])) {
+			int	first = npool;
+
+			snapqueue(next, ZIPSNAP_NIMEM-1-i, pool, npool, &st);
+			snapfetch(fpga, pool, first, npool, st);
+			snaplookup(next, pool, npool, st.m_imem[i+1]);
+		}
+	}
+
+	for(int i=0; i<ZIPSNAP_NSMEM; i++)
+		snaplookup(st.m_sp+4*i, pool, npool, st.m_smem[i]);
+
+	st.m_valid = true;
+}
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	zipsnap.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Captures the state of a (halted) ZipCPU over the debug port:
+//		every register, the instructions around the PC, and the top
+//	of the stack.  This is shared by zipdbg and zipstate.
+//
+//	Rather than reading each register with its own write to R_ZIPCTRL,
+//	poll of R_ZIPCTRL, and read of R_ZIPDATA--three round trips apiece--the
+//	whole set is sent as one DEVBUS::pipeline().  No poll is needed, since
+//	a read of R_ZIPDATA stalls the bus until the CPU has halted.  The
+//	memory around the PC and stack follows in a second round trip.  Only
+//	when an instruction branches does it cost another.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	ZIPSNAP_H
+#define	ZIPSNAP_H
+
+#include "devbus.h"
+
+// Register numbers, as written to R_ZIPCTRL: 16 supervisor, 16 user, and
+// then 20 of the ZipSystem's peripherals
+#define	ZIPSNAP_NREGS	52
+#define	ZIPSNAP_NIMEM	5
+#define	ZIPSNAP_NSMEM	5
+// Instruction words kept from one snapshot to the next, a power of two
+#define	ZIPSNAP_NICACHE	64
+
+class	SPARSEMEM {
+public:
+	bool	m_valid;
+	unsigned int	m_a, m_d;
+};
+
+class	ZIPSTATE {
+public:
+	bool		m_valid, m_gie, m_last_pc_valid;
+	unsigned int	m_sR[16], m_uR[16];
+	unsigned int	m_p[20];
+	unsigned int	m_last_pc, m_pc, m_sp;
+	unsigned int	m_ctrl;		// R_ZIPCTRL, once halted
+	unsigned int	m_ntrips;	// Round trips the last snapshot took
+	SPARSEMEM	m_smem[ZIPSNAP_NSMEM];
+	SPARSEMEM	m_imem[ZIPSNAP_NIMEM];
+	// Instruction words, by address.  These are assumed not to change
+	// while the CPU is halted or stepping, so anything writing to memory
+	// needs to invalidate() what it writes.
+	SPARSEMEM	m_icache[ZIPSNAP_NICACHE];
+	ZIPSTATE(void) : m_valid(false), m_last_pc_valid(false), m_ntrips(0) {
+		flush();
+	}
+
+	void	step(void) {
+		m_last_pc_valid = true;
+		m_last_pc = m_pc;
+	}
+
+	void	flush(void) {
+		for(int i=0; i<ZIPSNAP_NICACHE; i++)
+			m_icache[i].m_valid = false, m_icache[i].m_a = 0;
+	}
+
+	// Forget any cached words within the len words starting at a
+	void	invalidate(unsigned a, unsigned len) {
+		if (len >= ZIPSNAP_NICACHE)
+			flush();
+		else for(unsigned k=0; k<len; k++, a+=4) {
+			SPARSEMEM &m = m_icache[(a>>2)&(ZIPSNAP_NICACHE-1)];
+			if (m.m_a == (a & -4))
+				m.m_valid = false;
+		}
+	}
+};
+
+// Halts the CPU, if it wasn't already, and fills in st.  m_imem[0] holds
+// the last PC stepped from (or the word before the PC), m_imem[1] the PC,
+// and the rest the instructions expected to follow it.  m_smem[] holds the
+// words starting at the stack pointer.  Instruction words are taken from
+// st.m_icache where present, and the stack is read along with the registers
+// whenever it's where the last snapshot left it, so stepping through a loop
+// normally costs a single round trip.
+extern	void	zipsnap(DEVBUS *fpga, ZIPSTATE &st);
+
+#endif
@@ -9,6 +9,17 @@
 //	identical to a "wbregs cpu" command, save that the bit fields of the
 //	result are broken out into something more human readable.
 //
+//	With -s, zipstate instead samples the CPU's program counter while
+//	it runs, and produces a flat profile from the samples, symbolized
+//	against the program's ELF file.  No changes to the firmware are
+//	needed for this, unlike zipprof.  The registers can only be read
+//	while the CPU is halted, so each sample halts the CPU, reads both
+//	PCs and the control register (telling which mode it was in), and then
+//	releases it again.  SAMPLE_BATCH of these go out in each round trip,
+//	so the samples come as quickly as the link can carry them.  The CPU
+//	is stopped for a few bus cycles per sample, while its peripherals
+//	carry on, so timer driven code will look a touch heavier than it is.
+//
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -47,61 +58,230 @@
 #include <string.h>
 #include <signal.h>
 #include <assert.h>
+#include <time.h>
 
 #include "port.h"
 #include "llcomms.h"
 #include "regdefs.h"
 #include "ttybus.h"
+#include "zipsnap.h"
+#include "zipelf.h"
+#include "symtab.h"
+#include "profile.h"
+
+// Samples per round trip.  Each takes six bus operations.
+#define	SAMPLE_BATCH	40
+#define	SAMPLE_OPS	6
+#define	CTRL_GIE	0x02000	// R_ZIPCTRL, the CPU is in user mode
 
 FPGA	*m_fpga;
+bool	gbl_stop = false;
+
 void	closeup(int v) {
 	m_fpga->kill();
 	exit(0);
 }
 
-unsigned int	cmd_read(FPGA *fpga, int r) {
-	const unsigned int	MAXERR = 1000;
-	unsigned int	errcount = 0;
-	unsigned int	s;
-
-	fpga->writeio(R_ZIPCTRL, CPU_HALT|(r&0x03f));
-	while((((s = fpga->readio(R_ZIPCTRL))&CPU_STALL)== 0)&&(errcount<MAXERR))
-		errcount++;
-	if (errcount >= MAXERR) {
-		printf("ERR: errcount(%d) >= MAXERR on cmd_read(a=%02x)\n",
-			errcount, r);
-		printf("ZIPCTRL = 0x%08x", s);
-		if ((s & 0x0200)==0) printf(" BUSY");
-		if  (s & 0x0400)     printf(" HALTED");
-		if ((s & 0x03000)==0x01000)
-			printf(" SW-HALT");
-		else {
-			if (s & 0x01000) printf(" SLEEPING");
-			if (s & 0x02000) printf(" GIE(UsrMode)");
-		} printf("\n");
-		exit(EXIT_FAILURE);
-	} return fpga->readio(R_ZIPDATA);
+// Stop sampling, and report what we have
+void	stop_sampling(int v) {
+	gbl_stop = true;
 }
 
 void	usage(void) {
-	printf("USAGE: zipstate\n");
+	printf("USAGE: zipstate [-l]\n"
+"       zipstate -s <nsamples> [-n count] [-p] <zip-program-file>\n"
+"\n"
+"\t-l\tHalt the CPU, and list its registers\n"
+"\t-s nsamples\tSample the PC of the running CPU this many times, or until\n"
+"\t\tinterrupted, and then list a profile\n"
+"\t-n count\tList only the count most frequently sampled functions\n"
+"\t-p\tAlso list the most frequently sampled individual addresses\n");
+}
+
+//
+// PCHIST
+//
+// A histogram of the PCs sampled, kept in an open addressed hash table
+// which doubles in size whenever it becomes half full
+//
+class	PCHIST {
+	void	alloc(unsigned sz) {
+		m_size = sz;
+		m_pc = new unsigned[sz];
+		m_count = new unsigned[sz];
+		memset(m_count, 0, sz * sizeof(unsigned));
+	}
+
+	unsigned	slot(unsigned pc) const {
+		unsigned	h = ((pc >> 1) * 2654435761u) & (m_size-1);
+		while((m_count[h] != 0)&&(m_pc[h] != pc))
+			h = (h+1) & (m_size-1);
+		return h;
+	}
+public:
+	unsigned	*m_pc, *m_count, m_size, m_used;
+
+	PCHIST(void) : m_used(0) { alloc(1024); }
+	~PCHIST(void) { delete[] m_pc; delete[] m_count; }
+
+	void	add(unsigned pc) {
+		unsigned	h = slot(pc);
+
+		if (m_count[h] == 0) {
+			if (2*(m_used+1) > m_size) {
+				unsigned *opc = m_pc, *ocount = m_count,
+					osz = m_size;
+
+				alloc(2*osz);
+				for(unsigned k=0; k<osz; k++) {
+					if (ocount[k] == 0)
+						continue;
+					unsigned n = slot(opc[k]);
+					m_pc[n] = opc[k];
+					m_count[n] = ocount[k];
+				}
+				delete[] opc;
+				delete[] ocount;
+				h = slot(pc);
+			}
+			m_pc[h] = pc;
+			m_used++;
+		}
+		m_count[h]++;
+	}
+};
+
+//
+// Reads the PC of the running CPU, nsamples times over, SAMPLE_BATCH at a
+// time.  Returns the number of samples actually taken.
+//
+static unsigned
+sample(DEVBUS *fpga, unsigned nsamples, PCHIST &hist) {
+	BUSOP		ops[SAMPLE_BATCH*SAMPLE_OPS];
+	unsigned	taken = 0;
+
+	while((taken < nsamples)&&(!gbl_stop)) {
+		unsigned	n = nsamples - taken;
+		int		nops = 0;
+
+		if (n > SAMPLE_BATCH)
+			n = SAMPLE_BATCH;
+		for(unsigned k=0; k<n; k++) {
+			ops[nops++] = BUSOP(R_ZIPCTRL, CPU_HALT|CPU_sPC);
+			ops[nops++] = BUSOP(R_ZIPDATA);
+			ops[nops++] = BUSOP(R_ZIPCTRL, CPU_HALT|CPU_uPC);
+			ops[nops++] = BUSOP(R_ZIPDATA);
+			ops[nops++] = BUSOP(R_ZIPCTRL);
+			ops[nops++] = BUSOP(R_ZIPCTRL, CPU_GO);
+		}
+		fpga->pipeline(nops, ops);
+
+		for(unsigned k=0; k<n; k++) {
+			const BUSOP	*op = &ops[k*SAMPLE_OPS];
+			hist.add((op[4].m_data & CTRL_GIE)
+				? op[3].m_data : op[1].m_data);
+		}
+		taken += n;
+	}
+
+	return taken;
 }
 
 int main(int argc, char **argv) {
-	bool	long_state = false;
-	unsigned int	v;
-	int	skp;
+	bool	long_state = false, list_pcs = false;
+	unsigned int	v, nsamples = 0;
+	int	skp, maxlist = 0;
 
 	skp=1;
 	for(int argn=0; argn<argc-skp; argn++) {
 		if (argv[argn+skp][0] == '-') {
-			if (argv[argn+skp][1] == 'l')
+			switch(argv[argn+skp][1]) {
+			case 'h':
+				usage();
+				exit(EXIT_SUCCESS);
+				break;
+			case 'l':
 				long_state = true;
-			skp++; argn--;
+				break;
+			case 'n':
+				if (argn+skp+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				maxlist = atoi(argv[argn+skp+1]);
+				skp++;
+				break;
+			case 'p':
+				list_pcs = true;
+				break;
+			case 's':
+				if (argn+skp+1 >= argc) {
+					usage();
+					exit(EXIT_FAILURE);
+				}
+				nsamples = strtoul(argv[argn+skp+1], NULL, 0);
+				skp++;
+				break;
+			default:
+				break;
+			} skp++; argn--;
 		} else
 			argv[argn] = argv[argn+skp];
 	} argc -= skp;
 
+	if (nsamples > 0) {
+		ELFSYMBOL	**elfsym;
+		SYMTAB		sym;
+		PCHIST		hist;
+		int		nsyms;
+		struct timespec	start, stop;
+		double		secs;
+
+		if ((argc != 1)||(access(argv[0], R_OK)!=0)||(!iself(argv[0]))) {
+			fprintf(stderr, "Sampling needs the program\'s ELF file\n");
+			usage();
+			exit(EXIT_FAILURE);
+		}
+
+		nsyms = elfsymbols(argv[0], elfsym);
+		if (nsyms == 0) {
+			fprintf(stderr, "No symbols found in %s.  Has it been stripped?\n",
+				argv[0]);
+			exit(EXIT_FAILURE);
+		} sym.add(elfsym, nsyms);
+		free(elfsym);
+
+		FPGAOPEN(m_fpga);
+
+		// Sampling would release a halted CPU
+		if (m_fpga->readio(R_ZIPCTRL) & CPU_HALT) {
+			fprintf(stderr, "The CPU is halted, so there\'s nothing to sample\n");
+			exit(EXIT_FAILURE);
+		}
+
+		signal(SIGINT, stop_sampling);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		try {
+			nsamples = sample(m_fpga, nsamples, hist);
+		} catch(BUSERR b) {
+			fprintf(stderr, "BUS-ERR @0x%08x\n", b.addr);
+			exit(EXIT_FAILURE);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &stop);
+		signal(SIGINT, SIG_DFL);
+
+		secs = (stop.tv_sec - start.tv_sec)
+			+ (stop.tv_nsec - start.tv_nsec) * 1e-9;
+		printf("%u samples in %.2f seconds, %.0f per second\n\n",
+			nsamples, secs, (secs > 0) ? nsamples / secs : 0.0);
+		if (nsamples > 0)
+			profile(sym, hist.m_size, hist.m_pc, hist.m_count,
+				nsamples, maxlist, list_pcs);
+
+		delete	m_fpga;
+		exit(EXIT_SUCCESS);
+	}
+
 	FPGAOPEN(m_fpga);
 
 	if (!long_state) {
@@ -121,21 +301,24 @@ int main(int argc, char **argv) {
 		// if (v & 0x0800) printf("CLR-CACHE ");
 		printf("\n");
 	} else {
+		ZIPSTATE	st;
+
 		printf("Reading the long-state ...\n");
+		zipsnap(m_fpga, st);
 		for(int i=0; i<14; i++) {
-			printf("sR%-2d: 0x%08x ", i, cmd_read(m_fpga, i));
+			printf("sR%-2d: 0x%08x ", i, st.m_sR[i]);
 			if ((i&3)==3)
 				printf("\n");
-		} printf("sCC : 0x%08x ", cmd_read(m_fpga, 14));
-		printf("sPC : 0x%08x ", cmd_read(m_fpga, 15));
+		} printf("sCC : 0x%08x ", st.m_sR[14]);
+		printf("sPC : 0x%08x ", st.m_sR[15]);
 		printf("\n\n"); 
 
 		for(int i=0; i<14; i++) {
-			printf("uR%-2d: 0x%08x ", i, cmd_read(m_fpga, i+16));
+			printf("uR%-2d: 0x%08x ", i, st.m_uR[i]);
 			if ((i&3)==3)
 				printf("\n");
-		} printf("uCC : 0x%08x ", cmd_read(m_fpga, 14+16));
-		printf("uPC : 0x%08x ", cmd_read(m_fpga, 15+16));
+		} printf("uCC : 0x%08x ", st.m_uR[14]);
+		printf("uPC : 0x%08x ", st.m_uR[15]);
 		printf("\n\n"); 
 	}
 
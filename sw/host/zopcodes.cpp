@@ -11,6 +11,11 @@
 //	necessary since Zip instruction words may contain two separate
 //	instructions.
 //
+//	Instructions are looked up through tables indexed by their opcode
+//	bits, rather than by searching the opcode lists, and the text is
+//	appended directly into the caller's buffer.  zop_disassemble() will
+//	also take a whole ELF section at once.
+//
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
 //
@@ -47,6 +52,7 @@
 #include <ctype.h>
 
 #include "twoc.h"
+#include "zipelf.h"
 #include "zopcodes.h"
 
 const	char	*zip_regstr[] = {
@@ -524,8 +530,188 @@ zip_getbits(const ZIPI ins, const int which)
 	}
 }
 
+//
+// ZOPLINE
+//
+// An append only line of text, built within the caller's buffer.  Anything
+// beyond the end of the buffer is dropped, and the line is always left
+// terminated.
+//
+class	ZOPLINE {
+	char		*m_buf;
+	unsigned	m_len, m_max;
+public:
+	ZOPLINE(char *buf, unsigned len) : m_buf(buf), m_len(0), m_max(len-1) {
+		m_buf[0] = '\0';
+	}
+
+	void	ch(const char c) {
+		if (m_len < m_max) {
+			m_buf[m_len++] = c;
+			m_buf[m_len] = '\0';
+		}
+	}
+
+	void	str(const char *s) {
+		while((*s)&&(m_len < m_max))
+			m_buf[m_len++] = *s++;
+		m_buf[m_len] = '\0';
+	}
+
+	// Pads the line out to n characters
+	void	pad(unsigned n) {
+		while((m_len < n)&&(m_len < m_max))
+			m_buf[m_len++] = ' ';
+		m_buf[m_len] = '\0';
+	}
+
+	// Eight hex digits, as in %08x
+	void	hex(uint32_t v) {
+		static	const	char	digits[] = "0123456789abcdef";
+		for(int s=28; s>=0; s-=4)
+			ch(digits[(v>>s)&0x0f]);
+	}
+
+	// As in %d
+	void	dec(int v) {
+		char		tmp[12];
+		int		n = 0;
+		uint32_t	u = (v < 0) ? -(uint32_t)v : v;
+
+		if (v < 0)
+			ch('-');
+		do {
+			tmp[n++] = '0' + (u % 10);
+			u /= 10;
+		} while(u);
+		while(n > 0)
+			ch(tmp[--n]);
+	}
+
+	bool	empty(void) const { return m_len == 0; }
+};
+
+//
+// ZOPDECODE
+//
+// Finds the first entry of an opcode list matching a given instruction,
+// without searching the whole list.  The list is split, by the bits of the
+// instruction at [shift+bits-1:shift], into tables of only those entries
+// which might match such an instruction.  Most such tables hold only one or
+// two entries, and (since the order of the list is kept within each) the
+// first of them to match is the one the full list would've found.  Where an
+// entry's mask lies entirely within the key bits, it always matches, so
+// nothing after it needs to be kept.
+//
+// The special treatment each entry will need is worked out here as well, so
+// the opcode names needn't be compared for every instruction.
+//
+#define	ZOP_STORE	1	// SW, SH, SB, etc: register first
+#define	ZOP_LJMP	2	// Long jumps: nothing follows the opcode
+#define	ZOP_BRANCH	4	// Relative branches, shown by their target
+#define	ZOP_MEMOP	8	// LW, LH, LB: offsets shown as addresses
+
+class	ZOPDECODE {
+	const ZOPCODE	*m_list;
+	unsigned	m_shift, m_kmask;
+	unsigned short	*m_first, *m_cand;
+	unsigned char	*m_flags;
+public:
+	ZOPDECODE(const ZOPCODE *list, unsigned shift, unsigned bits)
+			: m_list(list), m_shift(shift), m_kmask((1u<<bits)-1) {
+		unsigned	nlist, ncand = 0;
+		uint32_t	kbits = m_kmask << shift;
+
+		// The list ends with an entry matching anything, which the
+		// search has never matched
+		for(nlist=0; list[nlist].s_mask != 0; nlist++) {
+			if (((~list[nlist].s_mask)&list[nlist].s_val)!=0) {
+				printf("Instruction %d, %s, fails consistency check\n",
+					nlist, list[nlist].s_opstr);
+				printf("%08x & %08x = %08x != %08x\n",
+					list[nlist].s_mask,
+					list[nlist].s_val,
+					(~list[nlist].s_mask)&list[nlist].s_val,
+					0);
+				assert(((~list[nlist].s_mask)&list[nlist].s_val)==0);
+			}
+		}
+
+		m_flags = new unsigned char[nlist+1];
+		for(unsigned i=0; i<nlist; i++) {
+			const char	*op = list[i].s_opstr;
+
+			m_flags[i] = 0;
+			if ((strncasecmp("SW",op, 2)==0)
+					||(strncasecmp("SH",op, 2)==0)
+					||(strncasecmp("SB",op, 2)==0))
+				m_flags[i] = ZOP_STORE;
+			else if (strncasecmp("LJMP",op, 3)==0)
+				m_flags[i] = ZOP_LJMP;
+			else if ((op[0] == 'B')
+					&&(strcasecmp(op,"BUSY")!=0)
+					&&(strcasecmp(op,"BREV")!=0)
+					&&(strcasecmp(op,"BRK")!=0))
+				m_flags[i] = ZOP_BRANCH;
+
+			if (('L'==toupper(op[0]))
+					&&(('W'==toupper(op[1]))
+					 ||('H'==toupper(op[1]))
+					 ||('B'==toupper(op[1])))
+					&&(!op[2]))
+				m_flags[i] |= ZOP_MEMOP;
+		}
+
+		// Two passes: count the candidates for each key, then list them
+		m_first = new unsigned short[m_kmask+2];
+		m_cand = NULL;
+		for(int pass=0; pass<2; pass++) {
+			ncand = 0;
+			for(unsigned k=0; k<=m_kmask; k++) {
+				uint32_t	kv = k << shift;
+
+				m_first[k] = ncand;
+				for(unsigned i=0; i<nlist; i++) {
+					if ((kv ^ list[i].s_val) & list[i].s_mask
+							& kbits)
+						continue;
+					if (m_cand)
+						m_cand[ncand] = i;
+					ncand++;
+					if ((list[i].s_mask & ~kbits)==0)
+						break;
+				}
+			} m_first[m_kmask+1] = ncand;
+
+			if (!m_cand)
+				m_cand = new unsigned short[ncand];
+		}
+		assert(ncand < 0x10000);
+	}
+
+	// Returns the index of the first entry matching ins, or -1 if none do
+	int	find(const ZIPI ins) const {
+		unsigned	k = (ins >> m_shift) & m_kmask;
+
+		for(unsigned j=m_first[k]; j<m_first[k+1]; j++) {
+			const ZOPCODE	&op = m_list[m_cand[j]];
+			if ((ins & op.s_mask) == op.s_val)
+				return m_cand[j];
+		} return -1;
+	}
+
+	const ZOPCODE	&operator[](int i) const { return m_list[i]; }
+	unsigned	flags(int i) const { return m_flags[i]; }
+};
+
+// Keyed by the CIS bit, register, and opcode of full word instructions, and
+// by the register and opcode of the lower half of compressed ones
+static	const	ZOPDECODE	zip_topdecode(zip_oplist_raw, 22, 10),
+				zip_bottomdecode(zip_opbottomlist_raw, 7, 8);
+
 static	void
-zipi_to_halfstring(const uint32_t addr, const ZIPI ins, char *line, const ZOPCODE *listp) {
+zipi_to_halfstring(const uint32_t addr, const ZIPI ins, ZOPLINE &line,
+		const ZOPDECODE &dec) {
 
 	if (OFFSET_PC_MOV(ins)) {
 		int	cv = zip_getbits(ins, ZIP_BITFIELD(3,19));
@@ -535,153 +721,170 @@ zipi_to_halfstring(const uint32_t addr, const ZIPI ins, char *line, const ZOPCOD
 
 		ref = (iv<<2) + addr + 4;
 
-		sprintf(line, "%s%s", "MOV", zip_ccstr[cv]);
-		sprintf(line, "%-11s", line);
-		sprintf(line, "%s0x%08x", line, ref);
-		sprintf(line, "%s,%s", line, zip_regstr[dv]);
+		line.str("MOV");
+		line.str(zip_ccstr[cv]);
+		line.pad(11);
+		line.str("0x");
+		line.hex(ref);
+		line.ch(',');
+		line.str(zip_regstr[dv]);
 
 		return;
 	} else if (TWOWORD_CIS_JSR(ins)) {
-		sprintf(line, "%-11s", "LJSR");
+		line.str("LJSR");
+		line.pad(11);
 		return;
 	} else if (CIS_JSR(ins)) {
 		int ra = zip_getbits(ins, ZIP_REGFIELD(3));
-		sprintf(line, "%-11s%s", "JSR", zip_regstr[ra]);
+		line.str("JSR");
+		line.pad(11);
+		line.str(zip_regstr[ra]);
 		return;
 	}
 
-	int	i;
-	for(i=0; i<nzip_oplist; i++) {
-		if (((~zip_oplist[i].s_mask)&zip_oplist[i].s_val)!=0) {
-			printf("Instruction %d, %s, fails consistency check\n",
-				i, zip_oplist[i].s_opstr);
-			printf("%08x & %08x = %08x != %08x\n",
-				zip_oplist[i].s_mask,
-				zip_oplist[i].s_val,
-				(~zip_oplist[i].s_mask)&zip_oplist[i].s_val,
-				0);
-			assert(((~zip_oplist[i].s_mask)&zip_oplist[i].s_val)==0);
+	int	i = dec.find(ins);
+	if (i < 0) {
+		line.str("ILL ");
+		line.hex(ins);
+		return;
+	}
+
+	const ZOPCODE	&op = dec[i];
+	unsigned	flags = dec.flags(i);
+
+	// Write the opcode onto our line
+	line.str(op.s_opstr);
+	if (op.s_cf != ZIP_OPUNUSED) {
+		int bv = zip_getbits(ins, op.s_cf);
+		line.str(zip_ccstr[bv]);
+	} line.pad(11); // Pad it to 11 chars
+
+	int	ra = -1, rb = -1, rr = -1, imv = 0;
+
+	if (op.s_result != ZIP_OPUNUSED)
+		rr = zip_getbits(ins, op.s_result);
+	if (op.s_ra != ZIP_OPUNUSED)
+		ra = zip_getbits(ins, op.s_ra);
+	if (op.s_rb != ZIP_OPUNUSED)
+		rb = zip_getbits(ins, op.s_rb);
+	if (op.s_i != ZIP_OPUNUSED)
+		imv = zip_getbits(ins, op.s_i);
+
+	if ((op.s_rb != ZIP_OPUNUSED)&&(rb == 15))
+		imv <<= 2;
+
+	// Treat stores special
+	if (flags & ZOP_STORE) {
+		line.str(zip_regstr[ra]);
+		line.ch(',');
+
+		if (op.s_i != ZIP_OPUNUSED) {
+			if (op.s_rb == ZIP_OPUNUSED) {
+				line.str("($");
+				line.dec(imv);
+				line.ch(')');
+			} else if (imv != 0) {
+				line.ch('$');
+				line.dec(imv);
+			}
+		} if (op.s_rb != ZIP_OPUNUSED) {
+			line.ch('(');
+			line.str(zip_regstr[rb]);
+			line.ch(')');
 		}
-	} line[0] = '\0';
-	for(i=0; (listp[i].s_mask != 0); i++) {
-		// printf("%2d: %6s %08x & %08x == %08x\n",
-			// i, zip_oplist[i].s_opstr, ins,
-			// zip_oplist[i].s_mask, zip_oplist[i].s_val);
-		if ((ins & listp[i].s_mask) == listp[i].s_val) {
-			// Write the opcode onto our line
-			sprintf(line, "%s", listp[i].s_opstr);
-			if (listp[i].s_cf != ZIP_OPUNUSED) {
-				int bv = zip_getbits(ins, listp[i].s_cf);
-				strcat(line, zip_ccstr[bv]);
-			} sprintf(line, "%-11s", line); // Pad it to 11 chars
-
-			int	ra = -1, rb = -1, rr = -1, imv = 0;
-
-			if (listp[i].s_result != ZIP_OPUNUSED)
-				rr = zip_getbits(ins, listp[i].s_result);
-			if (listp[i].s_ra != ZIP_OPUNUSED)
-				ra = zip_getbits(ins, listp[i].s_ra);
-			if (listp[i].s_rb != ZIP_OPUNUSED)
-				rb = zip_getbits(ins, listp[i].s_rb);
-			if (listp[i].s_i != ZIP_OPUNUSED)
-				imv = zip_getbits(ins, listp[i].s_i);
-
-			if ((listp[i].s_rb != ZIP_OPUNUSED)&&(rb == 15))
-				imv <<= 2;
-
-			// Treat stores special
-			if ((strncasecmp("SW",listp[i].s_opstr, 2)==0)
-				||(strncasecmp("SH",listp[i].s_opstr, 2)==0)
-				||(strncasecmp("SB",listp[i].s_opstr, 2)==0)) {
-				strcat(line, zip_regstr[ra]);
-				strcat(line, ",");
-
-				if (listp[i].s_i != ZIP_OPUNUSED) {
-					if (listp[i].s_rb == ZIP_OPUNUSED)
-						sprintf(&line[strlen(line)],
-							"($%d)", imv);
-					else if (imv != 0)
-						sprintf(&line[strlen(line)],
-							"$%d", imv);
-				} if (listp[i].s_rb != ZIP_OPUNUSED) {
-					sprintf(&line[strlen(line)],
-						"(%s)", zip_regstr[rb]);
-				}
-			// Treat long jumps special
-			} else if (strncasecmp("LJMP",listp[i].s_opstr, 3)==0) {
-			// Treat relative jumps (branches) specially as well
-			} else if ((toupper(listp[i].s_opstr[0]=='B'))
-				&&(strcasecmp(listp[i].s_opstr,"BUSY")!=0)
-				&&(strcasecmp(listp[i].s_opstr,"BREV")!=0)
-				&&(strcasecmp(listp[i].s_opstr,"BRK")!=0)
-				&&(addr != 0)) {
-				// Branch instruction: starts with B and isn't
-				// BREV (bit reverse), BRK (break), or
-				// BUSY
-				uint32_t target = addr;
-
-				target += zip_getbits(ins, listp[i].s_i)+4;
-				sprintf(&line[strlen(line)], "@0x%08x", target);
-			} else {
-				int memop = 0;
-				if (('L'==toupper(listp[i].s_opstr[0]))
-					&&(('W'==toupper(listp[i].s_opstr[1]))
-					 ||('H'==toupper(listp[i].s_opstr[1]))
-					 ||('B'==toupper(listp[i].s_opstr[1])))
-					&&(!listp[i].s_opstr[2]))
-					memop = 1;
-
-				if (listp[i].s_i != ZIP_OPUNUSED) {
-					if((memop)&&(listp[i].s_rb == ZIP_OPUNUSED))
-						sprintf(&line[strlen(line)],
-							"($%d)", imv);
-					else if((memop)&&(imv != 0))
-						sprintf(&line[strlen(line)],
-							"%d", imv);
-					else if((!memop)&&((imv != 0)||(listp[i].s_rb == ZIP_OPUNUSED)))
-						sprintf(&line[strlen(line)],
-							"$%d%s", imv,
-							(listp[i].s_rb!=ZIP_OPUNUSED)?"+":"");
-				} if (listp[i].s_rb != ZIP_OPUNUSED) {
-					if (memop)
-						sprintf(&line[strlen(line)],
-							"(%s)", zip_regstr[rb]);
-					else
-						strcat(line, zip_regstr[rb]);
-				} if(((listp[i].s_i != ZIP_OPUNUSED)||(listp[i].s_rb != ZIP_OPUNUSED))
-					&&((listp[i].s_ra != ZIP_OPUNUSED)||(listp[i].s_result != ZIP_OPUNUSED)))
-					strcat(line, ",");
-
-				if (listp[i].s_ra != ZIP_OPUNUSED) {
-					strcat(line, zip_regstr[ra]);
-				} else if (listp[i].s_result != ZIP_OPUNUSED) {
-					strcat(line, zip_regstr[rr]);
-				}
+	// Treat long jumps special
+	} else if (flags & ZOP_LJMP) {
+	// Treat relative jumps (branches) specially as well
+	} else if ((flags & ZOP_BRANCH)&&(addr != 0)) {
+		// Branch instruction: starts with B and isn't
+		// BREV (bit reverse), BRK (break), or
+		// BUSY
+		uint32_t target = addr;
+
+		target += zip_getbits(ins, op.s_i)+4;
+		line.str("@0x");
+		line.hex(target);
+	} else {
+		bool	memop = (flags & ZOP_MEMOP);
+
+		if (op.s_i != ZIP_OPUNUSED) {
+			if((memop)&&(op.s_rb == ZIP_OPUNUSED)) {
+				line.str("($");
+				line.dec(imv);
+				line.ch(')');
+			} else if((memop)&&(imv != 0))
+				line.dec(imv);
+			else if((!memop)&&((imv != 0)||(op.s_rb == ZIP_OPUNUSED))) {
+				line.ch('$');
+				line.dec(imv);
+				if (op.s_rb != ZIP_OPUNUSED)
+					line.ch('+');
 			}
-			break;
+		} if (op.s_rb != ZIP_OPUNUSED) {
+			if (memop) {
+				line.ch('(');
+				line.str(zip_regstr[rb]);
+				line.ch(')');
+			} else
+				line.str(zip_regstr[rb]);
+		} if(((op.s_i != ZIP_OPUNUSED)||(op.s_rb != ZIP_OPUNUSED))
+			&&((op.s_ra != ZIP_OPUNUSED)||(op.s_result != ZIP_OPUNUSED)))
+			line.ch(',');
+
+		if (op.s_ra != ZIP_OPUNUSED) {
+			line.str(zip_regstr[ra]);
+		} else if (op.s_result != ZIP_OPUNUSED) {
+			line.str(zip_regstr[rr]);
 		}
-	} if (line[0] == '\0') {
-		sprintf(line, "ILL %08x", ins);
 	}
 }
 
 void
 zipi_to_double_string(const uint32_t addr, const ZIPI ins, char *la, char *lb) {
-	zipi_to_halfstring(addr, ins, la, zip_oplist);
+	zop_disassemble(addr, ins, la, lb, ZOP_LINELEN);
+}
+
+void
+zop_disassemble(const uint32_t addr, const ZIPI ins, char *la, char *lb,
+		const unsigned len) {
+	ZOPLINE	a(la, len);
+
+	zipi_to_halfstring(addr, ins, a, zip_topdecode);
 	if (lb) {
 		if ((ins & 0x80000000)&&(!CIS_JSR(ins))) {
-			zipi_to_halfstring(addr, ins, lb, zip_opbottomlist);
+			ZOPLINE	b(lb, len);
+			zipi_to_halfstring(addr, ins, b, zip_bottomdecode);
 		} else lb[0] = '\0';
 	}
 }
 
+void
+zop_disassemble(const uint32_t addr, const char *data, const unsigned nwords,
+		ZOPDIS *out) {
+	const unsigned char	*d = (const unsigned char *)data;
+
+	for(unsigned k=0; k<nwords; k++, d+=4) {
+		ZIPI	ins = (d[0]<<24)|(d[1]<<16)|(d[2]<<8)|d[3];
+
+		out[k].z_addr = addr + 4*k;
+		out[k].z_ins  = ins;
+		zop_disassemble(out[k].z_addr, ins, out[k].z_a, out[k].z_b,
+			ZOP_LINELEN);
+	}
+}
+
+unsigned
+zop_disassemble(const ELFSECTION *sec, ZOPDIS *out) {
+	zop_disassemble(sec->m_start, sec->m_data, sec->m_len/4, out);
+	return sec->m_len/4;
+}
+
 unsigned int	zop_early_branch(const unsigned int pc, const ZIPI insn) {
 	if ((insn & 0xf8000000) != 0x78000000)
 		return pc+4;
-	if ((insn & 0xffc60000) == 0x78800000)	// BRA high bit clear
-		return (pc + 4 + ((insn & 0x3ffff)<<2));
-	if ((insn & 0xffc60000) == 0x78820000)	// BRA high bit set (negative)
-		return (pc + 4 + ((0x40000 - (insn & 0x3ffff))<<2));
+	// BRA: an eighteen bit signed byte offset, from the next instruction
+	if ((insn & 0xffc40000) == 0x78800000)
+		return (pc + 4 + zip_sbits(insn, 18));
 	return pc+4;
 }
 
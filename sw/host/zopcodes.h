@@ -80,8 +80,32 @@ extern	const	char	*zip_regstr[49], *zip_ccstr[8];
 extern	const ZOPCODE	*zip_oplist, *zip_opbottomlist;
 extern	const int	nzip_oplist, nzip_opbottom;
 
-// Disassemble an opcode
+// The most characters (with the terminating NUL) a disassembled half of an
+// instruction word will take
+#define	ZOP_LINELEN	48
+
+// One disassembled instruction word
+typedef	struct	{
+	uint32_t	z_addr;
+	ZIPI		z_ins;
+	char		z_a[ZOP_LINELEN], z_b[ZOP_LINELEN];
+} ZOPDIS;
+
+class	ELFSECTION;
+
+// Disassemble an opcode.  The second half of a compressed instruction word
+// goes into lb, which is otherwise left empty.  Both are ZOP_LINELEN long.
 extern	void zipi_to_double_string(const uint32_t, const ZIPI, char *, char *);
+// The same, into buffers of len characters each
+extern	void zop_disassemble(const uint32_t addr, const ZIPI ins,
+			char *la, char *lb, const unsigned len);
+// Disassembles the nwords big endian instruction words found at data, taken
+// to start at address addr, into out[0] through out[nwords-1]
+extern	void zop_disassemble(const uint32_t addr, const char *data,
+			const unsigned nwords, ZOPDIS *out);
+// The same, for a whole (text) section of an ELF file.  out[] needs room for
+// one entry per word of the section.  Returns the number of words.
+extern	unsigned zop_disassemble(const ELFSECTION *sec, ZOPDIS *out);
 extern	const	char	*zop_regstr[];
 extern	const	char	*zop_ccstr[];
 extern	unsigned int	zop_early_branch(const unsigned int pc, const ZIPI ins);
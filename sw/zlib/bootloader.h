@@ -49,4 +49,7 @@ extern	int	_boot_address[1],
 		_ram_image_start[1], _ram_image_end[1],
 		_bss_image_end[1];
 
+// The compressed image, when built for the _ZIP_LZBOOT bootloader
+extern	int	_lzimage[1];
+
 #endif
@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	console.h
+//
+// Project:	Zip CPU -- a small, lightweight, RISC CPU soft core
+//
+// Purpose:	The console driver within syscalls.c keeps transmit and
+//		receive ring buffers in RAM, so that _write_r() can return
+//	as soon as its data has been queued rather than once it has been sent.
+//
+//	The rings are emptied into (and filled from) the console's hardware
+//	FIFOs in one of two ways:
+//
+//	1. By interrupt.  Since the ZipCPU only takes interrupts while in user
+//	mode, this requires a supervisor that runs the application as a user
+//	task.  Such a supervisor calls _console_enable_ints() once, and then
+//	_console_isr() any time the CPU returns to it with SYSPIC_UARTTXF
+//	or SYSPIC_ALT (ALTPIC_UARTRX) pending.  Anything the supervisor
+//	itself writes is sent directly, as far as the hardware FIFO allows,
+//	and the rest by interrupt once the CPU is back in user mode.
+//	sw/board/zbench is such a supervisor.
+//
+//	2. Otherwise, opportunistically, by the console calls themselves, and
+//	by _console_drain().  Anything that doesn't fit in the hardware FIFO
+//	stays in the ring until the next console call, a _console_drain(),
+//	_console_flush(), or _exit().  Programs that print and then spin
+//	without printing anything more should call one of these from their
+//	idle loop.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	CONSOLE_H
+#define	CONSOLE_H
+
+// Ring buffer sizes, in bytes.  Both must be powers of two.
+#ifndef	CONSOLE_TXRING
+#define	CONSOLE_TXRING	1024
+#endif
+#ifndef	CONSOLE_RXRING
+#define	CONSOLE_RXRING	256
+#endif
+
+// Switch to interrupt driven operation (see above)
+extern	void	_console_enable_ints(void);
+// Service the console interrupts.  Call from supervisor mode only.
+extern	void	_console_isr(void);
+// Move whatever can be moved between the rings and the hardware, without
+// waiting
+extern	void	_console_drain(void);
+// Wait until everything queued for transmit has been handed to the hardware
+extern	void	_console_flush(void);
+// Queue n bytes for transmit, as _write_r() does for stdout, turning each
+// newline into a carriage return, newline pair.  The hardware FIFO is only
+// checked once the whole buffer is queued, or whenever the ring fills.
+extern	void	_console_write(const char *buf, unsigned n);
+
+#endif
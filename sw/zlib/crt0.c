@@ -208,6 +208,65 @@ extern	void	_bootloader(void) __attribute__ ((section (".boot")));
 //
 #ifndef	SKIP_BOOTLOADER
 #define	NOTNULL(A)	(4 != (unsigned)&A[1])
+
+#ifdef	_ZIP_LZBOOT
+//
+// _lzunpack()
+//
+// When built with -D_ZIP_LZBOOT, the image in flash is compressed, rather than
+// a straight copy of RAM.  It's unpacked here, with the CPU reading it from
+// flash through the data cache, and writing straight into RAM.  Fewer bytes
+// are then read from the flash, at the cost of a few instructions per byte
+// written.  The format, an LZ4 block preceded by its unpacked length, is
+// described in sw/host/zippack.cpp, which creates it.
+//
+// Like the bootloader itself, this needs to live in flash.  It must also not
+// call anything that doesn't--memcpy() included.
+//
+static	char	*_lzunpack(char *dst, const unsigned char *src)
+		__attribute__ ((section (".boot")));
+
+static	char	*_lzunpack(char *dst, const unsigned char *src) {
+	char		*end;
+	const char	*mp;
+	unsigned	token, n, b;
+
+	n = (src[0]<<24)|(src[1]<<16)|(src[2]<<8)|src[3];
+	src += 4;
+	end = dst + n;
+
+	while(dst < end) {
+		token = *src++;
+
+		// First the literals, copied from flash
+		n = token >> 4;
+		if (n == 15) do {
+			b = *src++;
+			n += b;
+		} while(b == 255);
+		while(n-- > 0)
+			*dst++ = *src++;
+
+		// The last sequence has no match
+		if (dst >= end)
+			break;
+
+		// Then the match, copied from what we've already unpacked
+		mp = dst - (src[0] | (src[1]<<8));
+		src += 2;
+		n = token & 15;
+		if (n == 15) do {
+			b = *src++;
+			n += b;
+		} while(b == 255);
+		n += 4;
+		while(n-- > 0)
+			*dst++ = *mp++;
+	}
+
+	return dst;
+}
+#endif
 void	_bootloader(void) {
 	// NSTR("BOOTLOADER");
 	int *ramend = _ram_image_end, *bsend = _bss_image_end;
@@ -245,7 +304,42 @@ void	_bootloader(void) {
 
 	int *kramdev = (_kram) ? _kram : _ram;
 
+#ifdef	_ZIP_LZBOOT
+	// Disable and clear all interrupts
+	_zip->z_pic = CLEARPIC;
+
+	//
+	// Our linker script, boardlz.ld, places the whole image in _ram, so
+	// there's only the one area to unpack.
+	//
+	// NSTR("LZ");
+	_lzunpack((char *)_ram, (const unsigned char *)_lzimage);
+
+	if (bsend != ramend) {
 #ifdef	USE_DMA
+		volatile int	zero = 0;
+
+		// NSTR("BSS");
+		_zip->z_dma.d_ctrl= DMACLEAR;
+		_zip->z_pic = SYSINT_DMAC;
+		_zip->z_dma.d_len = bsend - ramend;
+		_zip->z_dma.d_rd  = (unsigned *)&zero;
+		_zip->z_dma.d_wr  = ramend;
+		_zip->z_dma.d_ctrl = DMACCOPY|DMA_CONSTSRC;
+
+		while((_zip->z_pic & SYSINT_DMAC)==0)
+			;
+		_zip->z_pic = CLEARPIC;
+#else
+		int	*wrp = ramend;
+
+		while(wrp < bsend)
+			*wrp++ = 0;
+#endif
+	}
+
+	CLEAR_CACHE;
+#elif	defined(USE_DMA)
 	// Disable and clear all interrupts
 	_zip->z_pic = CLEARPIC;
 	// NSTR("DMA");
@@ -0,0 +1,402 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	sdcard.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	An SD card block driver.  See sdcard.h for a description.
+//
+//	A note on the SDSPI FIFOs: both share a single bus side address
+//	pointer.  Any write to the command register resets it to zero.  Each
+//	FIFO read or write then advances it.  The next command must therefore
+//	be issued before the other FIFO is emptied or filled, never after.
+//	Since the FIFOs are 128 words long, the pointer wraps back to zero
+//	once a full block has been moved.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdint.h>
+#include "board.h"
+#include "zipcpu.h"
+#include "zipsys.h"
+#include "sdcard.h"
+
+#ifdef	_BOARD_HAS_SDSPI
+
+#define	SDSPI_READREG	0x0200
+#define	SDCARD_WORDS	(SDCARD_BLKSZ/4)
+
+// Any of these bits in the control register, following a command, indicate
+// that it failed.  The bottom eight are the card's R1 response.
+#define	SDCARD_ERRMASK	(SDSPI_ERROR|SDSPI_REMOVED|SDSPI_WATCHDOG|0x0ff)
+
+// How many times to issue ACMD41 before giving up on the card
+#define	SDCARD_TRIES	1000
+
+#ifdef	_HAVE_ZIPSYS_DMA
+#define	SDCARD_INTS	(SYSPIC_SDCARD|SYSPIC_DMAC)
+#else
+#define	SDCARD_INTS	SYSPIC_SDCARD
+#endif
+
+SDCARDINFO	sdcard_info;
+static	int		sdcard_ready;
+static	unsigned	sdcard_aux = SDCARD_AUX_SLOW;
+
+//
+// sdcard_sleep
+//
+// Wait for an interrupt.  In supervisor mode, zip_idle() sleeps until one
+// of the enabled interrupts arrives.  In user mode interrupts belong to the
+// supervisor, so we can only poll.
+//
+static void
+sdcard_sleep(void) {
+	unsigned	cc;
+
+	asm volatile("MOV CC,%0" : "=r"(cc));
+	if ((cc & CC_GIE) == 0)
+		zip_idle();
+}
+
+// Enable our interrupts, returning which of them were already enabled
+static unsigned
+sdcard_ints_on(void) {
+	unsigned	was = (_zip->z_pic >> 16) & SDCARD_INTS;
+
+	_zip->z_pic = EINT(SDCARD_INTS);
+	return was;
+}
+
+// Disable any of our interrupts that weren't enabled before
+static void
+sdcard_ints_off(unsigned was) {
+	if (SDCARD_INTS & ~was)
+		_zip->z_pic = DINT(SDCARD_INTS & ~was);
+}
+
+static void
+sdcard_setaux(unsigned aux) {
+	sdcard_aux = aux;
+	_sdcard->sd_data = aux;
+	_sdcard->sd_ctrl = SDSPI_SETAUX;
+}
+
+static void
+sdcard_issue(unsigned cmd, unsigned arg) {
+	_zip->z_pic = SYSPIC_SDCARD;	// Acknowledge the last command
+	_sdcard->sd_data = arg;
+	_sdcard->sd_ctrl = cmd | SDSPI_CLEARERR;
+	sdcard_info.s_cmds++;
+}
+
+// Wait for the current command to complete, returning the control register
+static unsigned
+sdcard_wait(void) {
+	unsigned	v;
+
+	while((v = _sdcard->sd_ctrl) & SDSPI_BUSY)
+		sdcard_sleep();
+	return v;
+}
+
+// Returns non-zero, and keeps count, if v indicates an error
+static int
+sdcard_failed(unsigned v) {
+	if ((v & SDCARD_ERRMASK) == 0)
+		return 0;
+	sdcard_info.s_errs++;
+	sdcard_info.s_lastrsp = v;
+	return 1;
+}
+
+static unsigned
+sdcard_cmd(unsigned cmd, unsigned arg) {
+	sdcard_issue(cmd, arg);
+	return sdcard_wait();
+}
+
+// Block address to command argument.  Standard capacity cards are addressed
+// by the byte.
+static unsigned
+sdcard_addr(unsigned blk) {
+	return (sdcard_info.s_hc) ? blk : blk * SDCARD_BLKSZ;
+}
+
+#ifdef	_HAVE_ZIPSYS_DMA
+// Start the DMA, returning zero if it's already in use
+static int
+sdcard_dma(volatile unsigned *rd, volatile unsigned *wr, int ctrl) {
+	if (_zip->z_dma.d_ctrl & DMA_BUSY)
+		return 0;
+
+	_zip->z_pic = SYSPIC_DMAC;
+	_zip->z_dma.d_len = SDCARD_WORDS;
+	_zip->z_dma.d_rd  = (int *)rd;
+	_zip->z_dma.d_wr  = (int *)wr;
+	_zip->z_dma.d_ctrl= ctrl;
+	return 1;
+}
+
+static void
+sdcard_dmawait(void) {
+	while(_zip->z_dma.d_ctrl & DMA_BUSY)
+		sdcard_sleep();
+}
+#else
+static void
+sdcard_dmawait(void) {
+}
+#endif
+
+//
+// Move one block out of a FIFO.  Returns non-zero if this has been left to
+// the DMA, in which case sdcard_dmawait() must be called before the data
+// is used.
+//
+static int
+sdcard_fromfifo(int fifo, uint8_t *buf) {
+	volatile unsigned	*fp = &_sdcard->sd_fifo[fifo];
+
+	if (((unsigned)buf & 3) == 0) {
+		uint32_t	*wp = (uint32_t *)buf;
+
+#ifdef	_HAVE_ZIPSYS_DMA
+		if (sdcard_dma(fp, wp, DMACCOPY|DMA_CONSTSRC))
+			return 1;
+#endif
+		for(int k=0; k<SDCARD_WORDS; k++)
+			wp[k] = *fp;
+	} else for(int k=0; k<SDCARD_WORDS; k++) {
+		uint32_t	v = *fp;
+
+		// The card's byte order is the ZipCPU's: big endian
+		*buf++ = v >> 24;
+		*buf++ = v >> 16;
+		*buf++ = v >>  8;
+		*buf++ = v;
+	}
+
+	return 0;
+}
+
+static int
+sdcard_tofifo(int fifo, const uint8_t *buf) {
+	volatile unsigned	*fp = &_sdcard->sd_fifo[fifo];
+
+	if (((unsigned)buf & 3) == 0) {
+		const uint32_t	*wp = (const uint32_t *)buf;
+
+#ifdef	_HAVE_ZIPSYS_DMA
+		if (sdcard_dma((volatile unsigned *)wp, fp,
+				DMACCOPY|DMA_CONSTDST))
+			return 1;
+#endif
+		for(int k=0; k<SDCARD_WORDS; k++)
+			*fp = wp[k];
+	} else for(int k=0; k<SDCARD_WORDS; k++) {
+		*fp = (buf[0]<<24)|(buf[1]<<16)|(buf[2]<<8)|buf[3];
+		buf += 4;
+	}
+
+	return 0;
+}
+
+int
+sdcard_init(void) {
+	unsigned	v, arg41, was, tries;
+	int		result = 0;
+
+	sdcard_ready = 0;
+	sdcard_info.s_ocr = 0;
+	sdcard_info.s_hc  = 0;
+
+	// Clear any prior pending errors
+	_sdcard->sd_data = 0;
+	_sdcard->sd_ctrl = SDSPI_CLEARERR|SDSPI_READAUX;
+	if (_sdcard->sd_ctrl & SDSPI_PRESENTN)
+		return -SDCARD_ENOCARD;
+
+	was = sdcard_ints_on();
+	sdcard_setaux(SDCARD_AUX_SLOW);
+
+	// CMD0, GO_IDLE_STATE.  The card should now be idle (R1 = 1)
+	v = sdcard_cmd(SDSPI_GO_IDLE, 0);
+	if ((v & SDCARD_ERRMASK) != 1) {
+		sdcard_failed(v);
+		result = -SDCARD_ENOCARD;
+		goto done;
+	}
+
+	// CMD8, SEND_IF_COND: 2.7-3.6V, with a check pattern of 0xa5.  Only
+	// version 2 cards recognize it, and only they may be high capacity.
+	v = sdcard_cmd((SDSPI_CMD|SDSPI_READREG)+8, 0x01a5);
+	if (((v & SDCARD_ERRMASK) == 1)&&((_sdcard->sd_data & 0x0fff)==0x01a5))
+		arg41 = 0x40000000;	// HCS, we support high capacity
+	else
+		arg41 = 0;
+
+	// ACMD41, SD_SEND_OP_COND, until the card leaves the idle state
+	for(tries = 0; ; tries++) {
+		if (tries >= SDCARD_TRIES) {
+			result = -SDCARD_EINIT;
+			goto done;
+		}
+
+		v = sdcard_cmd(SDSPI_ACMD, 0);
+		if (sdcard_failed(v & ~1)) {
+			result = -SDCARD_ECMD;
+			goto done;
+		}
+
+		v = sdcard_cmd(SDSPI_CMD+41, arg41);
+		if (sdcard_failed(v & ~1)) {
+			result = -SDCARD_ECMD;
+			goto done;
+		} if ((v & 1) == 0)
+			break;
+	}
+
+	// CMD58, READ_OCR, to find out if this is a high capacity card
+	v = sdcard_cmd((SDSPI_CMD|SDSPI_READREG)+58, 0);
+	if (sdcard_failed(v)) {
+		result = -SDCARD_ECMD;
+		goto done;
+	}
+	sdcard_info.s_ocr = _sdcard->sd_data;
+	sdcard_info.s_hc  = (arg41)&&(sdcard_info.s_ocr & 0x40000000);
+
+	// CMD16, SET_BLOCKLEN.  High capacity cards are fixed at 512 bytes.
+	if (!sdcard_info.s_hc) {
+		v = sdcard_cmd(SDSPI_CMD+16, SDCARD_BLKSZ);
+		if (sdcard_failed(v)) {
+			result = -SDCARD_ECMD;
+			goto done;
+		}
+	}
+
+	sdcard_setaux(SDCARD_AUX_FAST);
+	sdcard_ready = 1;
+done:
+	sdcard_ints_off(was);
+	return result;
+}
+
+int
+sdcard_read(unsigned blk, unsigned n, void *vbuf) {
+	uint8_t		*buf = (uint8_t *)vbuf;
+	unsigned	v, was;
+	int		result = 0;
+
+	if (!sdcard_ready)
+		return -SDCARD_ENOINIT;
+	if (n == 0)
+		return 0;
+
+	was = sdcard_ints_on();
+
+	// Block k is read into FIFO k&1
+	sdcard_issue(SDSPI_READ_SECTOR, sdcard_addr(blk));
+	for(unsigned k=0; k<n; k++, buf += SDCARD_BLKSZ) {
+		int	fifo = k&1, dma;
+
+		v = sdcard_wait();
+		if (sdcard_failed(v)) {
+			result = -SDCARD_ECMD;
+			break;
+		}
+
+		// Start reading the next block into the other FIFO, while we
+		// empty this one
+		if (k+1 < n)
+			sdcard_issue(SDSPI_READ_SECTOR
+					| ((fifo) ? 0 : SDSPI_ALTFIFO),
+				sdcard_addr(blk+k+1));
+
+		dma = sdcard_fromfifo(fifo, buf);
+		if (dma)
+			sdcard_dmawait();
+	}
+
+#ifdef	_HAVE_ZIPSYS_DMA
+	// The data cache knows nothing of what the DMA has written
+	CLEAR_DCACHE;
+#endif
+	sdcard_ints_off(was);
+	return result;
+}
+
+int
+sdcard_write(unsigned blk, unsigned n, const void *vbuf) {
+	const uint8_t	*buf = (const uint8_t *)vbuf;
+	unsigned	v, was;
+	int		result = 0, dma;
+
+	if (!sdcard_ready)
+		return -SDCARD_ENOINIT;
+	if (n == 0)
+		return 0;
+
+	was = sdcard_ints_on();
+
+	// Load the first block into FIFO zero.  Rewriting the AUX register
+	// resets the FIFO pointer.
+	sdcard_setaux(sdcard_aux);
+	dma = sdcard_tofifo(0, buf);
+	if (dma)
+		sdcard_dmawait();
+
+	// Block k is written from FIFO k&1
+	for(unsigned k=0; k<n; k++, buf += SDCARD_BLKSZ) {
+		int	fifo = k&1;
+
+		sdcard_issue(SDSPI_WRITE_SECTOR | ((fifo) ? SDSPI_ALTFIFO : 0),
+			sdcard_addr(blk+k));
+
+		// Fill the other FIFO while this one is written
+		if (k+1 < n) {
+			dma = sdcard_tofifo(fifo^1, buf + SDCARD_BLKSZ);
+			if (dma)
+				sdcard_dmawait();
+		}
+
+		v = sdcard_wait();
+		if (sdcard_failed(v)) {
+			result = -SDCARD_ECMD;
+			break;
+		}
+	}
+
+	sdcard_ints_off(was);
+	return result;
+}
+
+#endif	// _BOARD_HAS_SDSPI
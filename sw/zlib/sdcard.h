@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	sdcard.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	A block device driver for the SD card, via the SDSPI
+//		controller.  Blocks are always 512 bytes.
+//
+//	Multi-block transfers are pipelined across the controller's two FIFOs.
+//	While the card reads block k+1 into one FIFO, the DMA empties block k
+//	from the other.  Writes work the same way in reverse.  The CPU waits
+//	for each command and each DMA transfer in zip_idle(), and is woken by
+//	the SDCARD and DMAC interrupts, rather than spinning on the busy bits.
+//
+//	The SDSPI controller transfers one block per command.  Multi-block
+//	transfers are therefore a sequence of CMD17 or CMD24 commands, rather
+//	than CMD18 or CMD25.  The FIFO pipelining hides much of the cost.
+//
+//	None of these routines are reentrant.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	SDCARD_H
+#define	SDCARD_H
+
+#define	SDCARD_BLKSZ	512
+
+// AUX register settings: log2 of the block length in words, in bits 11:8,
+// then the SPI clock divider.  Cards must be initialized at 400kHz or less.
+#define	SDCARD_AUX_SLOW	0x0763
+#define	SDCARD_AUX_FAST	0x0701
+
+// Error codes, returned negated
+#define	SDCARD_ENOCARD	1	// No card, or the card has been removed
+#define	SDCARD_EINIT	2	// The card didn't complete its initialization
+#define	SDCARD_ECMD	3	// A command failed, or returned an error
+#define	SDCARD_ENOINIT	4	// sdcard_init() hasn't (successfully) been run
+
+typedef	struct	{
+	unsigned	s_ocr;		// Operating conditions register
+	unsigned	s_hc;		// Non-zero if block (not byte) addressed
+	unsigned	s_cmds;		// Commands issued
+	unsigned	s_errs;		// Commands that failed
+	unsigned	s_lastrsp;	// Control register following the last error
+} SDCARDINFO;
+
+extern	SDCARDINFO	sdcard_info;
+
+// Reset and initialize the card.  Returns zero on success.
+extern	int	sdcard_init(void);
+
+// Read or write n blocks, starting at block blk.  buf should be word
+// aligned if the DMA is to be used.  Returns zero on success, or a negative
+// error code.
+extern	int	sdcard_read(unsigned blk, unsigned n, void *buf);
+extern	int	sdcard_write(unsigned blk, unsigned n, const void *buf);
+
+#endif
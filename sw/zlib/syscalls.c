@@ -42,6 +42,9 @@
 #include "board.h"
 #include "bootloader.h"
 #include "zipcpu.h"
+#include "zipsys.h"
+#include "console.h"
+#include "zipfat.h"
 
 #ifdef	_BOARD_HAS_BUSCONSOLE
 #define	_ZIP_HAS_WBUART
@@ -51,21 +54,146 @@
 #define	UARTTX	_uart->u_tx
 #endif
 
-void
-_outbyte(char v) {
 #ifdef	_ZIP_HAS_WBUART
-	if (v == '\n') {
-		// Depend upon the WBUART, not the PIC
-		while((_uart->u_fifo & 0x010000)==0)
-			;
-		UARTTX = (unsigned)'\r';
+//
+// The console ring buffers
+//
+// The transmit ring is filled by _write_r() (via _outbyte) and emptied by
+// _console_txdrain(), the receive ring is filled by _console_rxdrain() and
+// emptied by _inbyte().  Each index is only ever written by one side.  When
+// interrupts are in use the drain functions are only called from the
+// supervisor, which can't itself be interrupted, so no locking is needed.
+//
+static	char	_txring[CONSOLE_TXRING], _rxring[CONSOLE_RXRING];
+static	volatile unsigned	_txhead, _txtail, _rxhead, _rxtail;
+static	int	_console_irq = 0;
+
+// The FIFO status register holds the transmit status in its upper half and
+// the receive status in its lower half.  Bits [11:2] of each give the
+// number of empty slots (transmit) or available characters (receive).
+#define	UART_TXSPACE(F)	(((F) >> 18) & 0x03ff)
+#define	UART_RXAVAIL(F)	(((F) >>  2) & 0x03ff)
+
+static void
+_console_txdrain(void) {
+	unsigned	space = UART_TXSPACE(_uart->u_fifo), tail = _txtail;
+
+	while((space > 0)&&(tail != _txhead)) {
+		UARTTX = (unsigned)(uint8_t)_txring[tail];
+		tail = (tail + 1) & (CONSOLE_TXRING-1);
+		space--;
+	} _txtail = tail;
+}
+
+static void
+_console_rxdrain(void) {
+	unsigned	avail = UART_RXAVAIL(_uart->u_fifo), head = _rxhead;
+
+	while((avail > 0)&&(((head+1)&(CONSOLE_RXRING-1)) != _rxtail)) {
+		int	rv = UARTRX;
+		if (rv & 0x0100)
+			break;
+		_rxring[head] = (char)rv;
+		head = (head + 1) & (CONSOLE_RXRING-1);
+		avail--;
+	} _rxhead = head;
+}
+
+//
+// Returns true if we need to move characters ourselves, rather than leaving
+// that to the interrupt handler.  That's always the case in supervisor mode,
+// since the supervisor can never be interrupted.
+//
+static int
+_console_direct(void) {
+	unsigned	cc;
+
+	if (!_console_irq)
+		return 1;
+	asm volatile("MOV CC,%0" : "=r"(cc));
+	return (cc & CC_GIE) == 0;
+}
+
+void
+_console_enable_ints(void) {
+	_console_irq = 1;
+	_zip->z_apic = EINT(ALTPIC_UARTRX);
+	_zip->z_pic  = EINT(SYSPIC_ALT);
+	// The transmit interrupt is enabled whenever there's something to
+	// send
+	if (_txhead != _txtail)
+		_zip->z_pic = EINT(SYSPIC_UARTTXF);
+}
+
+void
+_console_isr(void) {
+	_console_rxdrain();
+	_console_txdrain();
+
+	// Both sources are level triggered.  Once there's nothing more to
+	// send, or no more room to receive, turn them off lest they fire
+	// continuously.  _outbyte() and _inbyte() turn them back on.
+	if (_txhead == _txtail)
+		_zip->z_pic = DINT(SYSPIC_UARTTXF);
+	if (((_rxhead+1)&(CONSOLE_RXRING-1)) == _rxtail)
+		_zip->z_apic = DINT(ALTPIC_UARTRX);
+
+	_zip->z_apic = ALTPIC_UARTRX;
+	_zip->z_pic  = SYSPIC_ALT | SYSPIC_UARTTXF;
+}
+
+void
+_console_drain(void) {
+	if (_console_direct()) {
+		_console_txdrain();
+		_console_rxdrain();
 	}
+}
 
-	// Depend upon the WBUART, not the PIC
-	while((_uart->u_fifo & 0x010000)==0)
-		;
-	uint8_t c = v;
-	UARTTX = (unsigned)c;
+void
+_console_flush(void) {
+	while(_txhead != _txtail)
+		if (_console_direct())
+			_console_txdrain();
+}
+
+static void
+_console_putc(char v) {
+	unsigned	head = _txhead, next = (head + 1) & (CONSOLE_TXRING-1);
+
+	// Wait for room, if the ring is full.  In user mode, make certain the
+	// transmit interrupt is on to make that room: the ISR will have turned
+	// it off if the ring emptied since we last queued anything.
+	while(next == _txtail) {
+		if (_console_direct())
+			_console_txdrain();
+		else
+			_zip->z_pic = EINT(SYSPIC_UARTTXF);
+	}
+
+	_txring[head] = v;
+	_txhead = next;
+}
+
+// Start whatever has been queued on its way
+static void
+_console_kick(void) {
+	if (_console_direct())
+		_console_txdrain();
+	// With interrupts in use, whatever the hardware can't take yet is sent
+	// by _console_isr(), once the CPU is next in user mode
+	if ((_console_irq)&&(_txhead != _txtail))
+		_zip->z_pic = EINT(SYSPIC_UARTTXF);
+}
+#endif
+
+void
+_outbyte(char v) {
+#ifdef	_ZIP_HAS_WBUART
+	if (v == '\n')
+		_console_putc('\r');
+	_console_putc(v);
+	_console_kick();
 #else
 #ifdef	_ZIP_HAS_UARTTX
 	// Depend upon the WBUART, not the PIC
@@ -77,6 +205,21 @@ _outbyte(char v) {
 #endif
 }
 
+void
+_console_write(const char *buf, unsigned n) {
+#ifdef	_ZIP_HAS_WBUART
+	for(unsigned i=0; i<n; i++) {
+		if (buf[i] == '\n')
+			_console_putc('\r');
+		_console_putc(buf[i]);
+	}
+	_console_kick();
+#else
+	for(unsigned i=0; i<n; i++)
+		_outbyte(buf[i]);
+#endif
+}
+
 int
 _inbyte(void) {
 #ifdef	UARTRX
@@ -90,9 +233,26 @@ _inbyte(void) {
 	// 3. \r\n's should quietly be turned into \n's
 	// 4. \n's should be passed as is
 	// Insist on at least one character
+#ifdef	_ZIP_HAS_WBUART
+	if (_console_direct())
+		_console_rxdrain();
+	if (_rxtail == _rxhead)
+		rv = -1;
+	else {
+		rv = (uint8_t)_rxring[_rxtail];
+		_rxtail = (_rxtail + 1) & (CONSOLE_RXRING-1);
+		if (_console_irq)
+			// There's room again
+			_zip->z_apic = EINT(ALTPIC_UARTRX);
+	}
+
+	if (rv == -1)
+		;
+#else
 	rv = UARTRX;
 	if (rv & 0x0100)
 		rv = -1;
+#endif
 	else if ((cr_into_nl)&&(rv == '\r')) {
 		rv = '\n';
 		last_was_cr = 1;
@@ -114,9 +274,18 @@ _inbyte(void) {
 
 int
 _close_r(struct _reent *reent, int file) {
+#ifdef	_BOARD_HAS_SDSPI
+	if (FAT_ISFD(file)) {
+		int	r = fat_close(file);
+		if (r < 0) {
+			reent->_errno = -r;
+			return -1;
+		} return 0;
+	}
+#endif
 	reent->_errno = EBADF;
 
-	return -1;	/* Always fails */
+	return -1;
 }
 
 char	*__env[1] = { 0 };
@@ -143,9 +312,13 @@ _fstat_r(struct _reent *reent, int file, struct stat *st)
 		||(STDIN_FILENO == file)) {
 		st->st_mode = S_IFCHR;
 		return 0;
-#ifdef	_ZIP_HAS_SDCARD_NOTYET
-	} else if (SDCARD_FILENO == file) {
-		st->st_mode = S_IFBLK;
+#ifdef	_BOARD_HAS_SDSPI
+	} else if (FAT_ISFD(file)) {
+		int	r = fat_fstat(file, st);
+		if (r < 0) {
+			reent->_errno = -r;
+			return -1;
+		} return 0;
 #endif
 	} else {
 		reent->_errno = EBADF;
@@ -259,15 +432,13 @@ _link_r(struct _reent *reent, const char *existing, const char *new)
 _off_t
 _lseek_r(struct _reent *reent, int file, _off_t ptr, int dir)
 {
-#ifdef	_ZIP_HAS_SDCARD_NOTYET
-	if (SDCARD_FILENO == file) {
-		switch(dir) {
-		case SEEK_SET:	rootfs_offset = ptr;
-		case SEEK_CUR:	rootfs_offset += ptr;
-		case SEEK_END:	rootfs_offset = rootfs->nsectors * rootfs->sectorsize - ptr;
-		default:
-			reent->_errno = EINVAL; return -1;
-		} return rootfs_offset;
+#ifdef	_BOARD_HAS_SDSPI
+	if (FAT_ISFD(file)) {
+		long	r = fat_lseek(file, ptr, dir);
+		if (r < 0) {
+			reent->_errno = -r;
+			return -1;
+		} return r;
 	}
 #endif
 	reent->_errno = ENOSYS;
@@ -277,13 +448,12 @@ _lseek_r(struct _reent *reent, int file, _off_t ptr, int dir)
 int
 _open_r(struct _reent *reent, const char *file, int flags, int mode)
 {
-#ifdef	_ZIP_HAS_SDCARD_NOTYET
-	if (strcmp(file, "/dev/sdcard")==0) {
-		return SDCARD_FILENO;
-	} else {
-		reent->_errno = EACCES;
+#ifdef	_BOARD_HAS_SDSPI
+	int	r = fat_open(file, flags);
+	if (r < 0) {
+		reent->_errno = -r;
 		return -1;
-	}
+	} return r;
 #endif
 	reent->_errno = ENOSYS;
 	return -1;
@@ -313,9 +483,13 @@ _read_r(struct _reent *reent, int file, void *ptr, size_t len)
 		return nr;
 	}
 #endif
-#ifdef	_ZIP_HAS_SDCARD_NOTYET
-	if (SDCARD_FILENO == file)
-	{
+#ifdef	_BOARD_HAS_SDSPI
+	if (FAT_ISFD(file)) {
+		int	r = fat_read(file, ptr, len);
+		if (r < 0) {
+			reent->_errno = -r;
+			return -1;
+		} return r;
 	}
 #endif
 	errno = ENOSYS;
@@ -331,6 +505,13 @@ _readlink_r(struct _reent *reent, const char *path, char *buf, size_t bufsize)
 
 int
 _stat_r(struct _reent *reent, const char *path, struct stat *buf) {
+#ifdef	_BOARD_HAS_SDSPI
+	int	r = fat_stat(path, buf);
+	if (r < 0) {
+		reent->_errno = -r;
+		return -1;
+	} return 0;
+#endif
 	reent->_errno = EIO;
 	return -1;
 }
@@ -351,14 +532,16 @@ _times(struct tms *buf) {
 int
 _write_r(struct _reent * reent, int fd, const void *buf, size_t nbytes) {
 	if ((STDOUT_FILENO == fd)||(STDERR_FILENO == fd)) {
-		const	char *cbuf = buf;
-		for(int i=0; i<nbytes; i++)
-			_outbyte(cbuf[i]);
+		_console_write(buf, nbytes);
 		return nbytes;
 	}
-#ifdef	_ZIP_HAS_SDCARD_NOTYET
-	if (SDCARD_FILENO == file)
-	{
+#ifdef	_BOARD_HAS_SDSPI
+	if (FAT_ISFD(fd)) {
+		int	r = fat_write(fd, buf, nbytes);
+		if (r < 0) {
+			reent->_errno = -r;
+			return -1;
+		} return r;
 	}
 #endif
 
@@ -372,11 +555,36 @@ _wait(int *status) {
 	return -1;
 }
 
-int	*heap = _top_of_heap;
+char	*heap = (char *)_top_of_heap;
+
+//
+// _sbrk_r
+//
+// Grow (or shrink) the heap by sz bytes.  The heap grows up from
+// _top_of_heap towards the stack, which grows down from _top_of_stack.
+// Refuse any request that would bring the two within ZIP_STACK_GUARD
+// bytes of each other.
+//
+#ifndef	ZIP_STACK_GUARD
+#define	ZIP_STACK_GUARD	2048
+#endif
 
 void *
 _sbrk_r(struct _reent *reent, int sz) {
-	int	*prev = heap;
+	char	*prev = heap, *sp = (char *)&prev;
+
+	// If we're running off of some other stack, such as a user stack
+	// allocated from the heap, then guard the supervisor's instead.
+	if ((sp < heap)||(sp > (char *)_top_of_stack))
+		sp = (char *)_top_of_stack;
+
+	if ((sz > 0)&&((unsigned)(sp - heap) < sz + ZIP_STACK_GUARD)) {
+		reent->_errno = ENOMEM;
+		return (void *)-1;
+	} else if ((sz < 0)&&(heap + sz < (char *)_top_of_heap)) {
+		reent->_errno = EINVAL;
+		return (void *)-1;
+	}
 
 	heap += sz;
 	return	prev;
@@ -386,6 +594,10 @@ __attribute__((__noreturn__))
 void	_exit(int rcode) {
 	extern void	_hw_shutdown(int rcode) _ATTRIBUTE((__noreturn__));
 
+#ifdef	_ZIP_HAS_WBUART
+	// Send anything still waiting in the transmit ring
+	_console_flush();
+#endif
 #ifdef	_BOARD_HAS_BUSCONSOLE
 	// Problem: Once u_tx & 0x100 goes low, there may still be a character
 	// or two in the bus console's pipeline.  These may prevent a newline
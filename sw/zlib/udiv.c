@@ -8,6 +8,13 @@
 //		capability is merged into GCC.  Right now, GCC has no way of
 //	dividing two 64-bit numbers, and this routine provides that capability.
 //
+//	Rather than working one bit at a time, __udivmoddi4() builds its
+//	quotient 16-bits at a time, using the 32-bit hardware divide
+//	instruction to estimate each digit.  Divisors that fit in 32-bits,
+//	the common case when converting times and fixed point values, take
+//	one to five hardware divides and no 64-bit arithmetic beyond a
+//	final shift.
+//
 //
 // Creator:	Dan Gisselquist, Ph.D.
 //		Gisselquist Technology, LLC
@@ -121,54 +128,143 @@ cltz(unsigned long v) {
 }
 #endif
 
-unsigned long
-__udivdi3(unsigned long a, unsigned long b) {
-	unsigned long	r;
+//
+// nlz32
+//
+// Number of leading zeros in a non-zero 32-bit value
+//
+static inline int
+nlz32(uint32_t v) {
+	return cltz((unsigned long)v) - 32;
+}
 
-	if (a < b)
-		return 0;
-	if (((b>>32)==0)&&((a>>32)==0)) {
-		uint32_t	ia, ib, ir;
-
-		ia = (uint32_t) a;
-		ib = (uint32_t) b;
-		ir = ia / ib;
-		r = (unsigned long)ir;
-		return r;
+//
+// divlu
+//
+// Divide the 64-bit value {u1,u0} by the 32-bit value v, returning a 32-bit
+// quotient and, if r is non-NULL, a 32-bit remainder.  u1 must be less than
+// v, so that the quotient fits in 32-bits.
+//
+// This is Knuth's algorithm D, as presented in Hacker's Delight, using 16-bit
+// digits so that each digit of the quotient can be estimated with a single
+// 32-bit hardware divide.  Each estimate is at most two too large, and the
+// corrections below catch all but the rarest of those cases up front.
+//
+static uint32_t
+divlu(uint32_t u1, uint32_t u0, uint32_t v, uint32_t *r) {
+	const	uint32_t	b = 0x10000;
+	uint32_t	vn1, vn0, un32, un21, un10, un1, un0, q1, q0, rhat;
+	int		s;
+
+	// Normalize, so the divisor's top bit is set
+	s = nlz32(v);
+	v <<= s;
+	vn1 = v >> 16;
+	vn0 = v & 0x0ffff;
+
+	un32 = (s == 0) ? u1 : ((u1 << s) | (u0 >> (32 - s)));
+	un10 = u0 << s;
+	un1  = un10 >> 16;
+	un0  = un10 & 0x0ffff;
+
+	// First quotient digit
+	q1 = un32 / vn1;
+	rhat = un32 - q1 * vn1;
+	while((q1 >= b)||(q1 * vn0 > ((rhat << 16) | un1))) {
+		q1--;
+		rhat += vn1;
+		if (rhat >= b)
+			break;
+	}
+
+	// Second quotient digit
+	un21 = (un32 << 16) + un1 - q1 * v;
+	q0 = un21 / vn1;
+	rhat = un21 - q0 * vn1;
+	while((q0 >= b)||(q0 * vn0 > ((rhat << 16) | un0))) {
+		q0--;
+		rhat += vn1;
+		if (rhat >= b)
+			break;
 	}
 
-	int	la = cltz(a), lb = cltz(b);
-	a <<= la;
-	unsigned long	m;
-	if ((lb - la < 32)&&(((b<<la)&0x0ffffffff)==0)) {
-		// Problem is now to divide
-		//	[a * 2^(la-32)] / [b * 2^(la-32)] * 2^(la-la)
-		//
-		uint32_t	ia, ib, ir;
-		b <<= la;
-		ia = (uint32_t)(a>>32);
-		ib = (uint32_t)(b>>32);
-		ir = ia / ib;
-		r = ir;
-		return r;
+	if (r)
+		*r = ((un21 << 16) + un0 - q0 * v) >> s;
+	return (q1 << 16) | q0;
+}
+
+//
+// __udivmoddi4
+//
+// Return a / b, and set *rem (if non-NULL) to a % b.  This replaces a
+// bit-serial divide, which took up to 64 passes through its loop, with at most
+// two 32-bit divides per 16-bits of quotient.
+//
+unsigned long
+__udivmoddi4(unsigned long a, unsigned long b, unsigned long *rem) {
+	uint32_t	ah = (uint32_t)(a >> 32), al = (uint32_t)a,
+			bh = (uint32_t)(b >> 32), bl = (uint32_t)b;
+
+	if (bh == 0) {
+		uint32_t	qh, ql, r;
+
+		if (ah == 0) {
+			// 32-bit by 32-bit: a single hardware divide.  This
+			// also catches (and traps on) division by zero.
+			ql = al / bl;
+			if (rem)
+				*rem = al - ql * bl;
+			return ql;
+		} else if (ah < bl) {
+			// The quotient fits in 32-bits
+			ql = divlu(ah, al, bl, rem ? &r : (uint32_t *)0);
+			if (rem)
+				*rem = r;
+			return ql;
+		}
+
+		// Otherwise, two steps: divide the upper word first, then
+		// the remainder together with the lower word
+		qh = ah / bl;
+		ql = divlu(ah - qh * bl, al, bl, rem ? &r : (uint32_t *)0);
+		if (rem)
+			*rem = r;
+		return (((unsigned long)qh)<<32) | ql;
+	} else if (a < b) {
+		if (rem)
+			*rem = a;
+		return 0;
 	} else {
-		// Problem is now to divide
-		//	[a * 2^(la)] / [b * 2^(lb)] * 2^(lb-la)
-		//
-		r = 0;
-		b <<= lb;
-		m = (1ul<<(lb-la));
-		while(m > 0) {
-			if (a >= b) {
-				r |= m;
-				a -= b;
-			}
-			m>>= 1;
-			b >>= 1;
-		} return r;
+		// A 64-bit divisor, so the quotient fits in 32-bits.  Estimate
+		// it from the top 32-bits of the normalized divisor (Hacker's
+		// Delight, divdu).  The estimate is either right, or one too
+		// big once reduced.
+		unsigned long	q, r;
+		int		n = nlz32(bh);
+		uint32_t	v1 = (uint32_t)((b << n) >> 32);
+
+		q = divlu((uint32_t)(a >> 33), (uint32_t)(a >> 1), v1,
+						(uint32_t *)0);
+		q = (q << n) >> 31;
+		if (q != 0)
+			q--;
+		r = a - q * b;
+		if (r >= b) {
+			q++;
+			r -= b;
+		}
+
+		if (rem)
+			*rem = r;
+		return q;
 	}
 }
 
+unsigned long
+__udivdi3(unsigned long a, unsigned long b) {
+	return __udivmoddi4(a, b, (unsigned long *)0);
+}
+
 //
 // A possible assembly version of __divdi3
 //
@@ -209,19 +305,14 @@ __udivdi3(unsigned long a, unsigned long b) {
 //	RETN
 //
 long __divdi3(long a, long b) {
-	int	s = 0;
-	long	r;
-
-	if (a < 0) {
-		s = 1; a = -a;
-	}
+	unsigned long	ua, ub, r;
 
-	if (b < 0) {
-		s ^= 1; b = -b;
-	}
+	// Negate as unsigned, so that LONG_MIN doesn't overflow
+	ua = (a < 0) ? -(unsigned long)a : (unsigned long)a;
+	ub = (b < 0) ? -(unsigned long)b : (unsigned long)b;
 
-	r = (long)__udivdi3((unsigned long)a, (unsigned long)b);
-	if (s)
+	r = __udivmoddi4(ua, ub, (unsigned long *)0);
+	if ((a < 0) != (b < 0))
 		r = -r;
-	return r;
+	return (long)r;
 }
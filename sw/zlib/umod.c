@@ -6,8 +6,9 @@
 //
 // Purpose:	This is a temporary file--a crutch if you will--until a similar
 //		capability is merged into GCC.  Right now, GCC has no way of
-//	taking the module of two 64-bit numbers, and this routine provides that
-//	capability.
+//	taking the module of two 64-bit numbers, and these routines provide
+//	that capability, for both unsigned (__umoddi3) and signed (__moddi3)
+//	operands.
 //
 //	This routine is required by and used by newlib's printf in order to
 //	print decimal numbers (%d) to an IO stream.
@@ -47,16 +48,27 @@
 #include <stdint.h>
 
 
-unsigned long __udivdi3(unsigned long, unsigned long);
+unsigned long __udivmoddi4(unsigned long, unsigned long, unsigned long *);
 
 __attribute((noinline))
 unsigned long __umoddi3(unsigned long a, unsigned long b) {
 	unsigned long	r;
 
-	// Return a modulo b, or a%b in C syntax
-	r = __udivdi3(a, b);
-	r = r * b;
-	r = a - r;
+	// Return a modulo b, or a%b in C syntax.  The divide leaves the
+	// remainder behind, so there's no need to multiply back out.
+	__udivmoddi4(a, b, &r);
 	return r;
 }
 
+long __moddi3(long a, long b) {
+	unsigned long	ua, ub, r;
+
+	// As with C's %, the result takes the sign of the dividend
+	ua = (a < 0) ? -(unsigned long)a : (unsigned long)a;
+	ub = (b < 0) ? -(unsigned long)b : (unsigned long)b;
+
+	__udivmoddi4(ua, ub, &r);
+	if (a < 0)
+		r = -r;
+	return (long)r;
+}
@@ -0,0 +1,305 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zfmt.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	The formatted output routines declared in zfmt.h.  Output
+//		goes through a ZFMTOUT, which either fills a caller's buffer
+//	(zsnprintf) or sends a stack buffer to the console each time it fills
+//	(zprintf).
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stddef.h>
+#include "console.h"
+#include "zfmt.h"
+
+typedef	struct	{
+	char		*o_buf;
+	unsigned	o_pos, o_len;	// Bytes in o_buf, and its size
+	int		o_count;	// Bytes produced, kept or not
+	// Called to empty o_buf once it fills.  If NULL, whatever doesn't
+	// fit is dropped.
+	void		(*o_flush)(const char *, unsigned);
+} ZFMTOUT;
+
+static	const	char	zfmt_hexlc[] = "0123456789abcdef",
+			zfmt_hexuc[] = "0123456789ABCDEF";
+
+// "00" through "99", for two decimal digits at a time
+static	const	char	zfmt_dec2[200] =
+	"00010203040506070809" "10111213141516171819"
+	"20212223242526272829" "30313233343536373839"
+	"40414243444546474849" "50515253545556575859"
+	"60616263646566676869" "70717273747576777879"
+	"80818283848586878889" "90919293949596979899";
+
+static void
+zfmt_put(ZFMTOUT *o, const char *str, unsigned n) {
+	o->o_count += n;
+	while(n > 0) {
+		unsigned	ln = o->o_len - o->o_pos;
+
+		if (ln == 0) {
+			if (!o->o_flush)
+				return;
+			o->o_flush(o->o_buf, o->o_pos);
+			o->o_pos = 0;
+			ln = o->o_len;
+		}
+
+		if (ln > n)
+			ln = n;
+		for(unsigned k=0; k<ln; k++)
+			o->o_buf[o->o_pos++] = *str++;
+		n -= ln;
+	}
+}
+
+static void
+zfmt_pad(ZFMTOUT *o, char ch, int n) {
+	static	const	char	spaces[] = "                ",
+				zeros[]  = "0000000000000000";
+	const	char	*src = (ch == '0') ? zeros : spaces;
+
+	while(n > 0) {
+		int	ln = (n > 16) ? 16 : n;
+
+		zfmt_put(o, src, ln);
+		n -= ln;
+	}
+}
+
+//
+// zfmt_udec
+//
+// Writes v in decimal, backwards from end, returning a pointer to its first
+// digit.  v/100 is found as (v * ceil(2^37 / 100)) >> 37, which is exact for
+// all 32-bit v.  unsigned long is 64-bits, so this is one 32x32 multiply
+// returning the upper half.
+//
+static char *
+zfmt_udec(char *end, unsigned v) {
+	char	*p = end;
+
+	while(v >= 100) {
+		unsigned	q, r;
+
+		q = (unsigned)(((unsigned long)v * 0x51eb851fu) >> 37);
+		r = (v - q * 100) * 2;
+		*--p = zfmt_dec2[r+1];
+		*--p = zfmt_dec2[r];
+		v = q;
+	}
+
+	if (v >= 10) {
+		*--p = zfmt_dec2[2*v+1];
+		*--p = zfmt_dec2[2*v];
+	} else
+		*--p = '0' + v;
+
+	return p;
+}
+
+static char *
+zfmt_uhex(char *end, unsigned v, const char *digits) {
+	char	*p = end;
+
+	do {
+		*--p = digits[v & 0x0f];
+		v >>= 4;
+	} while(v != 0);
+
+	return p;
+}
+
+static void
+zfmt_format(ZFMTOUT *o, const char *fmt, va_list ap) {
+	char		tmp[12], *end = &tmp[sizeof(tmp)], *str;
+	const	char	*lit;
+	unsigned	ln;
+
+	while(*fmt) {
+		int	left = 0, width = 0;
+		char	padc = ' ', sign = 0;
+
+		// Copy everything up to the next conversion in one go
+		lit = fmt;
+		while((*fmt)&&(*fmt != '%'))
+			fmt++;
+		if (fmt != lit)
+			zfmt_put(o, lit, fmt - lit);
+		if (!*fmt)
+			break;
+		lit = fmt++;	// The '%', should the conversion be unknown
+
+		// Flags
+		for(;;fmt++) {
+			if (*fmt == '-')
+				left = 1;
+			else if (*fmt == '0')
+				padc = '0';
+			else
+				break;
+		}
+
+		// Width
+		if (*fmt == '*') {
+			width = va_arg(ap, int);
+			if (width < 0) {
+				left = 1;
+				width = -width;
+			} fmt++;
+		} else while((*fmt >= '0')&&(*fmt <= '9'))
+			width = width * 10 + (*fmt++ - '0');
+
+		switch(*fmt++) {
+		case 'd': case 'i': {
+			int	v = va_arg(ap, int);
+			if (v < 0) {
+				sign = '-';
+				str = zfmt_udec(end, -(unsigned)v);
+			} else
+				str = zfmt_udec(end, v);
+			} break;
+		case 'u':
+			str = zfmt_udec(end, va_arg(ap, unsigned));
+			break;
+		case 'x':
+			str = zfmt_uhex(end, va_arg(ap, unsigned), zfmt_hexlc);
+			break;
+		case 'X':
+			str = zfmt_uhex(end, va_arg(ap, unsigned), zfmt_hexuc);
+			break;
+		case 'c':
+			tmp[0] = (char)va_arg(ap, int);
+			str = tmp; end = &tmp[1];
+			padc = ' ';
+			break;
+		case 's':
+			str = va_arg(ap, char *);
+			if (!str)
+				str = "(null)";
+			for(end=str; *end; end++)
+				;
+			padc = ' ';
+			break;
+		case '%':
+			zfmt_put(o, "%", 1);
+			continue;
+		default:
+			// Unknown, or the format ended mid conversion.  Copy
+			// it out as it was.
+			if (fmt[-1] == '\0')
+				fmt--;
+			zfmt_put(o, lit, fmt - lit);
+			continue;
+		}
+
+		ln = (end - str) + ((sign) ? 1 : 0);
+		width = ((unsigned)width > ln) ? width - ln : 0;
+		if (left) {
+			if (sign)
+				zfmt_put(o, &sign, 1);
+			zfmt_put(o, str, end - str);
+			zfmt_pad(o, ' ', width);
+		} else {
+			if (padc == '0') {
+				if (sign)
+					zfmt_put(o, &sign, 1);
+				zfmt_pad(o, '0', width);
+			} else {
+				zfmt_pad(o, ' ', width);
+				if (sign)
+					zfmt_put(o, &sign, 1);
+			}
+			zfmt_put(o, str, end - str);
+		}
+
+		end = &tmp[sizeof(tmp)];
+	}
+}
+
+int
+zvsnprintf(char *buf, unsigned len, const char *fmt, va_list ap) {
+	ZFMTOUT	o;
+
+	o.o_buf   = buf;
+	o.o_pos   = 0;
+	o.o_len   = (len > 0) ? len-1 : 0;	// Leave room for the NUL
+	o.o_count = 0;
+	o.o_flush = NULL;
+
+	zfmt_format(&o, fmt, ap);
+	if (len > 0)
+		buf[o.o_pos] = '\0';
+	return o.o_count;
+}
+
+int
+zsnprintf(char *buf, unsigned len, const char *fmt, ...) {
+	va_list	ap;
+	int	r;
+
+	va_start(ap, fmt);
+	r = zvsnprintf(buf, len, fmt, ap);
+	va_end(ap);
+	return r;
+}
+
+int
+zvprintf(const char *fmt, va_list ap) {
+	char	buf[ZFMT_BUFSZ];
+	ZFMTOUT	o;
+
+	o.o_buf   = buf;
+	o.o_pos   = 0;
+	o.o_len   = sizeof(buf);
+	o.o_count = 0;
+	o.o_flush = _console_write;
+
+	zfmt_format(&o, fmt, ap);
+	if (o.o_pos > 0)
+		_console_write(buf, o.o_pos);
+	return o.o_count;
+}
+
+int
+zprintf(const char *fmt, ...) {
+	va_list	ap;
+	int	r;
+
+	va_start(ap, fmt);
+	r = zvprintf(fmt, ap);
+	va_end(ap);
+	return r;
+}
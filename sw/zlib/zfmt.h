@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zfmt.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	A small formatted output library, for when newlib's printf()
+//		is too large or too slow.  Only the following conversions
+//	are supported:
+//
+//		%d %i	Signed decimal
+//		%u	Unsigned decimal
+//		%x %X	Unsigned hexadecimal, lower or upper case
+//		%s	String
+//		%c	Character
+//		%%	A percent sign
+//
+//	Each may be given a minimum width, either as a number or as a '*'
+//	taking it from the argument list, and the flags '-' (left justify) and
+//	'0' (pad numbers with zeros).  There are no length modifiers: all
+//	numbers are 32-bit ints.  Anything else is copied out as is.
+//
+//	Decimal conversion uses no divides.  Digits are peeled off two at a
+//	time, dividing by 100 by multiplying by its reciprocal.
+//
+//	zsnprintf() writes into a caller's buffer, and returns the length the
+//	string would have had, just as snprintf() does.  zprintf() formats
+//	into a buffer on the stack, and hands it to the console's transmit
+//	ring a buffer at a time, rather than a character at a time.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	ZFMT_H
+#define	ZFMT_H
+
+#include <stdarg.h>
+
+// Size of zprintf()'s stack buffer.  Output is sent whenever it fills.
+#ifndef	ZFMT_BUFSZ
+#define	ZFMT_BUFSZ	128
+#endif
+
+extern	int	zsnprintf(char *buf, unsigned len, const char *fmt, ...)
+			__attribute__((format(printf, 3, 4)));
+extern	int	zvsnprintf(char *buf, unsigned len, const char *fmt,
+			va_list ap);
+extern	int	zprintf(const char *fmt, ...)
+			__attribute__((format(printf, 1, 2)));
+extern	int	zvprintf(const char *fmt, va_list ap);
+
+#endif
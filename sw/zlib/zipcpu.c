@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zipcpu.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	Definitions for the simpler of the special purpose ZipCPU
+//		routines declared in zipcpu.h.
+//
+//	zip_rtu()	Switches to user mode, starting at uPC.  Returns once
+//			the CPU comes back to supervisor mode, whether by
+//			interrupt, trap, or exception.  Check uCC to see which.
+//	zip_halt()	Halts the CPU.
+//	zip_idle()	Waits for an interrupt.
+//	zip_syscall()	From user mode, traps into the supervisor.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include "zipcpu.h"
+
+// The supervisor picks up from the instruction following the RTU
+asm(ASMFNSTR("zip_rtu")
+	"\tRTU\n"
+	"\tRETN\n");
+
+asm(ASMFNSTR("zip_halt")
+	"\tHALT\n"
+	"\tRETN\n");
+
+asm(ASMFNSTR("zip_idle")
+	"\tWAIT\n"
+	"\tRETN\n");
+
+// Clearing the GIE bit from user mode returns control to the supervisor
+asm(ASMFNSTR("zip_syscall")
+	"\tAND\t0xffffffdf,CC\n"
+	"\tRETN\n");
@@ -0,0 +1,986 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zipfat.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	A FAT16/FAT32 file system layer, above sdcard.c.  See zipfat.h
+//		for what it does, and doesn't, support.
+//
+//	Everything on disk is little endian, whereas the ZipCPU is big endian.
+//	All multi-byte fields are therefore accessed a byte at a time.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "board.h"
+#include "sdcard.h"
+#include "zipfat.h"
+
+#ifdef	_BOARD_HAS_SDSPI
+
+#define	FAT_SECTOR	SDCARD_BLKSZ
+
+// Directory entry fields
+#define	DIR_ENTSZ	32
+#define	DIR_ATTR	11
+#define	DIR_CLUSHI	20
+#define	DIR_CLUSLO	26
+#define	DIR_SIZE	28
+#define	ATTR_VOLUME	0x08
+#define	ATTR_DIR	0x10
+#define	ATTR_ARCHIVE	0x20
+#define	ATTR_LFN	0x0f
+#define	DIR_FREE	0xe5	// First byte of a deleted entry
+#define	DIR_END		0x00	// First byte of the entry past the last
+
+typedef	struct	{
+	unsigned	c_lba, c_stamp;
+	int		c_valid, c_dirty;
+	uint32_t	c_data[FAT_SECTOR/4];	// Word aligned, for the DMA
+} FATCACHE;
+
+typedef	struct	{
+	int		fs_mounted, fs_type;	// fs_type is 16 or 32
+	unsigned	fs_fatlba, fs_fatsz, fs_nfats,
+			fs_rootlba, fs_rootsecs,	// FAT16 root directory
+			fs_rootclus,			// FAT32 root directory
+			fs_datalba, fs_spc, fs_nclus,
+			fs_freehint, fs_fsinfo;
+} FATFS;
+
+typedef	struct	{
+	int		f_used, f_flags, f_dirty;
+	unsigned	f_first,	// First cluster, or zero if empty
+			f_last,		// Last cluster in the chain
+			f_nclus,	// Length of the chain
+			f_size, f_pos,
+			f_dirlba, f_diroff;	// Where the directory entry is
+	// The extent cache.  File clusters f_ci through f_ci+f_runlen-1 are
+	// disk clusters f_clus through f_clus+f_runlen-1.
+	unsigned	f_ci, f_clus, f_runlen;
+} FATFILE;
+
+static	FATCACHE	fat_cache[FAT_NCACHE];
+static	unsigned	fat_stamp;
+static	FATFS		fs;
+static	FATFILE		fat_files[FAT_NFILES];
+
+static unsigned
+le16(const uint8_t *p) {
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned
+le32(const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24);
+}
+
+static void
+setle16(uint8_t *p, unsigned v) {
+	p[0] = v; p[1] = v >> 8;
+}
+
+static void
+setle32(uint8_t *p, unsigned v) {
+	p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// The sector cache
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+
+static int
+cache_writeback(FATCACHE *c) {
+	if ((!c->c_valid)||(!c->c_dirty))
+		return 0;
+	if (sdcard_write(c->c_lba, 1, c->c_data) != 0)
+		return -EIO;
+
+	// Keep any mirror copies of the FAT up to date as well
+	if ((c->c_lba >= fs.fs_fatlba)&&(c->c_lba < fs.fs_fatlba+fs.fs_fatsz)) {
+		for(unsigned k=1; k<fs.fs_nfats; k++)
+			if (sdcard_write(c->c_lba + k*fs.fs_fatsz, 1,
+					c->c_data) != 0)
+				return -EIO;
+	}
+
+	c->c_dirty = 0;
+	return 0;
+}
+
+static int
+cache_flush(void) {
+	int	r = 0;
+
+	for(int k=0; k<FAT_NCACHE; k++)
+		if (cache_writeback(&fat_cache[k]) != 0)
+			r = -EIO;
+	return r;
+}
+
+//
+// Return the cached copy of sector lba, reading it in if fetch is set.  If
+// it isn't, the caller is about to overwrite it all.
+//
+static uint8_t *
+cache_get(unsigned lba, int fetch) {
+	FATCACHE	*c, *victim = &fat_cache[0];
+
+	for(int k=0; k<FAT_NCACHE; k++) {
+		c = &fat_cache[k];
+		if ((c->c_valid)&&(c->c_lba == lba)) {
+			c->c_stamp = ++fat_stamp;
+			return (uint8_t *)c->c_data;
+		}
+
+		if (!c->c_valid)
+			victim = c;
+		else if ((victim->c_valid)&&(c->c_stamp < victim->c_stamp))
+			victim = c;
+	}
+
+	if (cache_writeback(victim) != 0)
+		return NULL;
+
+	victim->c_valid = 0;
+	if ((fetch)&&(sdcard_read(lba, 1, victim->c_data) != 0))
+		return NULL;
+
+	victim->c_lba   = lba;
+	victim->c_valid = 1;
+	victim->c_dirty = 0;
+	victim->c_stamp = ++fat_stamp;
+	return (uint8_t *)victim->c_data;
+}
+
+// Mark the sector last returned by cache_get() as modified
+static void
+cache_dirty(const uint8_t *s) {
+	FATCACHE	*c = (FATCACHE *)(s - offsetof(FATCACHE, c_data));
+
+	c->c_dirty = 1;
+}
+
+//
+// Following a direct transfer of n sectors, from lba, between the card and
+// buf: if written, bring any cached copies up to date; if read, replace what
+// was read with any cached copies, since they may be newer.
+//
+static void
+cache_direct(unsigned lba, unsigned n, uint8_t *buf, int written) {
+	for(int k=0; k<FAT_NCACHE; k++) {
+		FATCACHE	*c = &fat_cache[k];
+		uint8_t		*p;
+
+		if ((!c->c_valid)||(c->c_lba < lba)||(c->c_lba >= lba+n))
+			continue;
+		p = &buf[(c->c_lba - lba) * FAT_SECTOR];
+		if (written) {
+			memcpy(c->c_data, p, FAT_SECTOR);
+			c->c_dirty = 0;
+		} else
+			memcpy(p, c->c_data, FAT_SECTOR);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// The file allocation table
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+
+static unsigned
+clus_lba(unsigned c) {
+	return fs.fs_datalba + (c - 2) * fs.fs_spc;
+}
+
+// True if v doesn't point to another cluster: end of chain, bad, or free
+static int
+fat_eoc(unsigned v) {
+	if (v < 2)
+		return 1;
+	return v >= ((fs.fs_type == 32) ? 0x0ffffff7 : 0x0fff7);
+}
+
+static int
+fat_get(unsigned c, unsigned *v) {
+	unsigned	off = (fs.fs_type == 32) ? c*4 : c*2;
+	uint8_t		*s;
+
+	if ((c < 2)||(c >= fs.fs_nclus + 2))
+		return -EIO;
+	if ((s = cache_get(fs.fs_fatlba + off / FAT_SECTOR, 1)) == NULL)
+		return -EIO;
+	off &= FAT_SECTOR-1;
+	*v = (fs.fs_type == 32) ? (le32(&s[off]) & 0x0fffffff) : le16(&s[off]);
+	return 0;
+}
+
+static int
+fat_set(unsigned c, unsigned v) {
+	unsigned	off = (fs.fs_type == 32) ? c*4 : c*2;
+	uint8_t		*s;
+
+	if ((s = cache_get(fs.fs_fatlba + off / FAT_SECTOR, 1)) == NULL)
+		return -EIO;
+	off &= FAT_SECTOR-1;
+	if (fs.fs_type == 32)	// The top four bits are reserved
+		setle32(&s[off], (le32(&s[off]) & 0xf0000000) | v);
+	else
+		setle16(&s[off], v);
+	cache_dirty(s);
+	return 0;
+}
+
+//
+// The first time the FAT changes on a FAT32 volume, mark the free cluster
+// count and hint in the FSInfo sector as unknown, since we won't be keeping
+// them up to date.
+//
+static void
+fat_fsinfo(void) {
+	uint8_t	*s;
+
+	if (fs.fs_fsinfo == 0)
+		return;
+	if (((s = cache_get(fs.fs_fsinfo, 1)) != NULL)
+			&&(le32(&s[0]) == 0x41615252)
+			&&(le32(&s[484]) == 0x61417272)) {
+		setle32(&s[488], 0xffffffff);
+		setle32(&s[492], 0xffffffff);
+		cache_dirty(s);
+	}
+	fs.fs_fsinfo = 0;
+}
+
+//
+// Allocate a free cluster, marking it as the end of a chain, and link it to
+// prev (if non-zero).  The cluster following prev is tried first, so that
+// files grow contiguously where they can.
+//
+static int
+fat_alloc(unsigned prev, unsigned *nc) {
+	unsigned	c, v;
+	int		r;
+
+	c = (prev) ? prev+1 : fs.fs_freehint;
+	for(unsigned k=0; k<fs.fs_nclus; k++, c++) {
+		if ((c < 2)||(c >= fs.fs_nclus + 2))
+			c = 2;
+		if ((r = fat_get(c, &v)) != 0)
+			return r;
+		if (v != 0)
+			continue;
+
+		fat_fsinfo();
+		if ((r = fat_set(c, (fs.fs_type == 32) ? 0x0fffffff : 0x0ffff)) != 0)
+			return r;
+		if ((prev)&&((r = fat_set(prev, c)) != 0))
+			return r;
+		fs.fs_freehint = c+1;
+		*nc = c;
+		return 0;
+	}
+
+	return -ENOSPC;
+}
+
+// Free the chain starting at c
+static int
+fat_free(unsigned c) {
+	unsigned	next;
+	int		r;
+
+	while(!fat_eoc(c)) {
+		if ((r = fat_get(c, &next)) != 0)
+			return r;
+		if ((r = fat_set(c, 0)) != 0)
+			return r;
+		if (c < fs.fs_freehint)
+			fs.fs_freehint = c;
+		c = next;
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Directories
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+
+//
+// Convert one path component to an 8.3 directory name.  Returns the length
+// of the component consumed, or a negative errno if it won't fit.
+//
+static int
+fat_name(const char *path, uint8_t *name) {
+	int	n = 0, k = 0, ext = 0;
+
+	memset(name, ' ', 11);
+
+	// The dot and dot-dot entries are stored as they are, without any
+	// extension
+	if (path[0] == '.') {
+		n = (path[1] == '.') ? 2 : 1;
+		if ((path[n] == '\0')||(path[n] == '/')) {
+			memset(name, '.', n);
+			return n;
+		}
+	}
+
+	for(n=0; (path[n])&&(path[n] != '/'); n++) {
+		char	ch = path[n];
+
+		if ((ch == '.')&&(!ext)&&(n > 0)) {
+			ext = 1;
+			k = 8;
+			continue;
+		} if ((ch >= 'a')&&(ch <= 'z'))
+			ch -= 'a' - 'A';
+		if ((k >= 11)||((!ext)&&(k >= 8)))
+			return -ENAMETOOLONG;
+		name[k++] = ch;
+	}
+
+	if (n == 0)
+		return -ENOENT;
+	if (name[0] == DIR_FREE)
+		name[0] = 0x05;
+	return n;
+}
+
+typedef	struct	{
+	unsigned	d_lba, d_off;	// Where the entry lives
+	unsigned	d_clus, d_size;
+	unsigned	d_attr;
+} FATDIRENT;
+
+//
+// Search the directory starting at cluster dclus (zero for the FAT16 root)
+// for name.  With name NULL, look for a free entry instead, extending the
+// directory if it's full.
+//
+static int
+dir_search(unsigned dclus, const uint8_t *name, FATDIRENT *d) {
+	unsigned	c = dclus, lba, nsec, next;
+	int		r;
+
+	if ((c == 0)&&(fs.fs_type == 32))
+		c = fs.fs_rootclus;
+
+	while(1) {
+		if (c == 0) {
+			lba  = fs.fs_rootlba;
+			nsec = fs.fs_rootsecs;
+		} else {
+			lba  = clus_lba(c);
+			nsec = fs.fs_spc;
+		}
+
+		for(unsigned s=0; s<nsec; s++) {
+			uint8_t	*sec = cache_get(lba+s, 1);
+
+			if (!sec)
+				return -EIO;
+			for(unsigned off=0; off<FAT_SECTOR; off+=DIR_ENTSZ) {
+				uint8_t	*e = &sec[off];
+
+				if ((e[0] == DIR_END)&&(name))
+					return -ENOENT;
+				if ((e[0] == DIR_END)||(e[0] == DIR_FREE)) {
+					if (name)
+						continue;
+				} else if (!name)
+					continue;
+				else if ((e[DIR_ATTR] == ATTR_LFN)
+					||(e[DIR_ATTR] & ATTR_VOLUME)
+					||(memcmp(e, name, 11) != 0))
+					continue;
+
+				d->d_lba  = lba+s;
+				d->d_off  = off;
+				d->d_attr = e[DIR_ATTR];
+				d->d_clus = le16(&e[DIR_CLUSLO]);
+				if (fs.fs_type == 32)
+					d->d_clus |= le16(&e[DIR_CLUSHI])<<16;
+				d->d_size = le32(&e[DIR_SIZE]);
+				return 0;
+			}
+		}
+
+		if (c == 0)	// The FAT16 root directory can't grow
+			return (name) ? -ENOENT : -ENOSPC;
+		if ((r = fat_get(c, &next)) != 0)
+			return r;
+		if (!fat_eoc(next)) {
+			c = next;
+			continue;
+		} if (name)
+			return -ENOENT;
+
+		// Out of room.  Add a cluster of empty entries.
+		if ((r = fat_alloc(c, &next)) != 0)
+			return r;
+		for(unsigned s=0; s<fs.fs_spc; s++) {
+			uint8_t	*sec = cache_get(clus_lba(next)+s, 0);
+
+			if (!sec)
+				return -EIO;
+			memset(sec, 0, FAT_SECTOR);
+			cache_dirty(sec);
+		}
+		c = next;
+	}
+}
+
+//
+// Walk path down to its last component.  *dclus is set to the directory
+// holding that component, and name to its 8.3 name.  Returns zero if the
+// component was found, filling *d, one if it wasn't (but its directory was),
+// or a negative errno.
+//
+static int
+path_walk(const char *path, unsigned *dclus, uint8_t *name, FATDIRENT *d) {
+	int	n, r;
+
+	*dclus = 0;
+	while(1) {
+		while(*path == '/')
+			path++;
+		if ((n = fat_name(path, name)) < 0)
+			return n;
+		path += n;
+		while(*path == '/')
+			path++;
+
+		if ((*dclus == 0)&&(name[0] == '.')&&(name[2] == ' ')
+				&&((name[1] == '.')||(name[1] == ' '))) {
+			// The root directory has no dot entries of its own, but
+			// both lead back to it
+			memset(d, 0, sizeof(FATDIRENT));
+			d->d_attr = ATTR_DIR;
+			r = 0;
+		} else
+			r = dir_search(*dclus, name, d);
+		if (*path == '\0')
+			return (r == -ENOENT) ? 1 : r;
+		if (r != 0)
+			return r;
+		if ((d->d_attr & ATTR_DIR) == 0)
+			return -ENOTDIR;
+		*dclus = d->d_clus;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Files
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+
+//
+// Find the disk cluster holding file cluster ci, and how many clusters from
+// there are contiguous on the disk.  Counting stops at want clusters.
+//
+static int
+file_map(FATFILE *f, unsigned ci, unsigned want, unsigned *clus, unsigned *run) {
+	unsigned	c, k, next, len;
+	int		r;
+
+	if ((f->f_runlen > 0)&&(ci >= f->f_ci)&&(ci < f->f_ci + f->f_runlen)
+			&&((ci - f->f_ci) + want <= f->f_runlen)) {
+		*clus = f->f_clus + (ci - f->f_ci);
+		*run  = f->f_runlen - (ci - f->f_ci);
+		return 0;
+	}
+
+	// Pick up from the extent if we can, else from the start of the file
+	if ((f->f_runlen > 0)&&(ci >= f->f_ci)) {
+		k = f->f_ci + f->f_runlen - 1;
+		if (ci < k)
+			k = ci;
+		c = f->f_clus + (k - f->f_ci);
+	} else {
+		k = 0;
+		c = f->f_first;
+	}
+
+	if (fat_eoc(c))
+		return -EIO;
+	for(; k < ci; k++) {
+		if ((r = fat_get(c, &next)) != 0)
+			return r;
+		if (fat_eoc(next))
+			return -EIO;
+		c = next;
+	}
+
+	f->f_ci   = ci;
+	f->f_clus = c;
+	for(len=1; len < want; len++) {
+		if ((r = fat_get(c, &next)) != 0)
+			return r;
+		if (next != c+1)
+			break;
+		c = next;
+	}
+	f->f_runlen = len;
+
+	*clus = f->f_clus;
+	*run  = len;
+	return 0;
+}
+
+static FATFILE *
+file_get(int fd) {
+	FATFILE	*f;
+
+	if (!FAT_ISFD(fd))
+		return NULL;
+	f = &fat_files[fd - FAT_FD0];
+	return (f->f_used) ? f : NULL;
+}
+
+// Update the file's directory entry
+static int
+file_dirent(FATFILE *f) {
+	uint8_t	*s;
+
+	if (!f->f_dirty)
+		return 0;
+	if ((s = cache_get(f->f_dirlba, 1)) == NULL)
+		return -EIO;
+	setle16(&s[f->f_diroff + DIR_CLUSLO], f->f_first);
+	setle16(&s[f->f_diroff + DIR_CLUSHI],
+		(fs.fs_type == 32) ? (f->f_first >> 16) : 0);
+	setle32(&s[f->f_diroff + DIR_SIZE], f->f_size);
+	s[f->f_diroff + DIR_ATTR] |= ATTR_ARCHIVE;
+	cache_dirty(s);
+	f->f_dirty = 0;
+	return 0;
+}
+
+int
+fat_mount(void) {
+	uint8_t		*s;
+	unsigned	part = 0, bps, rsvd, nroot, totsec, nsec;
+	int		r;
+
+	fs.fs_mounted = 0;
+	for(int k=0; k<FAT_NCACHE; k++)
+		fat_cache[k].c_valid = 0;
+
+	if ((r = sdcard_init()) != 0)
+		return -EIO;
+	if ((s = cache_get(0, 1)) == NULL)
+		return -EIO;
+	if ((s[510] != 0x55)||(s[511] != 0xaa))
+		return -ENODEV;
+
+	// Sector zero is either a boot sector (a "superfloppy"), or a master
+	// boot record.  A boot sector starts with a jump.  If we have an MBR,
+	// use the first partition.
+	if ((s[0] != 0xeb)&&(s[0] != 0xe9)) {
+		switch(s[446+4]) {
+		case 0x04: case 0x06: case 0x0e:	// FAT16
+		case 0x0b: case 0x0c:			// FAT32
+			break;
+		default:
+			return -ENODEV;
+		}
+
+		part = le32(&s[446+8]);
+		if ((s = cache_get(part, 1)) == NULL)
+			return -EIO;
+		if ((s[510] != 0x55)||(s[511] != 0xaa))
+			return -ENODEV;
+	}
+
+	bps  = le16(&s[11]);
+	fs.fs_spc = s[13];
+	rsvd = le16(&s[14]);
+	fs.fs_nfats = s[16];
+	nroot  = le16(&s[17]);
+	totsec = le16(&s[19]);
+	if (totsec == 0)
+		totsec = le32(&s[32]);
+	fs.fs_fatsz = le16(&s[22]);
+	if (fs.fs_fatsz == 0)
+		fs.fs_fatsz = le32(&s[36]);
+
+	if ((bps != FAT_SECTOR)||(fs.fs_spc == 0)
+			||(fs.fs_spc & (fs.fs_spc-1))||(fs.fs_nfats == 0))
+		return -ENODEV;
+
+	fs.fs_fatlba  = part + rsvd;
+	fs.fs_rootlba = fs.fs_fatlba + fs.fs_nfats * fs.fs_fatsz;
+	fs.fs_rootsecs= (nroot * DIR_ENTSZ + FAT_SECTOR-1) / FAT_SECTOR;
+	fs.fs_datalba = fs.fs_rootlba + fs.fs_rootsecs;
+	nsec = totsec - (fs.fs_datalba - part);
+	fs.fs_nclus   = nsec / fs.fs_spc;
+
+	// The cluster count alone determines the FAT type
+	if (fs.fs_nclus < 4085)
+		return -ENODEV;		// FAT12
+	else if (fs.fs_nclus < 65525) {
+		fs.fs_type = 16;
+		fs.fs_rootclus = 0;
+		fs.fs_fsinfo = 0;
+	} else {
+		fs.fs_type = 32;
+		fs.fs_rootclus = le32(&s[44]);
+		fs.fs_fsinfo = le16(&s[48]);
+		if ((fs.fs_fsinfo == 0)||(fs.fs_fsinfo == 0xffff))
+			fs.fs_fsinfo = 0;
+		else
+			fs.fs_fsinfo += part;
+	}
+
+	fs.fs_freehint = 2;
+	fs.fs_mounted = 1;
+	return 0;
+}
+
+int
+fat_open(const char *path, int flags) {
+	FATFILE		*f = NULL;
+	FATDIRENT	d;
+	uint8_t		name[11];
+	unsigned	dclus, c, next;
+	int		r, fd;
+
+	if ((!fs.fs_mounted)&&((r = fat_mount()) != 0))
+		return r;
+
+	for(fd=0; fd<FAT_NFILES; fd++)
+		if (!fat_files[fd].f_used) {
+			f = &fat_files[fd];
+			break;
+		}
+	if (!f)
+		return -EMFILE;
+
+	r = path_walk(path, &dclus, name, &d);
+	if ((r == 1)&&(flags & O_CREAT)&&((flags & O_ACCMODE) != O_RDONLY)) {
+		uint8_t	*s;
+
+		// Create an empty file
+		if ((r = dir_search(dclus, NULL, &d)) != 0)
+			return r;
+		if ((s = cache_get(d.d_lba, 1)) == NULL)
+			return -EIO;
+		memset(&s[d.d_off], 0, DIR_ENTSZ);
+		memcpy(&s[d.d_off], name, 11);
+		s[d.d_off + DIR_ATTR] = ATTR_ARCHIVE;
+		cache_dirty(s);
+		d.d_attr = ATTR_ARCHIVE;
+		d.d_clus = 0;
+		d.d_size = 0;
+	} else if (r != 0)
+		return (r == 1) ? -ENOENT : r;
+	else if ((flags & O_CREAT)&&(flags & O_EXCL))
+		return -EEXIST;
+
+	if (d.d_attr & ATTR_DIR)
+		return -EISDIR;
+
+	memset(f, 0, sizeof(FATFILE));
+	f->f_flags  = flags;
+	f->f_first  = d.d_clus;
+	f->f_size   = d.d_size;
+	f->f_dirlba = d.d_lba;
+	f->f_diroff = d.d_off;
+
+	if ((flags & O_ACCMODE) != O_RDONLY) {
+		if ((flags & O_TRUNC)&&(f->f_first != 0)) {
+			if ((r = fat_free(f->f_first)) != 0)
+				return r;
+			f->f_first = 0;
+			f->f_size  = 0;
+			f->f_dirty = 1;
+		}
+
+		// Find the end of the chain, where the file will grow
+		for(c = f->f_first; (c != 0)&&(!fat_eoc(c)); c = next) {
+			f->f_last = c;
+			f->f_nclus++;
+			if ((r = fat_get(c, &next)) != 0)
+				return r;
+		}
+	}
+
+	f->f_used = 1;
+	return FAT_FD0 + fd;
+}
+
+int
+fat_sync(int fd) {
+	FATFILE	*f = file_get(fd);
+	int	r;
+
+	if ((f)&&((r = file_dirent(f)) != 0))
+		return r;
+	return cache_flush();
+}
+
+int
+fat_close(int fd) {
+	FATFILE	*f = file_get(fd);
+	int	r;
+
+	if (!f)
+		return -EBADF;
+	r = fat_sync(fd);
+	f->f_used = 0;
+	return r;
+}
+
+int
+fat_read(int fd, void *vbuf, unsigned len) {
+	FATFILE		*f = file_get(fd);
+	uint8_t		*buf = (uint8_t *)vbuf;
+	unsigned	csize, done = 0;
+
+	if ((!f)||((f->f_flags & O_ACCMODE) == O_WRONLY))
+		return -EBADF;
+	if (f->f_pos >= f->f_size)
+		return 0;
+	if (len > f->f_size - f->f_pos)
+		len = f->f_size - f->f_pos;
+
+	csize = fs.fs_spc * FAT_SECTOR;
+	while(done < len) {
+		unsigned	ci, coff, soff, clus, run, lba, n;
+		int		r;
+
+		ci   = f->f_pos / csize;
+		coff = f->f_pos % csize;
+		soff = f->f_pos % FAT_SECTOR;
+		if ((r = file_map(f, ci, (coff + len - done + csize-1) / csize,
+				&clus, &run)) != 0)
+			return r;
+
+		lba = clus_lba(clus) + coff / FAT_SECTOR;
+		n = run * csize - coff;	// Contiguous bytes from here
+		if (n > len - done)
+			n = len - done;
+
+		if ((soff == 0)&&(n >= FAT_SECTOR)) {
+			// Whole sectors go straight to the caller
+			unsigned	nsec = n / FAT_SECTOR;
+
+			if (sdcard_read(lba, nsec, &buf[done]) != 0)
+				return -EIO;
+			cache_direct(lba, nsec, &buf[done], 0);
+			n = nsec * FAT_SECTOR;
+		} else {
+			uint8_t	*s = cache_get(lba, 1);
+
+			if (!s)
+				return -EIO;
+			if (n > FAT_SECTOR - soff)
+				n = FAT_SECTOR - soff;
+			memcpy(&buf[done], &s[soff], n);
+		}
+
+		done += n;
+		f->f_pos += n;
+	}
+
+	return done;
+}
+
+int
+fat_write(int fd, const void *vbuf, unsigned len) {
+	FATFILE		*f = file_get(fd);
+	const uint8_t	*buf = (const uint8_t *)vbuf;
+	unsigned	csize, done = 0;
+	int		r = 0;
+
+	if ((!f)||((f->f_flags & O_ACCMODE) == O_RDONLY))
+		return -EBADF;
+	if (f->f_flags & O_APPEND)
+		f->f_pos = f->f_size;
+	else if (f->f_pos > f->f_size)
+		// We don't fill holes past the end of the file
+		return -EINVAL;
+
+	csize = fs.fs_spc * FAT_SECTOR;
+	while(done < len) {
+		unsigned	ci, coff, soff, clus, run, lba, n;
+
+		ci   = f->f_pos / csize;
+		coff = f->f_pos % csize;
+		soff = f->f_pos % FAT_SECTOR;
+
+		// Grow the chain if the file has filled it
+		if (ci >= f->f_nclus) {
+			unsigned	nc;
+
+			if ((r = fat_alloc(f->f_last, &nc)) != 0)
+				break;
+			if (f->f_first == 0)
+				f->f_first = nc;
+			f->f_last = nc;
+			f->f_nclus++;
+			f->f_dirty = 1;
+		}
+
+		// Appends go to the last cluster, overwrites to wherever the
+		// chain puts them
+		if (ci == f->f_nclus-1) {
+			clus = f->f_last;
+			run  = 1;
+		} else {
+			unsigned want = (coff + len - done + csize-1) / csize;
+
+			if (want > f->f_nclus - ci)
+				want = f->f_nclus - ci;
+			if ((r = file_map(f, ci, want, &clus, &run)) != 0)
+				break;
+		}
+
+		lba = clus_lba(clus) + coff / FAT_SECTOR;
+		n = run * csize - coff;
+		if (n > len - done)
+			n = len - done;
+
+		if ((soff == 0)&&(n >= FAT_SECTOR)) {
+			unsigned	nsec = n / FAT_SECTOR;
+
+			if (sdcard_write(lba, nsec, &buf[done]) != 0) {
+				r = -EIO;
+				break;
+			}
+			cache_direct(lba, nsec, (uint8_t *)&buf[done], 1);
+			n = nsec * FAT_SECTOR;
+		} else {
+			// Only read the sector in if it already holds data
+			int	fetch = (f->f_pos - soff < f->f_size);
+			uint8_t	*s = cache_get(lba, fetch);
+
+			if (!s) {
+				r = -EIO;
+				break;
+			}
+			if (!fetch)
+				memset(s, 0, FAT_SECTOR);
+			if (n > FAT_SECTOR - soff)
+				n = FAT_SECTOR - soff;
+			memcpy(&s[soff], &buf[done], n);
+			cache_dirty(s);
+		}
+
+		done += n;
+		f->f_pos += n;
+		if (f->f_pos > f->f_size)
+			f->f_size = f->f_pos;
+		f->f_dirty = 1;
+	}
+
+	if ((done == 0)&&(len > 0))
+		return r;
+	return done;
+}
+
+long
+fat_lseek(int fd, long offset, int whence) {
+	FATFILE	*f = file_get(fd);
+	long	pos;
+
+	if (!f)
+		return -EBADF;
+	switch(whence) {
+	case SEEK_SET: pos = offset; break;
+	case SEEK_CUR: pos = (long)f->f_pos + offset; break;
+	case SEEK_END: pos = (long)f->f_size + offset; break;
+	default:
+		return -EINVAL;
+	}
+
+	if (pos < 0)
+		return -EINVAL;
+	f->f_pos = pos;
+	return pos;
+}
+
+int
+fat_fstat(int fd, struct stat *st) {
+	FATFILE	*f = file_get(fd);
+
+	if (!f)
+		return -EBADF;
+	memset(st, 0, sizeof(struct stat));
+	st->st_mode = S_IFREG | 0666;
+	st->st_size = f->f_size;
+	st->st_blksize = fs.fs_spc * FAT_SECTOR;
+	return 0;
+}
+
+int
+fat_stat(const char *path, struct stat *st) {
+	FATDIRENT	d;
+	uint8_t		name[11];
+	unsigned	dclus;
+	int		r;
+
+	if ((!fs.fs_mounted)&&((r = fat_mount()) != 0))
+		return r;
+	if ((r = path_walk(path, &dclus, name, &d)) != 0)
+		return (r == 1) ? -ENOENT : r;
+
+	memset(st, 0, sizeof(struct stat));
+	st->st_mode = (d.d_attr & ATTR_DIR) ? (S_IFDIR | 0777) : (S_IFREG | 0666);
+	st->st_size = d.d_size;
+	st->st_blksize = fs.fs_spc * FAT_SECTOR;
+	return 0;
+}
+
+#endif	// _BOARD_HAS_SDSPI
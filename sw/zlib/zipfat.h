@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zipfat.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	A FAT16/FAT32 file system on the SD card.  It reads, and it
+//		writes.  syscalls.c routes open(), read(), write(), lseek(),
+//	close(), fstat() and stat() on the card's files through here.  stdio
+//	therefore works on them as it would on any other system.
+//
+//	Sectors are held in a small LRU cache.  Each open file also remembers
+//	the last run of contiguous clusters it found in the FAT.  Reads and
+//	writes of whole sectors go straight between the caller's buffer and
+//	the card, as one multi-block transfer per run.  Only partial sectors
+//	pass through the cache.
+//
+//	Limitations:
+//	- Only 8.3 names are matched.  Long file name entries are skipped.
+//	- Writes may overwrite or extend a file, but not start past its end:
+//	  seeking beyond the end and writing returns EINVAL.  Files may be
+//	  created, or truncated with O_TRUNC, but not removed.
+//	- Sectors must be 512 bytes.  FAT12 is not supported.
+//	- The directory entry, and any cached sectors, are only written back
+//	  on close() or fat_sync().
+//	- Nothing here is reentrant.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	ZIPFAT_H
+#define	ZIPFAT_H
+
+#include <sys/stat.h>
+
+// Number of sectors in the LRU cache
+#ifndef	FAT_NCACHE
+#define	FAT_NCACHE	8
+#endif
+
+// Files that may be open at once, and the first file descriptor they use
+#ifndef	FAT_NFILES
+#define	FAT_NFILES	4
+#endif
+#define	FAT_FD0		3
+#define	FAT_ISFD(FD)	(((FD) >= FAT_FD0)&&((FD) < FAT_FD0 + FAT_NFILES))
+
+// All of these return a negative errno on failure
+
+// Find the file system on the card, initializing the card first.  fat_open()
+// calls this if need be.
+extern	int	fat_mount(void);
+
+// Returns a file descriptor
+extern	int	fat_open(const char *path, int flags);
+extern	int	fat_close(int fd);
+extern	int	fat_read(int fd, void *buf, unsigned len);
+extern	int	fat_write(int fd, const void *buf, unsigned len);
+extern	long	fat_lseek(int fd, long offset, int whence);
+extern	int	fat_fstat(int fd, struct stat *st);
+extern	int	fat_stat(const char *path, struct stat *st);
+
+// Write back fd's directory entry, then every dirty sector.  A negative fd
+// writes back the cache alone.
+extern	int	fat_sync(int fd);
+
+#endif
@@ -0,0 +1,657 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zipheap.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	A TLSF (Two-Level Segregated Fit) memory allocator, providing
+//		malloc(), free(), realloc(), calloc(), and memalign(), together
+//	with the reentrant versions the C library calls internally.  See
+//	zipheap.h for an overview.
+//
+//	Every block starts with a header word holding its size, whether or not
+//	it is free, and whether or not the block physically before it is
+//	free.  Free blocks also hold pointers to their neighbours within their
+//	free list, and a pointer back to the physically preceding block, used
+//	for merging, is kept in the last word of that block--but only while
+//	that block is free.  Allocated blocks therefore cost one word of
+//	overhead.
+//
+//	Free blocks are sorted into lists by size.  The first level index is
+//	the power of two of the size, the second level splits each power of
+//	two into SL_COUNT equal ranges.  fl_bitmap says which first level
+//	classes have any free blocks, and sl_bitmap[fl] which of their second
+//	level lists do.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <reent.h>
+#include "zipheap.h"
+
+#if	(__SIZEOF_SIZE_T__ == 8)
+#define	ALIGN_LG	3
+#else
+#define	ALIGN_LG	2	// All blocks are word aligned
+#endif
+#define	ALIGN_SIZE	(1u << ALIGN_LG)
+
+#define	SL_LG		4	// 16 second level lists per power of two
+#define	SL_COUNT	(1 << SL_LG)
+#define	FL_SHIFT	(SL_LG + ALIGN_LG)
+#define	FL_MAX		24	// Largest block: 16MB
+#define	FL_COUNT	(FL_MAX - FL_SHIFT + 1)
+#define	SMALL_BLOCK	(1 << FL_SHIFT)
+
+typedef	struct	BLOCK_S {
+	// Only valid if the previous block is free
+	struct	BLOCK_S	*prev_phys;
+	// Size of this block's data area, with the two status flags below
+	size_t		size;
+	// Only valid if this block is free
+	struct	BLOCK_S	*next_free, *prev_free;
+} BLOCK;
+
+#define	BLOCK_FREE	1
+#define	BLOCK_PREV_FREE	2
+#define	BLOCK_FLAGS	(BLOCK_FREE|BLOCK_PREV_FREE)
+
+// The header of an allocated block is just its size word
+#define	OVERHEAD	sizeof(size_t)
+// ... and the data starts right after it
+#define	DATA_OFFSET	(offsetof(BLOCK, size) + sizeof(size_t))
+#define	BLOCK_MIN	(sizeof(BLOCK) - sizeof(BLOCK *))
+#define	BLOCK_MAX	((size_t)1 << FL_MAX)
+
+static	unsigned	fl_bitmap;
+static	unsigned	sl_bitmap[FL_COUNT];
+static	BLOCK		*free_lists[FL_COUNT][SL_COUNT];
+
+// Where the last memory we got from _sbrk_r() ends, so that we can tell when
+// the next piece follows on from it
+static	char		*pool_end;
+static	size_t		pool_size;
+static	ZIPHEAPSTATS	stats;
+
+// Index of the least significant set bit
+static inline int
+heap_ffs(unsigned v) {
+	return __builtin_ctz(v);
+}
+
+// Index of the most significant set bit
+static inline int
+heap_fls(size_t v) {
+#if	(__SIZEOF_SIZE_T__ == 8)
+	return 63 - __builtin_clzl(v);
+#else
+	return 31 - __builtin_clz(v);
+#endif
+}
+
+//
+// Block helpers
+//
+static inline size_t	block_size(const BLOCK *b) {
+	return b->size & ~(size_t)BLOCK_FLAGS; }
+static inline void	block_set_size(BLOCK *b, size_t sz) {
+	b->size = sz | (b->size & BLOCK_FLAGS); }
+static inline int	block_is_free(const BLOCK *b) {
+	return (b->size & BLOCK_FREE) != 0; }
+static inline int	block_is_prev_free(const BLOCK *b) {
+	return (b->size & BLOCK_PREV_FREE) != 0; }
+static inline void	block_set_free(BLOCK *b) { b->size |= BLOCK_FREE; }
+static inline void	block_set_used(BLOCK *b) { b->size &= ~(size_t)BLOCK_FREE; }
+static inline void	block_set_prev_free(BLOCK *b) { b->size |= BLOCK_PREV_FREE; }
+static inline void	block_set_prev_used(BLOCK *b) { b->size &= ~(size_t)BLOCK_PREV_FREE; }
+
+static inline void *block_to_ptr(BLOCK *b) {
+	return (char *)b + DATA_OFFSET; }
+static inline BLOCK *block_from_ptr(void *p) {
+	return (BLOCK *)((char *)p - DATA_OFFSET); }
+
+// The next block's header overlaps the last word of this block's data area,
+// since that's where its prev_phys pointer lives
+static inline BLOCK *block_next(BLOCK *b) {
+	return (BLOCK *)((char *)block_to_ptr(b) + block_size(b) - OVERHEAD); }
+
+static inline BLOCK *block_link_next(BLOCK *b) {
+	BLOCK	*n = block_next(b);
+	n->prev_phys = b;
+	return n;
+}
+
+static inline void block_mark_as_free(BLOCK *b) {
+	BLOCK	*n = block_link_next(b);
+	block_set_prev_free(n);
+	block_set_free(b);
+}
+
+static inline void block_mark_as_used(BLOCK *b) {
+	BLOCK	*n = block_next(b);
+	block_set_prev_used(n);
+	block_set_used(b);
+}
+
+static inline size_t align_up(size_t x, size_t align) {
+	return (x + (align-1)) & ~(align-1); }
+
+//
+// adjust_size
+//
+// Turn a request into a legal block size, or zero if it's too big
+//
+static size_t
+adjust_size(size_t sz) {
+	size_t	adj;
+
+	if (sz >= BLOCK_MAX)
+		return 0;
+	adj = align_up(sz, ALIGN_SIZE);
+	return (adj < BLOCK_MIN) ? BLOCK_MIN : adj;
+}
+
+//
+// mapping_insert
+//
+// Which list does a free block of size sz belong on?
+//
+static void
+mapping_insert(size_t sz, int *fl, int *sl) {
+	if (sz < SMALL_BLOCK) {
+		*fl = 0;
+		*sl = (int)sz / (SMALL_BLOCK / SL_COUNT);
+	} else {
+		int	f = heap_fls(sz);
+
+		*sl = (int)(sz >> (f - SL_LG)) ^ SL_COUNT;
+		*fl = f - (FL_SHIFT - 1);
+	}
+}
+
+//
+// mapping_search
+//
+// Which is the first list whose blocks are all at least sz bytes?  Rounding
+// up like this is what lets us take the first block of the list found, rather
+// than searching through it.
+//
+static void
+mapping_search(size_t sz, int *fl, int *sl) {
+	if (sz >= SMALL_BLOCK)
+		sz += ((size_t)1 << (heap_fls(sz) - SL_LG)) - 1;
+	mapping_insert(sz, fl, sl);
+}
+
+static BLOCK *
+search_suitable_block(int *fl, int *sl) {
+	unsigned	sl_map, fl_map;
+
+	if (*fl >= FL_COUNT)
+		return NULL;
+
+	sl_map = sl_bitmap[*fl] & (~0u << *sl);
+	if (!sl_map) {
+		// Nothing on this first level list, move up
+		fl_map = fl_bitmap & (~0u << (*fl + 1));
+		if (!fl_map)
+			return NULL;
+		*fl = heap_ffs(fl_map);
+		sl_map = sl_bitmap[*fl];
+	}
+
+	*sl = heap_ffs(sl_map);
+	return free_lists[*fl][*sl];
+}
+
+static void
+remove_free_block(BLOCK *b, int fl, int sl) {
+	BLOCK	*prev = b->prev_free, *next = b->next_free;
+
+	if (next)
+		next->prev_free = prev;
+	if (prev)
+		prev->next_free = next;
+	else {
+		free_lists[fl][sl] = next;
+		if (!next) {
+			sl_bitmap[fl] &= ~(1u << sl);
+			if (!sl_bitmap[fl])
+				fl_bitmap &= ~(1u << fl);
+		}
+	}
+}
+
+static void
+insert_free_block(BLOCK *b, int fl, int sl) {
+	BLOCK	*cur = free_lists[fl][sl];
+
+	b->next_free = cur;
+	b->prev_free = NULL;
+	if (cur)
+		cur->prev_free = b;
+	free_lists[fl][sl] = b;
+	fl_bitmap     |= (1u << fl);
+	sl_bitmap[fl] |= (1u << sl);
+}
+
+static void
+block_remove(BLOCK *b) {
+	int	fl, sl;
+
+	mapping_insert(block_size(b), &fl, &sl);
+	remove_free_block(b, fl, sl);
+}
+
+static void
+block_insert(BLOCK *b) {
+	int	fl, sl;
+
+	mapping_insert(block_size(b), &fl, &sl);
+	insert_free_block(b, fl, sl);
+}
+
+static inline int
+block_can_split(BLOCK *b, size_t sz) {
+	return block_size(b) >= sizeof(BLOCK) + sz;
+}
+
+//
+// block_split
+//
+// Split b in two, keeping sz bytes in b, and returning the remainder
+//
+static BLOCK *
+block_split(BLOCK *b, size_t sz) {
+	BLOCK	*rem = (BLOCK *)((char *)block_to_ptr(b) + sz - OVERHEAD);
+	size_t	rem_size = block_size(b) - (sz + OVERHEAD);
+
+	rem->size = rem_size;
+	block_set_size(b, sz);
+	block_mark_as_free(rem);
+	return rem;
+}
+
+// Absorb b, which must follow prev, into prev
+static BLOCK *
+block_absorb(BLOCK *prev, BLOCK *b) {
+	prev->size += block_size(b) + OVERHEAD;
+	block_link_next(prev);
+	return prev;
+}
+
+static BLOCK *
+block_merge_prev(BLOCK *b) {
+	if (block_is_prev_free(b)) {
+		BLOCK	*prev = b->prev_phys;
+
+		block_remove(prev);
+		b = block_absorb(prev, b);
+	}
+	return b;
+}
+
+static BLOCK *
+block_merge_next(BLOCK *b) {
+	BLOCK	*n = block_next(b);
+
+	if (block_is_free(n)) {
+		block_remove(n);
+		b = block_absorb(b, n);
+	}
+	return b;
+}
+
+// Return any excess at the end of a free block to the free lists
+static void
+block_trim_free(BLOCK *b, size_t sz) {
+	if (block_can_split(b, sz)) {
+		BLOCK	*rem = block_split(b, sz);
+		block_link_next(b);
+		block_set_prev_free(rem);
+		block_insert(rem);
+	}
+}
+
+// Return any excess at the end of a used block to the free lists
+static void
+block_trim_used(BLOCK *b, size_t sz) {
+	if (block_can_split(b, sz)) {
+		BLOCK	*rem = block_split(b, sz);
+		block_set_prev_used(rem);
+		rem = block_merge_next(rem);
+		block_insert(rem);
+	}
+}
+
+// Return the first sz bytes of a free block to the free lists
+static BLOCK *
+block_trim_free_leading(BLOCK *b, size_t sz) {
+	BLOCK	*rem = b;
+
+	if (block_can_split(b, sz)) {
+		rem = block_split(b, sz - OVERHEAD);
+		block_set_prev_free(rem);
+		block_link_next(b);
+		block_insert(b);
+	}
+	return rem;
+}
+
+static BLOCK *
+block_locate_free(size_t sz) {
+	int	fl, sl;
+	BLOCK	*b;
+
+	mapping_search(sz, &fl, &sl);
+	b = search_suitable_block(&fl, &sl);
+	if (b)
+		remove_free_block(b, fl, sl);
+	return b;
+}
+
+// Return a block to the free lists, merging it with its neighbours
+static void
+block_release(BLOCK *b) {
+	block_mark_as_free(b);
+	b = block_merge_prev(b);
+	b = block_merge_next(b);
+	block_insert(b);
+}
+
+static void *
+block_prepare_used(BLOCK *b, size_t sz) {
+	block_trim_free(b, sz);
+	block_mark_as_used(b);
+
+	stats.h_used += block_size(b) + OVERHEAD;
+	if (stats.h_used > stats.h_peak)
+		stats.h_peak = stats.h_used;
+	stats.h_allocs++;
+	return block_to_ptr(b);
+}
+
+//
+// heap_grow
+//
+// Get enough memory from _sbrk_r() to be certain of satisfying a request of
+// sz bytes, and add it to the free lists.  This is the only step that isn't
+// constant time, and then only as much as _sbrk_r() isn't.
+//
+static int
+heap_grow(struct _reent *reent, size_t sz) {
+	size_t	need;
+	char	*mem;
+	BLOCK	*b, *sentinel;
+
+	// Allow for the rounding in mapping_search(), and for the block
+	// header and end of memory sentinel
+	need = sz;
+	if (sz >= SMALL_BLOCK)
+		need += ((size_t)1 << (heap_fls(sz) - SL_LG));
+	need = align_up(need + 2 * OVERHEAD, ALIGN_SIZE);
+	if (need < ZIPHEAP_GROW)
+		need = ZIPHEAP_GROW;
+	if (need >= BLOCK_MAX)
+		return 0;
+
+	mem = _sbrk_r(reent, (int)need);
+	if (mem == (char *)-1)
+		return 0;
+	if (((uintptr_t)mem) & (ALIGN_SIZE-1)) {
+		// Our first piece of memory may not be aligned.  Drop its
+		// first few bytes.
+		size_t	skip = ALIGN_SIZE - (((uintptr_t)mem) & (ALIGN_SIZE-1));
+
+		mem += skip;
+		if (_sbrk_r(reent, (int)skip) == (void *)-1)
+			need -= ALIGN_SIZE;
+	}
+	stats.h_size += need;
+
+	if ((mem == pool_end)&&(pool_size + need < BLOCK_MAX)) {
+		// This continues on from the last piece.  Turn the old end
+		// sentinel into the header of a new free block, which may
+		// then be merged with whatever free block preceded it.
+		b = (BLOCK *)(mem - DATA_OFFSET);
+		block_set_size(b, need - OVERHEAD);
+		pool_size += need;
+	} else {
+		// A new, separate, piece.  The block's prev_phys field lies
+		// just before the memory we were given, but since the block
+		// has no predecessor, that field will never be used.
+		b = (BLOCK *)(mem - offsetof(BLOCK, size));
+		b->size = need - 2 * OVERHEAD;
+		pool_size = need;
+	}
+
+	// The sentinel: a zero sized, used, block marking the end of memory
+	sentinel = block_link_next(b);
+	sentinel->size = 0;
+
+	pool_end = mem + need;
+
+	block_release(b);
+	return 1;
+}
+
+static void *
+heap_alloc(struct _reent *reent, size_t sz) {
+	size_t	adj = adjust_size(sz);
+	BLOCK	*b;
+
+	if (adj == 0) {
+		stats.h_failures++;
+		reent->_errno = ENOMEM;
+		return NULL;
+	}
+
+	b = block_locate_free(adj);
+	if ((!b)&&(heap_grow(reent, adj)))
+		b = block_locate_free(adj);
+	if (!b) {
+		stats.h_failures++;
+		reent->_errno = ENOMEM;
+		return NULL;
+	}
+
+	return block_prepare_used(b, adj);
+}
+
+void *
+_malloc_r(struct _reent *reent, size_t sz) {
+	return heap_alloc(reent, sz);
+}
+
+void
+_free_r(struct _reent *reent, void *ptr) {
+	BLOCK	*b;
+
+	if (!ptr)
+		return;
+
+	b = block_from_ptr(ptr);
+	stats.h_used -= block_size(b) + OVERHEAD;
+	stats.h_frees++;
+	block_release(b);
+}
+
+void *
+_realloc_r(struct _reent *reent, void *ptr, size_t sz) {
+	BLOCK	*b, *n;
+	size_t	cur, combined, adj;
+	void	*p;
+
+	if (!ptr)
+		return heap_alloc(reent, sz);
+	if (sz == 0) {
+		_free_r(reent, ptr);
+		return NULL;
+	}
+
+	adj = adjust_size(sz);
+	if (adj == 0) {
+		stats.h_failures++;
+		reent->_errno = ENOMEM;
+		return NULL;
+	}
+
+	b = block_from_ptr(ptr);
+	n = block_next(b);
+	cur = block_size(b);
+	combined = cur + block_size(n) + OVERHEAD;
+
+	if ((adj > cur)&&((!block_is_free(n))||(adj > combined))) {
+		// No room to grow in place
+		p = heap_alloc(reent, sz);
+		if (p) {
+			memcpy(p, ptr, cur);
+			_free_r(reent, ptr);
+		}
+		return p;
+	}
+
+	stats.h_used -= cur;
+	if (adj > cur) {
+		block_merge_next(b);
+		block_mark_as_used(b);
+	}
+	block_trim_used(b, adj);
+	stats.h_used += block_size(b);
+	if (stats.h_used > stats.h_peak)
+		stats.h_peak = stats.h_used;
+	return ptr;
+}
+
+void *
+_calloc_r(struct _reent *reent, size_t n, size_t sz) {
+	size_t	total = n * sz;
+	void	*p;
+
+	if ((sz != 0)&&(total / sz != n)) {
+		stats.h_failures++;
+		reent->_errno = ENOMEM;
+		return NULL;
+	}
+
+	p = heap_alloc(reent, total);
+	if (p)
+		memset(p, 0, total);
+	return p;
+}
+
+void *
+_memalign_r(struct _reent *reent, size_t align, size_t sz) {
+	const	size_t	gap_min = sizeof(BLOCK);
+	size_t	adj, with_gap, gap;
+	BLOCK	*b;
+	char	*ptr, *aligned;
+
+	if ((align <= ALIGN_SIZE)||(align & (align-1)))
+		return heap_alloc(reent, sz);
+
+	// Find a block big enough that we can carve an aligned block of the
+	// right size out of it, leaving a free block (or nothing) in front
+	adj = adjust_size(sz);
+	with_gap = (adj) ? adjust_size(adj + align + gap_min) : 0;
+	if (with_gap == 0) {
+		stats.h_failures++;
+		reent->_errno = ENOMEM;
+		return NULL;
+	}
+
+	b = block_locate_free(with_gap);
+	if ((!b)&&(heap_grow(reent, with_gap)))
+		b = block_locate_free(with_gap);
+	if (!b) {
+		stats.h_failures++;
+		reent->_errno = ENOMEM;
+		return NULL;
+	}
+
+	ptr = block_to_ptr(b);
+	aligned = (char *)align_up((uintptr_t)ptr, align);
+	gap = aligned - ptr;
+	if ((gap)&&(gap < gap_min)) {
+		// Too small a gap to hold a free block; move on to the next
+		// aligned address
+		size_t	offset = gap_min - gap;
+		if (offset < align)
+			offset = align;
+		aligned = (char *)align_up((uintptr_t)(aligned + offset), align);
+		gap = aligned - ptr;
+	}
+
+	if (gap)
+		b = block_trim_free_leading(b, gap);
+
+	return block_prepare_used(b, adj);
+}
+
+void *malloc(size_t sz) { return _malloc_r(_REENT, sz); }
+void free(void *ptr) { _free_r(_REENT, ptr); }
+void *realloc(void *ptr, size_t sz) { return _realloc_r(_REENT, ptr, sz); }
+void *calloc(size_t n, size_t sz) { return _calloc_r(_REENT, n, sz); }
+void *memalign(size_t align, size_t sz) { return _memalign_r(_REENT, align, sz); }
+
+void
+zipheap_stats(ZIPHEAPSTATS *st) {
+	size_t		largest = 0, total = 0;
+	unsigned	count = 0;
+
+	for(int fl=0; fl<FL_COUNT; fl++) {
+		if (0 == (fl_bitmap & (1u << fl)))
+			continue;
+		for(int sl=0; sl<SL_COUNT; sl++) {
+			for(BLOCK *b = free_lists[fl][sl]; b; b=b->next_free) {
+				size_t	sz = block_size(b);
+
+				total += sz;
+				count++;
+				if (sz > largest)
+					largest = sz;
+			}
+		}
+	}
+
+	*st = stats;
+	st->h_free    = total;
+	st->h_largest = largest;
+	st->h_nfree   = count;
+	st->h_frag    = (total) ? (unsigned)(100 - (largest * 100) / total) : 0;
+}
+
+void
+zipheap_reset_peak(void) {
+	stats.h_peak = stats.h_used;
+}
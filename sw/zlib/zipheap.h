@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zipheap.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	zipheap.c replaces the C library's malloc() and friends with
+//		a Two-Level Segregated Fit (TLSF) allocator.  Free blocks are
+//	kept in lists sorted by size class, with a pair of bitmaps recording
+//	which lists are non-empty.  Finding a block that fits, splitting it,
+//	and merging a freed block with its neighbours all take a fixed number
+//	of steps regardless of how many blocks there are, so that allocation
+//	times are bounded and can be relied upon from time critical code.
+//
+//	Memory is taken from _sbrk_r() in chunks of at least ZIPHEAP_GROW
+//	bytes, and _sbrk_r() refuses to let the heap run into the stack.
+//
+//	The allocator is not reentrant.  Don't allocate from both a user
+//	task and the supervisor that may interrupt it.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	ZIPHEAP_H
+#define	ZIPHEAP_H
+
+#include <stddef.h>
+
+// Minimum number of bytes to request from _sbrk_r() at a time
+#ifndef	ZIPHEAP_GROW
+#define	ZIPHEAP_GROW	4096
+#endif
+
+typedef	struct	{
+	size_t		h_size,		// Bytes taken from _sbrk_r()
+			h_used,		// Bytes allocated, including overhead
+			h_peak,		// Largest h_used has ever been
+			h_free,		// Bytes in free blocks
+			h_largest;	// Size of the largest free block
+	unsigned	h_nfree,	// Number of free blocks
+			h_allocs,	// Successful allocations
+			h_frees,	// Blocks freed
+			h_failures,	// Allocations that failed
+			// Fragmentation, in percent: 100*(1-h_largest/h_free),
+			// or how much of the free memory can't be handed out
+			// in a single block.
+			h_frag;
+} ZIPHEAPSTATS;
+
+// Fill in *st.  This walks the free lists, so it isn't constant time.
+extern	void	zipheap_stats(ZIPHEAPSTATS *st);
+
+// Reset h_peak to the current h_used
+extern	void	zipheap_reset_peak(void);
+
+#endif
@@ -0,0 +1,311 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zipmem.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	DMA assisted replacements for memcpy(), memmove(), and
+//		memset().  See zipmem.h for a description.
+//
+//	Since this file defines memcpy() and memset() itself, it must be built
+//	with -fno-builtin -fno-tree-loop-distribute-patterns.  Otherwise GCC
+//	is liable to turn the byte loops below back into calls to memcpy()
+//	and memset().
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include <stdint.h>
+#include "zipmem.h"
+
+#ifdef	__ZIPCPU__
+#include "board.h"
+#include "zipcpu.h"
+#include "zipsys.h"
+#endif
+
+unsigned	zipmem_dma_threshold = ZIPMEM_DMA_THRESHOLD;
+unsigned	zipmem_dma_count = 0, zipmem_cpu_count = 0;
+
+#define	ALIGNED(P)	((((uintptr_t)(P)) & 3)==0)
+
+//
+// Merge two source words into one destination word, when the source sits
+// SH bits past a word boundary.  The ZipCPU is big endian.
+//
+#if	defined(__BYTE_ORDER__)&&(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define	MERGE(A,B,SH)	(((A) >> (SH)) | ((B) << (32-(SH))))
+#else
+#define	MERGE(A,B,SH)	(((A) << (SH)) | ((B) >> (32-(SH))))
+#endif
+
+#if	defined(__ZIPCPU__)&&defined(_HAVE_ZIPSYS_DMA)
+//
+// dma_copy
+//
+// Move nw words from s to d using the DMA.  Returns zero, having done
+// nothing, if the DMA is already in use.
+//
+static int
+dma_copy(uint32_t *d, const uint32_t *s, unsigned nw, int ctrl) {
+	if (_zip->z_dma.d_ctrl & DMA_BUSY)
+		return 0;
+
+	_zip->z_dma.d_len = nw;
+	_zip->z_dma.d_rd  = (int *)s;
+	_zip->z_dma.d_wr  = (int *)d;
+	_zip->z_dma.d_ctrl= ctrl;
+
+	while(_zip->z_dma.d_ctrl & DMA_BUSY)
+		;
+
+	// The data cache knows nothing of what the DMA just wrote
+	CLEAR_DCACHE;
+	zipmem_dma_count++;
+	return 1;
+}
+#define	HAVE_DMA
+#endif
+
+//
+// cpu_copy_words
+//
+// Copy nw words from an aligned s to an aligned d, eight at a time
+//
+static void
+cpu_copy_words(uint32_t *d, const uint32_t *s, unsigned nw) {
+	while(nw >= 8) {
+		uint32_t	a, b, c, e;
+
+		a = s[0]; b = s[1]; c = s[2]; e = s[3];
+		d[0] = a; d[1] = b; d[2] = c; d[3] = e;
+		a = s[4]; b = s[5]; c = s[6]; e = s[7];
+		d[4] = a; d[5] = b; d[6] = c; d[7] = e;
+		d += 8; s += 8; nw -= 8;
+	}
+
+	while(nw > 0) {
+		*d++ = *s++;
+		nw--;
+	}
+}
+
+//
+// cpu_copy_shifted
+//
+// Copy nw words to an aligned d from a source that isn't word aligned.
+// Each destination word is built from two aligned source words, so the
+// bus only ever sees word reads.
+//
+static void
+cpu_copy_shifted(uint32_t *d, const char *s, unsigned nw) {
+	unsigned	sh = (((uintptr_t)s) & 3) * 8;
+	const uint32_t	*ws = (const uint32_t *)(((uintptr_t)s) & ~3);
+	uint32_t	a, b;
+
+	a = *ws++;
+	while(nw >= 4) {
+		b = *ws++; d[0] = MERGE(a, b, sh);
+		a = *ws++; d[1] = MERGE(b, a, sh);
+		b = *ws++; d[2] = MERGE(a, b, sh);
+		a = *ws++; d[3] = MERGE(b, a, sh);
+		d += 4; nw -= 4;
+	}
+
+	while(nw > 0) {
+		b = *ws++;
+		*d++ = MERGE(a, b, sh);
+		a = b;
+		nw--;
+	}
+}
+
+//
+// copy_forward
+//
+// The workhorse behind memcpy(), and memmove() when the destination is
+// below the source.  Bytes are copied until the destination is aligned,
+// then words (by DMA if possible), then any bytes that remain.
+//
+static void
+copy_forward(char *d, const char *s, size_t n) {
+	size_t	nw;
+
+	if (n < 8) {
+		while(n-- > 0)
+			*d++ = *s++;
+		zipmem_cpu_count++;
+		return;
+	}
+
+	while(!ALIGNED(d)) {
+		*d++ = *s++;
+		n--;
+	}
+
+	nw = n >> 2;
+	if (ALIGNED(s)) {
+#ifdef	HAVE_DMA
+		if ((n < zipmem_dma_threshold)
+			|| !dma_copy((uint32_t *)d, (const uint32_t *)s,
+						nw, DMACCOPY))
+#endif
+		{
+			cpu_copy_words((uint32_t *)d, (const uint32_t *)s, nw);
+			zipmem_cpu_count++;
+		}
+	} else {
+		cpu_copy_shifted((uint32_t *)d, s, nw);
+		zipmem_cpu_count++;
+	}
+
+	d += nw << 2; s += nw << 2; n &= 3;
+	while(n-- > 0)
+		*d++ = *s++;
+}
+
+//
+// copy_backward
+//
+// For memmove() when the destination overlaps the top of the source.  The
+// DMA only ever copies upwards, so this is all done by the CPU.
+//
+static void
+copy_backward(char *d, const char *s, size_t n) {
+	d += n; s += n;
+
+	if ((((uintptr_t)d ^ (uintptr_t)s) & 3) == 0) {
+		uint32_t	*wd;
+		const uint32_t	*ws;
+
+		while((n > 0)&&(!ALIGNED(d))) {
+			*--d = *--s;
+			n--;
+		}
+
+		wd = (uint32_t *)d; ws = (const uint32_t *)s;
+		while(n >= 16) {
+			uint32_t	a, b, c, e;
+
+			a = ws[-1]; b = ws[-2]; c = ws[-3]; e = ws[-4];
+			wd[-1] = a; wd[-2] = b; wd[-3] = c; wd[-4] = e;
+			wd -= 4; ws -= 4; n -= 16;
+		}
+
+		while(n >= 4) {
+			*--wd = *--ws;
+			n -= 4;
+		}
+		d = (char *)wd; s = (const char *)ws;
+	}
+
+	while(n-- > 0)
+		*--d = *--s;
+	zipmem_cpu_count++;
+}
+
+void *
+memcpy(void *d, const void *s, size_t n) {
+	copy_forward((char *)d, (const char *)s, n);
+	return d;
+}
+
+void *
+memmove(void *d, const void *s, size_t n) {
+	char		*cd = (char *)d;
+	const char	*cs = (const char *)s;
+
+	if ((cd == cs)||(n == 0))
+		return d;
+	else if ((cd < cs)||(cd >= cs + n))
+		// Copying forwards is safe both when there's no overlap, and
+		// when the destination is below the source.  This is also
+		// true of the DMA, since it reads each burst before writing
+		// it.
+		copy_forward(cd, cs, n);
+	else
+		copy_backward(cd, cs, n);
+
+	return d;
+}
+
+void *
+memset(void *d, int c, size_t n) {
+	char		*cd = (char *)d;
+	uint32_t	*wd, w;
+	size_t		nw;
+
+	if (n < 8) {
+		while(n-- > 0)
+			*cd++ = c;
+		zipmem_cpu_count++;
+		return d;
+	}
+
+	while(!ALIGNED(cd)) {
+		*cd++ = c;
+		n--;
+	}
+
+	w = c & 0x0ff;
+	w |= w << 8;
+	w |= w << 16;
+
+	wd = (uint32_t *)cd;
+	nw = n >> 2;
+#ifdef	HAVE_DMA
+	// The DMA reads the fill value from memory, over and over.  Since
+	// the data cache is write through, w will be there by the time the
+	// DMA goes looking for it.
+	volatile uint32_t	fill = w;
+	if ((n < zipmem_dma_threshold)
+		|| !dma_copy(wd, (const uint32_t *)&fill, nw,
+						DMACCOPY|DMA_CONSTSRC))
+#endif
+	{
+		uint32_t	*end = wd + nw;
+
+		while(wd + 8 <= end) {
+			wd[0] = w; wd[1] = w; wd[2] = w; wd[3] = w;
+			wd[4] = w; wd[5] = w; wd[6] = w; wd[7] = w;
+			wd += 8;
+		}
+
+		while(wd < end)
+			*wd++ = w;
+		zipmem_cpu_count++;
+	}
+
+	cd += nw << 2; n &= 3;
+	while(n-- > 0)
+		*cd++ = c;
+
+	return d;
+}
@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zipmem.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	zipmem.c replaces the C library's memcpy(), memmove(), and
+//		memset() with versions that hand large transfers to the ZipSystem
+//	DMA controller.  Short transfers, and the unaligned head and tail of
+//	long ones, are done by the CPU a word at a time.
+//
+//	The DMA is only used if it's present (_HAVE_ZIPSYS_DMA), if it's idle
+//	when the call is made, and if the source and destination share the
+//	same alignment.  The caller waits for the DMA to complete, so these
+//	remain drop-in replacements.  Be aware, though, that the DMA will set
+//	SYSINT_DMAC in the PIC when each transfer completes.
+//
+//	The crossover point between the two is kept in zipmem_dma_threshold,
+//	in bytes, so that it may be tuned at run time.  See membench.c in
+//	sw/board for a program to measure it.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	ZIPMEM_H
+#define	ZIPMEM_H
+
+#include <stddef.h>
+
+// Default number of bytes at and above which a copy or fill is handed to the
+// DMA.  Zero sends everything to the DMA, ~0 sends nothing.
+#ifndef	ZIPMEM_DMA_THRESHOLD
+#define	ZIPMEM_DMA_THRESHOLD	256
+#endif
+
+extern	unsigned	zipmem_dma_threshold;
+
+// Counts of the transfers handed to the DMA and to the CPU, for
+// benchmarking
+extern	unsigned	zipmem_dma_count, zipmem_cpu_count;
+
+extern	void	*memcpy(void *d, const void *s, size_t n);
+extern	void	*memmove(void *d, const void *s, size_t n);
+extern	void	*memset(void *d, int c, size_t n);
+
+#endif
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zprof.c
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	A timer driven sampling profiler.  See zprof.h for how it's
+//		used, and sw/host/zipprof.cpp for how its samples are read
+//	back out.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#include "zipcpu.h"
+#include "zipsys.h"
+#include "zprof.h"
+
+ZPROF	_zprof;
+
+void
+zprof_start(unsigned period) {
+	_zprof.p_magic  = 0;
+	_zprof.p_period = period;
+	_zprof.p_size   = ZPROF_NSAMPLES;
+	_zprof.p_count  = 0;
+
+	_zip->z_tma = TMR_INTERVAL | period;
+	_zip->z_pic = SYSINT_TMA;		// Clear any stale tick
+	_zip->z_pic = EINT(SYSINT_TMA);
+
+	// Let the host know the buffer is now valid
+	_zprof.p_magic  = ZPROF_MAGIC;
+}
+
+void
+zprof_stop(void) {
+	_zip->z_pic = DINT(SYSINT_TMA);
+	_zip->z_tma = 0;
+	_zip->z_pic = SYSINT_TMA;
+}
+
+int
+zprof_tick(void) {
+	unsigned	upc;
+
+	if ((_zip->z_pic & SYSINT_TMA) == 0)
+		return 0;
+
+	GETUREG(upc, "uPC");
+	_zprof.p_pc[_zprof.p_count % ZPROF_NSAMPLES] = upc;
+	_zprof.p_count++;
+
+	_zip->z_pic = SYSINT_TMA;
+	return 1;
+}
+
+int
+zprof_run(ZPROFFN fn, int arg, unsigned *stack_top, unsigned *ucc) {
+	unsigned	upc, cc;
+	int		result;
+
+	// fn() returns into zip_syscall(), still in user mode, which returns
+	// us to the supervisor just past the zip_rtu() below
+	SETUREG(zip_syscall, "uR0");
+	SETUREG(arg, "uR1");
+	SETUREG(stack_top, "uSP");
+	SETUREG(CC_GIE, "uCC");
+	SETUREG(fn, "uPC");
+
+	while(1) {
+		zip_rtu();
+
+		GETUREG(cc, "uCC");
+		if (cc & CC_EXCEPTION) {
+			if (ucc)
+				*ucc = cc;
+			return -1;
+		}
+
+		GETUREG(upc, "uPC");
+		// Returning leaves uPC just past zip_syscall()'s AND
+		if ((upc > (unsigned)zip_syscall)
+				&&(upc <= (unsigned)zip_syscall + 4))
+			break;
+
+		// Otherwise, this was (presumably) a timer tick.  Any other
+		// interrupt the caller has enabled must be handled by the
+		// caller's own zip_rtu() loop, using zprof_tick().
+		zprof_tick();
+	}
+
+	if (ucc)
+		*ucc = 0;
+	GETUREG(result, "uR1");
+	return result;
+}
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename:	zprof.h
+//
+// Project:	ZBasic, a generic toplevel impl using the full ZipCPU
+//
+// Purpose:	A sampling profiler.  ZipSystem timer A is set to interrupt
+//		the CPU every so many clocks.  Since the ZipCPU only takes
+//	interrupts in user mode, each tick returns control to the supervisor,
+//	which records the user mode PC it interrupted into _zprof.p_pc[], a
+//	circular buffer.
+//
+//	_zprof lives in .bss, and hence in block RAM.  Once the program has
+//	run, sw/host/zipprof finds _zprof in the ELF file, reads it over the
+//	debug bus, and turns the PCs it finds there into a per-function
+//	profile.  This works on hardware, where main_tb's pfile.bin isn't
+//	available.
+//
+//	Usage, from supervisor mode:
+//
+//		zprof_start(ZPROF_PERIOD);
+//		zprof_run(fn, arg, stack_top, &ucc);
+//		zprof_stop();
+//
+//	or, if the supervisor already has its own zip_rtu() loop, call
+//	zprof_tick() each time zip_rtu() returns, and handle any other
+//	interrupts as before.
+//
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (C) 2015-2020, Gisselquist Technology, LLC
+//
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of  the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+//
+// License:	GPL, v3, as defined and found on www.gnu.org,
+//		http://www.gnu.org/licenses/gpl.html
+//
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+//
+#ifndef	ZPROF_H
+#define	ZPROF_H
+
+// Number of samples kept.  Once full, the oldest are overwritten.
+#ifndef	ZPROF_NSAMPLES
+#define	ZPROF_NSAMPLES	4096
+#endif
+
+// Default sample interval, in clocks
+#ifndef	ZPROF_PERIOD
+#define	ZPROF_PERIOD	10000
+#endif
+
+#define	ZPROF_MAGIC	0x5a50524f	// "ZPRO"
+
+// The layout of this structure is shared with sw/host/zipprof.cpp
+typedef	struct	{
+	unsigned	p_magic,	// ZPROF_MAGIC, once zprof_start() is called
+			p_period,	// Clocks between samples
+			p_size,		// ZPROF_NSAMPLES
+			p_count;	// Samples taken.  The next goes into
+					// p_pc[p_count % p_size]
+	unsigned	p_pc[ZPROF_NSAMPLES];
+} ZPROF;
+
+extern	ZPROF	_zprof;
+
+typedef	int	(*ZPROFFN)(int);
+
+// Clear the buffer, and start timer A ticking every period clocks
+extern	void	zprof_start(unsigned period);
+
+// Stop the timer.  The samples are left in _zprof for the host to collect.
+extern	void	zprof_stop(void);
+
+// Call from the supervisor each time zip_rtu() returns.  If timer A was
+// the reason, records the user PC, acknowledges the interrupt and returns
+// non-zero.
+extern	int	zprof_tick(void);
+
+// Run fn(arg) in user mode, on the stack ending at stack_top, sampling it
+// until it returns.  Returns fn's return value.  If fn instead takes an
+// exception, *ucc is set to its uCC (otherwise to zero) and -1 is returned.
+// fn returns through zip_syscall(), so it mustn't call that itself.
+extern	int	zprof_run(ZPROFFN fn, int arg, unsigned *stack_top,
+			unsigned *ucc);
+
+#endif